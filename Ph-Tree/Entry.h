@@ -23,6 +23,8 @@ public:
 	~Entry();
 
 	void reinit(const std::vector<unsigned long> &values, int id);
+	// takes the DIM values starting at the given pointer (not a bitset like the constructor)
+	void reinit(const unsigned long* values, int id);
 
 	size_t getBitLength() const;
 	size_t getDimensions() const;
@@ -63,9 +65,14 @@ Entry<DIM, WIDTH>::Entry(const unsigned long* startBlock, int id) : id_(id), nBi
 
 template <unsigned int DIM, unsigned int WIDTH>
 void Entry<DIM, WIDTH>::reinit(const std::vector<unsigned long> &values, int id) {
+	assert (values.size() == DIM);
+	reinit(values.data(), id);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void Entry<DIM, WIDTH>::reinit(const unsigned long* values, int id) {
 	assert (nBits_ == DIM * WIDTH);
 	id_ = id;
-	assert (values.size() == DIM);
 	const size_t nBlocks = 1u + (nBits_ - 1u) / (sizeof (unsigned long) * 8u);
 	for (unsigned i = 0; i < nBlocks; ++i) {
 		values_[i] = 0;
@@ -0,0 +1,321 @@
+#ifndef SRC_FROZENPHTREE_H_
+#define SRC_FROZENPHTREE_H_
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "nodes/NodeRawContents.h"
+
+template <unsigned int DIM, unsigned int WIDTH>
+class PHTree;
+template <unsigned int DIM, unsigned int WIDTH>
+class Entry;
+
+// Immutable copy of a PHTree in a single buffer of 64 bit words without any pointers so it can
+// be written to a file and used directly from a read-only memory mapping of that file.
+// The buffer starts with the header words [magic, DIM, WIDTH, #words] followed by the nodes
+// in depth-first order. Every node consists of:
+// - [prefix length | #rows << 32] [#suffix blocks | is AHC << 63]
+// - the prefix blocks
+// - the bit-packed addresses of an LHC or the occupancy bits of an AHC
+// - one reference per row as in the nodes (AHC rows without content hold 0)
+// - the suffix blocks the references with the flags 11 point into
+// Subnode references hold the word offset of the subnode instead of its address (with the
+// same flags) so the raw contents of a node can be walked like the ones of the regular nodes.
+template <unsigned int DIM, unsigned int WIDTH>
+class FrozenPHTree {
+public:
+	// copies the nodes of the tree (must not run concurrently with a parallel insertion)
+	explicit FrozenPHTree(const PHTree<DIM, WIDTH>& tree);
+	// uses the given buffer without copying it (the buffer must outlive the tree)
+	FrozenPHTree(const unsigned long* words, size_t nWords);
+	// maps the file written by write() into memory (read-only and shared with other processes)
+	explicit FrozenPHTree(const std::string& fileLocation);
+	~FrozenPHTree();
+	// the words may point into the owned copy or the mapping
+	FrozenPHTree(const FrozenPHTree<DIM, WIDTH>& other) = delete;
+	FrozenPHTree<DIM, WIDTH>& operator=(const FrozenPHTree<DIM, WIDTH>& other) = delete;
+
+	void write(std::ostream& os) const;
+	size_t getByteSize() const;
+
+	std::pair<bool,int> lookup(const Entry<DIM, WIDTH>& e) const;
+	std::pair<bool,int> lookup(const std::vector<unsigned long>& values) const;
+	// calls callback(int id) for every entry in the range
+	template <typename CALLBACK>
+	void forEachInRange(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, CALLBACK callback) const;
+	void rangeQueryIds(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, std::vector<int>& outIds) const;
+
+private:
+	static const unsigned long magic = 0x315A4F52464850uL; // "PHFROZ1"
+	static const size_t headerWords = 4;
+	static const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+	static const size_t occupiedBlocks = 1 + ((1uL << DIM) - 1) / bitsPerBlock;
+
+	// owned copy of the nodes (empty if the buffer belongs to someone else or is mapped)
+	std::vector<unsigned long> ownedWords_;
+	const unsigned long* words_;
+	size_t nWords_;
+	// the mapped file (NULL if not mapped)
+	void* mapping_;
+	size_t mappingBytes_;
+
+	// appends the node and its subnodes to the owned words
+	void appendNode(const Node<DIM>* node);
+	// fills the contents with the arrays of the node at the given word offset
+	inline void getRawContents(size_t offset, NodeRawContents<DIM>& outContents) const;
+	// checks the header and sets the words
+	void setWords(const unsigned long* words, size_t nWords);
+	template <typename CALLBACK>
+	void forEachInRange(size_t offset, size_t index, const unsigned long* parentValues, bool fullyContained,
+			const unsigned long* lowerLeft, const unsigned long* upperRight, CALLBACK& callback) const;
+};
+
+#include <assert.h>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Entry.h"
+#include "PHTree.h"
+#include "nodes/Node.h"
+#include "util/MultiDimBitset.h"
+#include "util/SpatialSelectionOperationsUtil.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+FrozenPHTree<DIM, WIDTH>::FrozenPHTree(const PHTree<DIM, WIDTH>& tree) : ownedWords_(),
+		words_(NULL), nWords_(0), mapping_(NULL), mappingBytes_(0) {
+	const unsigned long header[] = {magic, DIM, WIDTH, 0};
+	ownedWords_.assign(header, header + headerWords);
+	appendNode(tree.root_);
+	ownedWords_[3] = ownedWords_.size();
+	words_ = ownedWords_.data();
+	nWords_ = ownedWords_.size();
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+FrozenPHTree<DIM, WIDTH>::FrozenPHTree(const unsigned long* words, size_t nWords) : ownedWords_(),
+		words_(NULL), nWords_(0), mapping_(NULL), mappingBytes_(0) {
+	setWords(words, nWords);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+FrozenPHTree<DIM, WIDTH>::FrozenPHTree(const string& fileLocation) : ownedWords_(),
+		words_(NULL), nWords_(0), mapping_(NULL), mappingBytes_(0) {
+	const int fd = open(fileLocation.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw runtime_error("Could not open " + fileLocation);
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		close(fd);
+		throw runtime_error("Could not read the size of " + fileLocation);
+	}
+
+	mappingBytes_ = fileStat.st_size;
+	void* mapping = mmap(NULL, mappingBytes_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw runtime_error("Could not map " + fileLocation);
+	}
+
+	mapping_ = mapping;
+	try {
+		setWords(reinterpret_cast<const unsigned long*>(mapping_), mappingBytes_ / sizeof (unsigned long));
+	} catch (...) {
+		munmap(mapping_, mappingBytes_);
+		throw;
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+FrozenPHTree<DIM, WIDTH>::~FrozenPHTree() {
+	if (mapping_) {
+		munmap(mapping_, mappingBytes_);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void FrozenPHTree<DIM, WIDTH>::setWords(const unsigned long* words, size_t nWords) {
+	if (nWords < headerWords || words[0] != magic) {
+		throw runtime_error("The buffer does not contain a frozen tree.");
+	} else if (words[1] != DIM || words[2] != WIDTH) {
+		throw runtime_error("The frozen tree has a different dimensionality or bit width.");
+	} else if (words[3] > nWords) {
+		throw runtime_error("The frozen tree is truncated.");
+	}
+
+	words_ = words;
+	nWords_ = words[3];
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void FrozenPHTree<DIM, WIDTH>::write(ostream& os) const {
+	os.write(reinterpret_cast<const char*>(words_), nWords_ * sizeof (unsigned long));
+	if (!os) {
+		throw runtime_error("Could not write the frozen tree.");
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+size_t FrozenPHTree<DIM, WIDTH>::getByteSize() const {
+	return nWords_ * sizeof (unsigned long);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void FrozenPHTree<DIM, WIDTH>::appendNode(const Node<DIM>* node) {
+	NodeRawContents<DIM> contents;
+	node->getRawContents(contents);
+	const TSuffixStorage* storage = node->getSuffixStorage();
+	const unsigned int suffixBlocks = (storage)? storage->getNCurrentStorageBlocks() : 0;
+
+	ownedWords_.push_back(contents.prefixLength | ((unsigned long) contents.nRows << 32));
+	const unsigned long isAhc = contents.addresses == NULL;
+	ownedWords_.push_back(suffixBlocks | (isAhc << 63));
+	const size_t prefixBits = DIM * contents.prefixLength;
+	if (prefixBits > 0) {
+		ownedWords_.insert(ownedWords_.end(), contents.prefix, contents.prefix + 1 + (prefixBits - 1) / bitsPerBlock);
+	}
+
+	if (contents.addresses) {
+		if (contents.nRows > 0) {
+			const size_t addressBlocks = 1 + (contents.nRows * DIM - 1) / bitsPerBlock;
+			ownedWords_.insert(ownedWords_.end(), contents.addresses, contents.addresses + addressBlocks);
+		}
+	} else {
+		assert (contents.nRows == (1uL << DIM));
+		ownedWords_.insert(ownedWords_.end(), contents.occupied, contents.occupied + occupiedBlocks);
+	}
+
+	const size_t referencesOffset = ownedWords_.size();
+	ownedWords_.insert(ownedWords_.end(), contents.references, contents.references + contents.nRows);
+	if (suffixBlocks > 0) {
+		ownedWords_.insert(ownedWords_.end(), contents.suffixBlocks, contents.suffixBlocks + suffixBlocks);
+	}
+
+	// the subnodes follow in address order and replace their pointers by their offsets
+	for (unsigned int row = 0; row < contents.nRows; ++row) {
+		const uintptr_t reference = contents.references[row];
+		const bool isSuffix = reference & 1;
+		const bool isPointer = (reference >> 1) & 1;
+		if (reference != 0 && !isPointer && !isSuffix) {
+			throw runtime_error("Cannot freeze a tree during a parallel insertion.");
+		} else if (isPointer && !isSuffix) {
+			ownedWords_[referencesOffset + row] = (ownedWords_.size() << 2) | 2uL;
+			appendNode(reinterpret_cast<const Node<DIM>*>(reference & ~(3uL)));
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void FrozenPHTree<DIM, WIDTH>::getRawContents(size_t offset, NodeRawContents<DIM>& outContents) const {
+	assert (offset + 2 <= nWords_);
+	const unsigned long* word = words_ + offset;
+	outContents.prefixLength = word[0] & ((-1uL) >> 32);
+	outContents.nRows = word[0] >> 32;
+	const unsigned int suffixBlocks = word[1] & ((-1uL) >> 1);
+	const bool isAhc = word[1] >> 63;
+	word += 2;
+
+	const size_t prefixBits = DIM * outContents.prefixLength;
+	outContents.prefix = word;
+	word += (prefixBits > 0)? 1 + (prefixBits - 1) / bitsPerBlock : 0;
+
+	if (isAhc) {
+		outContents.addresses = NULL;
+		outContents.occupied = word;
+		word += occupiedBlocks;
+	} else {
+		outContents.addresses = word;
+		outContents.occupied = NULL;
+		word += (outContents.nRows > 0)? 1 + (outContents.nRows * DIM - 1) / bitsPerBlock : 0;
+	}
+
+	outContents.references = reinterpret_cast<const uintptr_t*>(word);
+	word += outContents.nRows;
+	outContents.suffixBlocks = (suffixBlocks > 0)? word : NULL;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+pair<bool, int> FrozenPHTree<DIM, WIDTH>::lookup(const Entry<DIM, WIDTH>& e) const {
+	size_t offset = headerWords;
+	size_t index = 0;
+	NodeRawContents<DIM> contents;
+	NodeAddressContent<DIM> content;
+	while (true) {
+		getRawContents(offset, contents);
+		const size_t prefixLength = contents.prefixLength;
+		if (prefixLength > 0 && !MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+				index, index + prefixLength, contents.prefix, prefixLength * DIM).first) {
+			return pair<bool, int>(false, 0);
+		}
+
+		index += prefixLength;
+		const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(e.values_, index, DIM * WIDTH);
+		const unsigned int row = contents.lowerBound(hcAddress);
+		if (row >= contents.nRows || contents.getAddress(row) != hcAddress || contents.references[row] == 0) {
+			return pair<bool, int>(false, 0);
+		}
+
+		contents.getContent(row, content, true);
+		if (content.hasSubnode) {
+			// the subnode pointer holds the shifted offset
+			offset = reinterpret_cast<uintptr_t>(content.subnode) >> 2;
+			++index;
+			continue;
+		}
+
+		const size_t suffixBits = DIM * (WIDTH - index - 1);
+		if (suffixBits > 0 && !MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+				index + 1, WIDTH, content.getSuffixStartBlock(), suffixBits).first) {
+			return pair<bool, int>(false, 0);
+		}
+
+		return pair<bool, int>(true, content.id);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+pair<bool, int> FrozenPHTree<DIM, WIDTH>::lookup(const vector<unsigned long>& values) const {
+	const Entry<DIM, WIDTH> entry(values, 0);
+	return lookup(entry);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void FrozenPHTree<DIM, WIDTH>::forEachInRange(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, CALLBACK callback) const {
+	assert (lowerLeftValues.size() == DIM && upperRightValues.size() == DIM);
+	const unsigned long rootValues[DIM] = {};
+	forEachInRange(headerWords, 0, rootValues, false, lowerLeftValues.data(), upperRightValues.data(), callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void FrozenPHTree<DIM, WIDTH>::forEachInRange(size_t offset, size_t index, const unsigned long* parentValues,
+		bool fullyContained, const unsigned long* lowerLeft, const unsigned long* upperRight,
+		CALLBACK& callback) const {
+	auto recurse = [this, lowerLeft, upperRight, &callback] (const Node<DIM>* subnode, size_t subnodeIndex,
+			const unsigned long* subnodeValues, bool subnodeFullyContained) {
+		forEachInRange(reinterpret_cast<uintptr_t>(subnode) >> 2, subnodeIndex, subnodeValues,
+				subnodeFullyContained, lowerLeft, upperRight, callback);
+	};
+
+	NodeRawContents<DIM> contents;
+	getRawContents(offset, contents);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInContents(contents, index, parentValues,
+			fullyContained, lowerLeft, upperRight, callback, recurse);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void FrozenPHTree<DIM, WIDTH>::rangeQueryIds(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, vector<int>& outIds) const {
+	forEachInRange(lowerLeftValues, upperRightValues, [&outIds] (int id) { outIds.push_back(id); });
+}
+
+#endif /* SRC_FROZENPHTREE_H_ */
@@ -5,6 +5,11 @@
 #include <vector>
 #include <thread>
 #include "Entry.h"
+#include "util/NodeArena.h"
+#include "util/EpochReclamation.h"
+#include "util/PointSpan.h"
+#include "util/SelectivityEstimator.h"
+#include "iterators/KnnIterator.h"
 #include <thread>
 
 template <unsigned int DIM>
@@ -17,6 +22,12 @@ template <unsigned int DIM, unsigned int WIDTH>
 class RangeQueryIterator;
 template <unsigned int DIM, unsigned int WIDTH>
 class InsertionThreadPool;
+template <unsigned int DIM, unsigned int WIDTH>
+class FrozenPHTree;
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+class RangeQueryThreadPool;
+class ResultStorage;
+struct RangeQueryThreadStatistics;
 
 template <unsigned int DIM, unsigned int WIDTH>
 class PHTree {
@@ -28,6 +39,12 @@ class PHTree {
 	friend class DynamicNodeOperationsUtil;
 	template <unsigned int D, unsigned int W>
 	friend class InsertionThreadPool;
+	template <unsigned int D, unsigned int W>
+	friend class RangeQueryIterator;
+	template <unsigned int D, unsigned int W, typename S>
+	friend class RangeQueryThreadPool;
+	template <unsigned int D, unsigned int W>
+	friend class FrozenPHTree;
 public:
 	PHTree();
 	explicit PHTree(const PHTree<DIM, WIDTH>& other);
@@ -35,28 +52,107 @@ public:
 	void insert(const Entry<DIM, WIDTH>& e);
 	void insert(const std::vector<unsigned long>& values, int id);
 	void parallelInsert(const Entry<DIM,WIDTH>& entry);
+	// the buffered bulk insertions require values that are distinct and not stored yet
 	void parallelBulkInsert(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>* ids = NULL, size_t nThreads = std::thread::hardware_concurrency());
+	// the bulk operations also take the values as PointSpan<DIM>(flatValues, nPoints) and the IDs as a flat
+	// buffer of one ID per point (the index of the point is used as its ID if there are no IDs)
+	void parallelBulkInsert(const PointSpan<DIM>& values, const int* ids = NULL, size_t nThreads = std::thread::hardware_concurrency());
 	void insertHyperRect(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, int id);
 	void bulkInsert(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>& ids);
+	void bulkInsert(const PointSpan<DIM>& values, const int* ids = NULL);
 	void bulkInsert(const std::vector<Entry<DIM,WIDTH>>& entries);
+	// builds an empty tree from the entries sorted in Z-order (inserts them one by one if the tree is not empty)
+	void bulkLoad(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>& ids);
+	void bulkLoad(const PointSpan<DIM>& values, const int* ids = NULL);
+	void bulkLoad(const std::vector<Entry<DIM,WIDTH>>& entries);
+	// bulk load that sorts the entries and builds disjoint subtrees in parallel (inserts them one by one if the tree is not empty)
+	void parallelBulkLoad(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>* ids = NULL, size_t nThreads = std::thread::hardware_concurrency());
+	void parallelBulkLoad(const PointSpan<DIM>& values, const int* ids = NULL, size_t nThreads = std::thread::hardware_concurrency());
+	// writes all nodes to a binary stream that load() rebuilds them from with the same node types
+	// (must not run concurrently with a parallel insertion)
+	void save(std::ostream& os) const;
+	// replaces the empty tree by the one in the stream without inserting the entries again
+	void load(std::istream& is);
+	bool erase(const Entry<DIM, WIDTH>& e);
+	bool erase(const std::vector<unsigned long>& values);
 
 	std::pair<bool,int> lookup(const Entry<DIM, WIDTH>& e) const;
 	std::pair<bool,int> lookup(const std::vector<unsigned long>& values) const;
+	// looks up all entries in groups that are advanced in lockstep to overlap the cache misses of
+	// large trees (the i-th result belongs to the i-th entry)
+	void lookupBatch(const std::vector<Entry<DIM, WIDTH>>& entries, std::vector<std::pair<bool,int>>& outResults) const;
+	void lookupBatch(const PointSpan<DIM>& values, std::vector<std::pair<bool,int>>& outResults) const;
+	// iterates the k entries nearest to the given values in ascending distance (Euclidean or L1)
+	KnnIterator<DIM, WIDTH>* knnQuery(const std::vector<unsigned long>& centerValues, size_t k, DistanceMetric metric = euclidean_distance) const;
+	void knnQueryIds(const std::vector<unsigned long>& centerValues, size_t k, std::vector<int>& outIds, DistanceMetric metric = euclidean_distance) const;
 	std::pair<bool,int> lookupHyperRect(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues) const;
 	RangeQueryIterator<DIM, WIDTH>* rangeQuery(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight) const;
 	RangeQueryIterator<DIM, WIDTH>* rangeQuery(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues) const;
+	void rangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight, std::vector<int>& outIds) const;
+	void rangeQueryIds(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, std::vector<int>& outIds) const;
+	// estimates the number of entries in the range in constant time from the entries counted per HC address prefix
+	// of the upper levels (e.g. to choose between the tree and a scan or to reserve the result buffer)
+	size_t estimateRangeQuerySize(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues) const;
+	// calls callback(int id) for every entry in the range without creating iterators
+	template <typename CALLBACK>
+	void forEachInRange(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight, CALLBACK callback) const;
+	template <typename CALLBACK>
+	void forEachInRange(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, CALLBACK callback) const;
+	// calls callback(int id) for every entry within the given distance of the center (Euclidean or L1,
+	// entries at exactly the given distance are included)
+	template <typename CALLBACK>
+	void forEachInDistance(const std::vector<unsigned long>& centerValues, double maxDistance, CALLBACK callback, DistanceMetric metric = euclidean_distance) const;
+	void distanceQueryIds(const std::vector<unsigned long>& centerValues, double maxDistance, std::vector<int>& outIds, DistanceMetric metric = euclidean_distance) const;
+	// splits a single range query into disjoint subtrees that are processed in parallel and stores the IDs per partition
+	void parallelRangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight, std::vector<std::vector<int>>& outPartitions, size_t nThreads = std::thread::hardware_concurrency()) const;
+	void parallelRangeQueryIds(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, std::vector<std::vector<int>>& outPartitions, size_t nThreads = std::thread::hardware_concurrency()) const;
+	// lock-free reads that may run while another thread executes parallelBulkInsert (but not insert, erase or
+	// parallelInsert): nodes are validated by their version and the read restarts if a writer changed them
+	std::pair<bool,int> optimisticLookup(const Entry<DIM, WIDTH>& e) const;
+	std::pair<bool,int> optimisticLookup(const std::vector<unsigned long>& values) const;
+	void optimisticRangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight, std::vector<int>& outIds) const;
+	void optimisticRangeQueryIds(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues, std::vector<int>& outIds) const;
 	RangeQueryIterator<DIM, WIDTH>* intersectionQuery(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues) const;
 	RangeQueryIterator<DIM, WIDTH>* intersectionQuery(const std::vector<unsigned long>& values) const;
-	// TODO what exactly to return?
-	void parallelIntersectionQuery(const std::vector<std::vector<unsigned long>>& values, size_t nThreads = std::thread::hardware_concurrency()) const;
+	// reports every ID found by the i-th query as sink(threadIndex, i, id) from the thread processing the query
+	// and optionally how long each thread was busy and idle
+	template <typename SINK>
+	void parallelIntersectionQuery(const PointSpan<DIM>& values, SINK& sink, size_t nThreads = std::thread::hardware_concurrency(),
+			std::vector<RangeQueryThreadStatistics>* outStatistics = NULL) const;
+	void parallelIntersectionQuery(const PointSpan<DIM>& values, ResultStorage& outResults, size_t nThreads = std::thread::hardware_concurrency(),
+			std::vector<RangeQueryThreadStatistics>* outStatistics = NULL) const;
 	RangeQueryIterator<DIM, WIDTH>* inclusionQuery(const std::vector<unsigned long>& lowerLeftValues, const std::vector<unsigned long>& upperRightValues) const;
 	RangeQueryIterator<DIM, WIDTH>* inclusionQuery(const std::vector<unsigned long>& values) const;
-	void parallelInclusionQuery(const std::vector<std::vector<unsigned long>>& values, size_t nThreads = std::thread::hardware_concurrency()) const;
+	template <typename SINK>
+	void parallelInclusionQuery(const PointSpan<DIM>& values, SINK& sink, size_t nThreads = std::thread::hardware_concurrency(),
+			std::vector<RangeQueryThreadStatistics>* outStatistics = NULL) const;
+	void parallelInclusionQuery(const PointSpan<DIM>& values, ResultStorage& outResults, size_t nThreads = std::thread::hardware_concurrency(),
+			std::vector<RangeQueryThreadStatistics>* outStatistics = NULL) const;
 
 	void accept(Visitor<DIM>* visitor);
 
 private:
+	// holds all nodes and suffix storages of the tree (must be set as the arena of the thread while changing the tree)
+	NodeArena arena_;
+	// retires the nodes replaced during a parallel insertion (also used by optimistic readers)
+	mutable EpochReclamation<DIM> reclamation_;
 	Node<DIM>* root_;
+	// updated by all insertions and removals
+	SelectivityEstimator<DIM, WIDTH> estimator_;
+
+	// converts all points into entries at once
+	static void toEntries(const PointSpan<DIM>& values, const int* ids, std::vector<Entry<DIM,WIDTH>>& outEntries);
+	// adds the given entries, the distinct entries of a Z-order sorted range or all entries of the tree to the estimator
+	void addToEstimator(const PointSpan<DIM>& values);
+	void addSortedToEstimator(const std::vector<Entry<DIM,WIDTH>>& sortedEntries);
+	void addAllToEstimator();
+	// sorts the given entries and replaces the root with the tree built from them
+	void sortAndBuild(std::vector<Entry<DIM,WIDTH>>& entries);
+	// convert the k-dim hyper rectangle queries into ranges over the 2k-dim points
+	static void toIntersectionRange(const unsigned long* lowerLeftValues, const unsigned long* upperRightValues,
+			unsigned long* outLowerLeft, unsigned long* outUpperRight);
+	static void toInclusionRange(const unsigned long* lowerLeftValues, const unsigned long* upperRightValues,
+			unsigned long* outLowerLeft, unsigned long* outUpperRight);
 };
 
 #include <assert.h>
@@ -64,23 +160,31 @@ private:
 #include "util/DynamicNodeOperationsUtil.h"
 #include "util/SpatialSelectionOperationsUtil.h"
 #include "util/NodeTypeUtil.h"
+#include "util/BulkLoadUtil.h"
+#include "util/BulkLoadThreadPool.h"
+#include "util/SnapshotUtil.h"
 #include "util/InsertionThreadPool.h"
 #include "util/RangeQueryThreadPool.h"
+#include "util/PartitionedRangeQueryThreadPool.h"
+#include "util/ResultStorage.h"
+#include "iterators/RangeQueryIterator.h"
 
 using namespace std;
 
 template <unsigned int DIM, unsigned int WIDTH>
-PHTree<DIM, WIDTH>::PHTree() {
-	const unsigned int blocksForFirstSuffix = 1 + ((WIDTH - 1) * DIM - 1) / (8 * sizeof (unsigned long));
-	root_ = NodeTypeUtil<DIM>::template buildNodeWithSuffixes<WIDTH>(0, 1, 1, blocksForFirstSuffix);
+PHTree<DIM, WIDTH>::PHTree() : arena_(), reclamation_(), estimator_() {
+	NodeArena::Scope arenaScope(&arena_);
+	const unsigned int bitsForFirstSuffix = (WIDTH - 1) * DIM;
+	root_ = NodeTypeUtil<DIM>::template buildNodeWithSuffixes<WIDTH>(0, 1, 1, bitsForFirstSuffix);
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-PHTree<DIM, WIDTH>::PHTree(const PHTree<DIM, WIDTH>& other) : root_(other.root_) { }
+PHTree<DIM, WIDTH>::PHTree(const PHTree<DIM, WIDTH>& other) : arena_(), reclamation_(), root_(other.root_),
+		estimator_(other.estimator_) { }
 
 template <unsigned int DIM, unsigned int WIDTH>
 PHTree<DIM, WIDTH>::~PHTree() {
-	root_->recursiveDelete();
+	// all nodes are released together with the arena
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -89,7 +193,10 @@ void PHTree<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& e) {
 		cout << "inserting: " << e << endl;
 	#endif
 
-	DynamicNodeOperationsUtil<DIM, WIDTH>::insert(e, *this);
+	NodeArena::Scope arenaScope(&arena_);
+	if (DynamicNodeOperationsUtil<DIM, WIDTH>::insert(e, *this)) {
+		estimator_.add(e);
+	}
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -102,39 +209,178 @@ void PHTree<DIM, WIDTH>::insert(const vector<unsigned long>& values, int id) {
 
 template <unsigned int DIM, unsigned int WIDTH>
 void PHTree<DIM, WIDTH>::parallelInsert(const Entry<DIM,WIDTH>& entry) {
+	NodeArena::Scope arenaScope(&arena_);
 	DynamicNodeOperationsUtil<DIM,WIDTH>::parallelInsert(entry, this);
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
 void PHTree<DIM, WIDTH>::parallelBulkInsert(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>* ids, size_t nThreads) {
+	assert (!ids || ids->size() == values.size());
+	parallelBulkInsert(PointSpan<DIM>(values), (ids)? ids->data() : NULL, nThreads);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelBulkInsert(const PointSpan<DIM>& values, const int* ids, size_t nThreads) {
 	assert (nThreads > 0);
+	NodeArena::Scope arenaScope(&arena_);
 	InsertionThreadPool<DIM,WIDTH>* pool = new InsertionThreadPool<DIM,WIDTH>(nThreads - 1, values, ids, this);
 	pool->joinPool();
 	delete pool;
+	addToEstimator(values);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::toEntries(const PointSpan<DIM>& values, const int* ids, vector<Entry<DIM,WIDTH>>& outEntries) {
+	const size_t size = values.size();
+	outEntries.resize(size);
+	for (size_t i = 0; i < size; ++i) {
+		outEntries[i].reinit(values[i], (ids)? ids[i] : i);
+	}
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::addToEstimator(const PointSpan<DIM>& values) {
+	Entry<DIM, WIDTH> entry;
+	for (size_t i = 0; i < values.size(); ++i) {
+		entry.reinit(values[i], 0);
+		estimator_.add(entry);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::addSortedToEstimator(const vector<Entry<DIM,WIDTH>>& sortedEntries) {
+	for (size_t i = 0; i < sortedEntries.size(); ++i) {
+		// the bulk loads only store the first of several equal entries
+		if (i == 0 || BulkLoadUtil<DIM, WIDTH>::zOrderLess(sortedEntries[i - 1], sortedEntries[i])) {
+			estimator_.add(sortedEntries[i]);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::addAllToEstimator() {
+	const unsigned long maxValue = (WIDTH >= 8 * sizeof (unsigned long))? -1uL : (1uL << WIDTH) - 1uL;
+	const vector<unsigned long> lowerLeftValues(DIM, 0);
+	const vector<unsigned long> upperRightValues(DIM, maxValue);
+	RangeQueryIterator<DIM, WIDTH>* it = rangeQuery(lowerLeftValues, upperRightValues);
+	while (it->hasNext()) {
+		estimator_.add(it->next());
+	}
+
+	delete it;
+}
 
 template <unsigned int DIM, unsigned int WIDTH>
 void PHTree<DIM, WIDTH>::bulkInsert(
 		const vector<vector<unsigned long>>& values,
 		const vector<int>& ids) {
 	assert (values.size() == ids.size());
+	bulkInsert(PointSpan<DIM>(values), ids.data());
+}
 
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::bulkInsert(const PointSpan<DIM>& values, const int* ids) {
+	vector<Entry<DIM,WIDTH>> entries;
+	toEntries(values, ids, entries);
+	bulkInsert(entries);
+}
 
-	vector<Entry<DIM,WIDTH>>* entries = new vector<Entry<DIM,WIDTH>>();
-	const size_t size = values.size();
-	entries->reserve(size);
-	for (unsigned i = 0; i < size; ++i) {
-		entries->emplace_back(values[i], ids[i]);
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::bulkInsert(const vector<Entry<DIM,WIDTH>>& entries) {
+	NodeArena::Scope arenaScope(&arena_);
+	DynamicNodeOperationsUtil<DIM, WIDTH>::bulkInsert(entries, *this);
+	for (const auto& entry : entries) {
+		estimator_.add(entry);
 	}
+}
 
-	bulkInsert(*entries);
-	delete entries;
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::bulkLoad(
+		const vector<vector<unsigned long>>& values,
+		const vector<int>& ids) {
+	assert (values.size() == ids.size());
+	bulkLoad(PointSpan<DIM>(values), ids.data());
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-void PHTree<DIM, WIDTH>::bulkInsert(const vector<Entry<DIM,WIDTH>>& entries) {
-	DynamicNodeOperationsUtil<DIM, WIDTH>::bulkInsert(entries, *this);
+void PHTree<DIM, WIDTH>::bulkLoad(const PointSpan<DIM>& values, const int* ids) {
+	vector<Entry<DIM,WIDTH>> entries;
+	toEntries(values, ids, entries);
+	sortAndBuild(entries);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::bulkLoad(const vector<Entry<DIM,WIDTH>>& entries) {
+	vector<Entry<DIM,WIDTH>> sortedEntries(entries);
+	sortAndBuild(sortedEntries);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelBulkLoad(const std::vector<std::vector<unsigned long>>& values, const std::vector<int>* ids, size_t nThreads) {
+	assert (!ids || ids->size() == values.size());
+	parallelBulkLoad(PointSpan<DIM>(values), (ids)? ids->data() : NULL, nThreads);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelBulkLoad(const PointSpan<DIM>& values, const int* ids, size_t nThreads) {
+	assert (nThreads > 0);
+	if (values.size() == 0) {
+		return;
+	}
+
+	if (root_->getNumberOfContents() > 0) {
+		// the existing nodes would need to be merged so insert the entries instead
+		bulkLoad(values, ids);
+		return;
+	}
+
+	NodeArena::Scope arenaScope(&arena_);
+	BulkLoadThreadPool<DIM,WIDTH>* pool = new BulkLoadThreadPool<DIM,WIDTH>(nThreads - 1, values, ids, &arena_);
+	Node<DIM>* oldRoot = root_;
+	root_ = pool->joinPool();
+	addSortedToEstimator(pool->getSortedEntries());
+	delete pool;
+	delete oldRoot;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::sortAndBuild(vector<Entry<DIM,WIDTH>>& entries) {
+	if (entries.empty()) {
+		return;
+	}
+
+	if (root_->getNumberOfContents() > 0) {
+		// the existing nodes would need to be merged so insert the entries instead
+		for (const auto& entry : entries) {
+			insert(entry);
+		}
+
+		return;
+	}
+
+	NodeArena::Scope arenaScope(&arena_);
+	BulkLoadUtil<DIM, WIDTH>::sortByZOrder(entries);
+	Node<DIM>* oldRoot = root_;
+	root_ = BulkLoadUtil<DIM, WIDTH>::buildTree(entries);
+	delete oldRoot;
+	addSortedToEstimator(entries);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::save(ostream& os) const {
+	SnapshotUtil<DIM, WIDTH>::write(root_, os);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::load(istream& is) {
+	assert (root_->getNumberOfContents() == 0);
+	NodeArena::Scope arenaScope(&arena_);
+	Node<DIM>* oldRoot = root_;
+	root_ = SnapshotUtil<DIM, WIDTH>::read(is);
+	delete oldRoot;
+	// the snapshot does not contain the summary
+	estimator_.clear();
+	addAllToEstimator();
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -155,6 +401,28 @@ void PHTree<DIM, WIDTH>::insertHyperRect(
 	insert(combinedValues, id);
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+bool PHTree<DIM, WIDTH>::erase(const Entry<DIM, WIDTH>& e) {
+	#ifdef PRINT
+		cout << "erasing: " << e << endl;
+	#endif
+
+	NodeArena::Scope arenaScope(&arena_);
+	const bool erased = DynamicNodeOperationsUtil<DIM, WIDTH>::erase(e, *this);
+	if (erased) {
+		estimator_.remove(e);
+	}
+
+	return erased;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool PHTree<DIM, WIDTH>::erase(const std::vector<unsigned long>& values) {
+	assert (values.size() == DIM);
+	const Entry<DIM, WIDTH> entry(values, 0);
+	return erase(entry);
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 pair<bool,int> PHTree<DIM, WIDTH>::lookup(const Entry<DIM, WIDTH>& e) const {
 	#ifdef PRINT
@@ -169,6 +437,31 @@ pair<bool,int> PHTree<DIM, WIDTH>::lookup(const std::vector<unsigned long>& valu
 	return lookup(entry);
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::lookupBatch(const std::vector<Entry<DIM, WIDTH>>& entries,
+		std::vector<std::pair<bool,int>>& outResults) const {
+	outResults.resize(entries.size());
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::lookupBatch(entries.data(), entries.size(), root_, outResults.data());
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::lookupBatch(const PointSpan<DIM>& values,
+		std::vector<std::pair<bool,int>>& outResults) const {
+	// converts the values chunkwise so the entries stay in the cache
+	const size_t chunkSize = 1024;
+	const size_t size = values.size();
+	vector<Entry<DIM, WIDTH>> entries(min(chunkSize, size));
+	outResults.resize(size);
+	for (size_t start = 0; start < size; start += chunkSize) {
+		const size_t nEntries = min(chunkSize, size - start);
+		for (size_t i = 0; i < nEntries; ++i) {
+			entries[i].reinit(values[start + i], 0);
+		}
+
+		SpatialSelectionOperationsUtil<DIM, WIDTH>::lookupBatch(entries.data(), nEntries, root_, outResults.data() + start);
+	}
+}
+
 template<unsigned int DIM, unsigned int WIDTH>
 pair<bool, int> PHTree<DIM, WIDTH>::lookupHyperRect(
 		const std::vector<unsigned long>& lowerLeftValues,
@@ -186,6 +479,22 @@ pair<bool, int> PHTree<DIM, WIDTH>::lookupHyperRect(
 	return lookup(combinedValues);
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+KnnIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::knnQuery(const vector<unsigned long>& centerValues,
+		size_t k, DistanceMetric metric) const {
+	assert (centerValues.size() == DIM);
+	return new KnnIterator<DIM, WIDTH>(root_, centerValues.data(), k, metric);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::knnQueryIds(const vector<unsigned long>& centerValues,
+		size_t k, vector<int>& outIds, DistanceMetric metric) const {
+	assert (centerValues.size() == DIM);
+	KnnIterator<DIM, WIDTH> it(root_, centerValues.data(), k, metric);
+	while (it.hasNext()) {
+		outIds.push_back(it.nextId());
+	}
+}
 
 template <unsigned int DIM, unsigned int WIDTH>
 RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::rangeQuery(const Entry<DIM, WIDTH>& lowerLeft,
@@ -207,6 +516,126 @@ RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::rangeQuery(
 	return rangeQuery(lowerLeft, upperRight);
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::rangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft,
+		const Entry<DIM, WIDTH>& upperRight, vector<int>& outIds) const {
+	RangeQueryIterator<DIM, WIDTH> it(*this);
+	it.reset(lowerLeft, upperRight);
+	while (it.hasNext()) {
+		outIds.push_back(it.nextId());
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::rangeQueryIds(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, vector<int>& outIds) const {
+	const Entry<DIM, WIDTH> lowerLeft(lowerLeftValues, 0);
+	const Entry<DIM, WIDTH> upperRight(upperRightValues, 0);
+	rangeQueryIds(lowerLeft, upperRight, outIds);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+size_t PHTree<DIM, WIDTH>::estimateRangeQuerySize(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues) const {
+	assert (lowerLeftValues.size() == DIM && upperRightValues.size() == DIM);
+	return size_t(estimator_.estimate(lowerLeftValues.data(), upperRightValues.data()) + 0.5);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void PHTree<DIM, WIDTH>::forEachInRange(const Entry<DIM, WIDTH>& lowerLeft,
+		const Entry<DIM, WIDTH>& upperRight, CALLBACK callback) const {
+	unsigned long lowerLeftValues[DIM] = {};
+	unsigned long upperRightValues[DIM] = {};
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(lowerLeft.values_, DIM * WIDTH, 0, lowerLeftValues);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(upperRight.values_, DIM * WIDTH, 0, upperRightValues);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(root_, lowerLeftValues, upperRightValues, callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void PHTree<DIM, WIDTH>::forEachInRange(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, CALLBACK callback) const {
+	assert (lowerLeftValues.size() == DIM && upperRightValues.size() == DIM);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(root_,
+			lowerLeftValues.data(), upperRightValues.data(), callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void PHTree<DIM, WIDTH>::forEachInDistance(const vector<unsigned long>& centerValues,
+		double maxDistance, CALLBACK callback, DistanceMetric metric) const {
+	assert (centerValues.size() == DIM);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInDistance(root_,
+			centerValues.data(), maxDistance, metric, callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::distanceQueryIds(const vector<unsigned long>& centerValues,
+		double maxDistance, vector<int>& outIds, DistanceMetric metric) const {
+	forEachInDistance(centerValues, maxDistance, [&outIds] (int id) { outIds.push_back(id); }, metric);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+pair<bool,int> PHTree<DIM, WIDTH>::optimisticLookup(const Entry<DIM, WIDTH>& e) const {
+	typename EpochReclamation<DIM>::ReadGuard guard(reclamation_);
+	const Node<DIM>* root = __atomic_load_n(&root_, __ATOMIC_ACQUIRE);
+	return SpatialSelectionOperationsUtil<DIM, WIDTH>::optimisticLookup(e, root);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+pair<bool,int> PHTree<DIM, WIDTH>::optimisticLookup(const std::vector<unsigned long>& values) const {
+	const Entry<DIM, WIDTH> entry(values, 0);
+	return optimisticLookup(entry);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::optimisticRangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft,
+		const Entry<DIM, WIDTH>& upperRight, vector<int>& outIds) const {
+	unsigned long lowerLeftValues[DIM] = {};
+	unsigned long upperRightValues[DIM] = {};
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(lowerLeft.values_, DIM * WIDTH, 0, lowerLeftValues);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(upperRight.values_, DIM * WIDTH, 0, upperRightValues);
+	typename EpochReclamation<DIM>::ReadGuard guard(reclamation_);
+	const Node<DIM>* root = __atomic_load_n(&root_, __ATOMIC_ACQUIRE);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::optimisticRangeQueryIds(root, lowerLeftValues, upperRightValues, outIds);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::optimisticRangeQueryIds(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, vector<int>& outIds) const {
+	assert (lowerLeftValues.size() == DIM && upperRightValues.size() == DIM);
+	typename EpochReclamation<DIM>::ReadGuard guard(reclamation_);
+	const Node<DIM>* root = __atomic_load_n(&root_, __ATOMIC_ACQUIRE);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::optimisticRangeQueryIds(root,
+			lowerLeftValues.data(), upperRightValues.data(), outIds);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelRangeQueryIds(const Entry<DIM, WIDTH>& lowerLeft,
+		const Entry<DIM, WIDTH>& upperRight, vector<vector<int>>& outPartitions, size_t nThreads) const {
+	unsigned long lowerLeftValues[DIM] = {};
+	unsigned long upperRightValues[DIM] = {};
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(lowerLeft.values_, DIM * WIDTH, 0, lowerLeftValues);
+	SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(upperRight.values_, DIM * WIDTH, 0, upperRightValues);
+	assert (nThreads > 0);
+	PartitionedRangeQueryThreadPool<DIM, WIDTH>* pool = new PartitionedRangeQueryThreadPool<DIM, WIDTH>(
+			nThreads - 1, root_, lowerLeftValues, upperRightValues, outPartitions);
+	pool->joinPool();
+	delete pool;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelRangeQueryIds(const vector<unsigned long>& lowerLeftValues,
+		const vector<unsigned long>& upperRightValues, vector<vector<int>>& outPartitions, size_t nThreads) const {
+	assert (lowerLeftValues.size() == DIM && upperRightValues.size() == DIM);
+	assert (nThreads > 0);
+	PartitionedRangeQueryThreadPool<DIM, WIDTH>* pool = new PartitionedRangeQueryThreadPool<DIM, WIDTH>(
+			nThreads - 1, root_, lowerLeftValues.data(), upperRightValues.data(), outPartitions);
+	pool->joinPool();
+	delete pool;
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::inclusionQuery(
 		const std::vector<unsigned long>& lowerLeftValues,
@@ -216,12 +645,18 @@ RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::inclusionQuery(
 
 	vector<unsigned long> lowerLeftHyperRect(DIM);
 	vector<unsigned long> upperRightHyperRect(DIM);
+	toInclusionRange(lowerLeftValues.data(), upperRightValues.data(),
+			lowerLeftHyperRect.data(), upperRightHyperRect.data());
+	return rangeQuery(lowerLeftHyperRect, upperRightHyperRect);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::toInclusionRange(const unsigned long* lowerLeftValues,
+		const unsigned long* upperRightValues, unsigned long* outLowerLeft, unsigned long* outUpperRight) {
 	for (unsigned k = 0; k < DIM; ++k) {
-		lowerLeftHyperRect[k] = lowerLeftValues[k % (DIM / 2)];
-		upperRightHyperRect[k] = upperRightValues[k % (DIM / 2)];
+		outLowerLeft[k] = lowerLeftValues[k % (DIM / 2)];
+		outUpperRight[k] = upperRightValues[k % (DIM / 2)];
 	}
-
-	return rangeQuery(lowerLeftHyperRect, upperRightHyperRect);
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -240,28 +675,34 @@ RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::intersectionQuery(
 	assert (DIM % 2 == 0);
 	assert ((2 * lowerLeftValues.size() == DIM) && (2 * upperRightValues.size() == DIM));
 
+	vector<unsigned long> lowerLeftHyperRect(DIM);
+	vector<unsigned long> upperRightHyperRect(DIM);
+	toIntersectionRange(lowerLeftValues.data(), upperRightValues.data(),
+			lowerLeftHyperRect.data(), upperRightHyperRect.data());
+	return rangeQuery(lowerLeftHyperRect, upperRightHyperRect);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::toIntersectionRange(const unsigned long* lowerLeftValues,
+		const unsigned long* upperRightValues, unsigned long* outLowerLeft, unsigned long* outUpperRight) {
 	// range query for k-dim hyper rectangles as 2k-dim points:
 	// <--- k --->  <-- k -->   <-- k --> <--- k --->
 	// (-inf, -inf, ll1, ll2) - (ur1, ur2, +inf, +inf)
-	vector<unsigned long> lowerLeftHyperRect(DIM);
-	vector<unsigned long> upperRightHyperRect(DIM);
 	// set lower half of the values
 	for (unsigned k = 0; k <  DIM / 2; ++k) {
 		assert (lowerLeftValues[k] <= upperRightValues[k]);
 		// with unsigned values 0 is the lowest possible value
-		lowerLeftHyperRect[k] = 0;
-		upperRightHyperRect[k] = upperRightValues[k];
+		outLowerLeft[k] = 0;
+		outUpperRight[k] = upperRightValues[k];
 	}
 
 	// with unsigned values -1 is equal to the highest possible value
 	const unsigned long max = (WIDTH == 8 * sizeof (unsigned long))? -1 : (1uL << WIDTH) - 1;
 	// set upper half of the values
 	for (unsigned k = DIM / 2; k < DIM; ++k) {
-		lowerLeftHyperRect[k] = lowerLeftValues[k - DIM / 2];
-		upperRightHyperRect[k] = max;
+		outLowerLeft[k] = lowerLeftValues[k - DIM / 2];
+		outUpperRight[k] = max;
 	}
-
-	return rangeQuery(lowerLeftHyperRect, upperRightHyperRect);
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -274,21 +715,49 @@ RangeQueryIterator<DIM, WIDTH>* PHTree<DIM, WIDTH>::intersectionQuery(
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-void PHTree<DIM, WIDTH>::parallelIntersectionQuery(const std::vector<std::vector<unsigned long>>& values, size_t nThreads) const {
-	RangeQueryThreadPool<DIM, WIDTH>* pool = new RangeQueryThreadPool<DIM, WIDTH>(nThreads - 1, values, this, intersection_query);
+template <typename SINK>
+void PHTree<DIM, WIDTH>::parallelIntersectionQuery(const PointSpan<DIM>& values,
+		SINK& sink, size_t nThreads, std::vector<RangeQueryThreadStatistics>* outStatistics) const {
+	assert (nThreads > 0);
+	RangeQueryThreadPool<DIM, WIDTH, SINK>* pool = new RangeQueryThreadPool<DIM, WIDTH, SINK>(nThreads - 1, values, this, intersection_query, sink);
 	pool->joinPool();
-	// TODO values extracted but what to return?
+	if (outStatistics) {
+		pool->getThreadStatistics(*outStatistics);
+	}
+
 	delete pool;
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-void PHTree<DIM, WIDTH>::parallelInclusionQuery(const std::vector<std::vector<unsigned long>>& values, size_t nThreads) const {
-	RangeQueryThreadPool<DIM, WIDTH>* pool = new RangeQueryThreadPool<DIM, WIDTH>(nThreads - 1, values, this, inclusion_query);
+void PHTree<DIM, WIDTH>::parallelIntersectionQuery(const PointSpan<DIM>& values,
+		ResultStorage& outResults, size_t nThreads, std::vector<RangeQueryThreadStatistics>* outStatistics) const {
+	outResults.reset(values.size(), nThreads);
+	parallelIntersectionQuery<ResultStorage>(values, outResults, nThreads, outStatistics);
+	outResults.finish();
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename SINK>
+void PHTree<DIM, WIDTH>::parallelInclusionQuery(const PointSpan<DIM>& values,
+		SINK& sink, size_t nThreads, std::vector<RangeQueryThreadStatistics>* outStatistics) const {
+	assert (nThreads > 0);
+	RangeQueryThreadPool<DIM, WIDTH, SINK>* pool = new RangeQueryThreadPool<DIM, WIDTH, SINK>(nThreads - 1, values, this, inclusion_query, sink);
 	pool->joinPool();
-	// TODO values extracted but what to return?
+	if (outStatistics) {
+		pool->getThreadStatistics(*outStatistics);
+	}
+
 	delete pool;
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void PHTree<DIM, WIDTH>::parallelInclusionQuery(const PointSpan<DIM>& values,
+		ResultStorage& outResults, size_t nThreads, std::vector<RangeQueryThreadStatistics>* outStatistics) const {
+	outResults.reset(values.size(), nThreads);
+	parallelInclusionQuery<ResultStorage>(values, outResults, nThreads, outStatistics);
+	outResults.finish();
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 void PHTree<DIM, WIDTH>::accept(Visitor<DIM>* visitor) {
 	(*visitor).template visit<WIDTH>(this);
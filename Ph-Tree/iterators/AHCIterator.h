@@ -39,21 +39,8 @@ AHCIterator<DIM, PREF_BLOCKS>::~AHCIterator() {}
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 void AHCIterator<DIM, PREF_BLOCKS>::setAddress(size_t address) {
-	if (address >= (1uL << DIM)) {
-		this->address_ = (1uL << DIM);
-	} else {
-		// find first filled address if the given one is not filled
-		bool filled, hasSub, isDirectlyStoredSuffix, isSpecial;
-		uintptr_t ref;
-		for (this->address_ = address; this->address_ < (1uL << DIM); this->address_++) {
-			node_->getRef(this->address_, &filled, &hasSub, &isDirectlyStoredSuffix, &isSpecial, &ref);
-			if (filled) break;
-		}
-
-		if (this->address_ == (1 << DIM) - 1 && !filled) {
-			this->address_ = 1 << DIM;
-		}
-	}
+	// find first filled address if the given one is not filled
+	this->address_ = node_->nextOccupied(address);
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
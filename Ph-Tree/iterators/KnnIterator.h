@@ -0,0 +1,289 @@
+#ifndef SRC_ITERATORS_KNNITERATOR_H_
+#define SRC_ITERATORS_KNNITERATOR_H_
+
+#include <vector>
+#include <queue>
+#include <cstddef>
+#include "util/DistanceUtil.h"
+
+template <unsigned int DIM>
+class Node;
+template <unsigned int DIM, unsigned int WIDTH>
+class Entry;
+template <unsigned int DIM, unsigned int WIDTH>
+class EntryBuffer;
+
+// Best-first k nearest neighbor search: subtrees and entries are taken from a queue ordered by
+// their distance to the center, where the distance of a subtree is a lower bound computed from
+// the box of all values that share the known bits above its HC address. The distances of the k
+// nearest entries found so far are kept in a bounded heap so that candidates farther away than
+// the k-th of them are never queued.
+template <unsigned int DIM, unsigned int WIDTH>
+class KnnIterator {
+public:
+	// iterates the k entries nearest to the given per dimension values in ascending distance
+	KnnIterator(const Node<DIM>* root, const unsigned long* center, size_t k, DistanceMetric metric);
+
+	Entry<DIM, WIDTH> next();
+	// only returns the ID of the next entry without recreating its bitset
+	int nextId();
+	bool hasNext() const;
+	// the distance of the entry returned last
+	double getDistance() const;
+
+private:
+	// a subtree (node set) or an entry (node not set) that still needs to be returned or visited
+	struct Candidate {
+		// squared for the Euclidean distance
+		double distance;
+		const Node<DIM>* node;
+		// index of the first bit of the node (before its prefix)
+		size_t index;
+		// the prefix of the node was already added to the values
+		bool prefixAdded;
+		int id;
+		// bits above the index of the node or all bits of the entry
+		unsigned long values[DIM];
+
+		bool operator>(const Candidate& other) const {
+			return distance > other.distance;
+		}
+	};
+
+	const DistanceMetric metric_;
+	const size_t k_;
+	unsigned long center_[DIM];
+	size_t nRemaining_;
+	Candidate current_;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue_;
+	// distances of the k nearest entries queued so far
+	std::priority_queue<double> nearestDistances_;
+
+	// visits subtrees until the nearest candidate is an entry
+	void findNext();
+	// queues the subnodes and entries of the node if they can be among the nearest entries
+	void expand(const Candidate& nodeCandidate);
+	void queueEntry(const unsigned long* values, int id);
+	void queueSubnode(const Node<DIM>* subnode, size_t index, const unsigned long* values);
+	// candidates farther away than this cannot be among the nearest entries
+	inline double maxDistance() const;
+};
+
+#include <assert.h>
+#include <cstdint>
+#include <limits>
+#include "Entry.h"
+#include "nodes/Node.h"
+#include "nodes/NodeRawContents.h"
+#include "util/MultiDimBitset.h"
+#include "util/SpatialSelectionOperationsUtil.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+KnnIterator<DIM, WIDTH>::KnnIterator(const Node<DIM>* root, const unsigned long* center,
+		size_t k, DistanceMetric metric) : metric_(metric), k_(k), center_(), nRemaining_(k),
+		current_(), queue_(), nearestDistances_() {
+	assert (root);
+	for (unsigned int d = 0; d < DIM; ++d) {
+		center_[d] = center[d];
+	}
+
+	if (k > 0) {
+		const unsigned long rootValues[DIM] = {};
+		queueSubnode(root, 0, rootValues);
+		findNext();
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool KnnIterator<DIM, WIDTH>::hasNext() const {
+	return nRemaining_ > 0 && !queue_.empty();
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Entry<DIM, WIDTH> KnnIterator<DIM, WIDTH>::next() {
+	const int id = nextId();
+	Entry<DIM, WIDTH> entry;
+	entry.reinit(current_.values, id);
+	return entry;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+int KnnIterator<DIM, WIDTH>::nextId() {
+	assert (hasNext());
+	current_ = queue_.top();
+	assert (!current_.node);
+	queue_.pop();
+	--nRemaining_;
+	if (nRemaining_ > 0) {
+		findNext();
+	}
+
+	return current_.id;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+double KnnIterator<DIM, WIDTH>::getDistance() const {
+	return DistanceUtil<DIM>::fromComparable(metric_, current_.distance);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void KnnIterator<DIM, WIDTH>::findNext() {
+	while (!queue_.empty() && queue_.top().node) {
+		const Candidate nodeCandidate = queue_.top();
+		queue_.pop();
+		expand(nodeCandidate);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void KnnIterator<DIM, WIDTH>::expand(const Candidate& nodeCandidate) {
+	NodeRawContents<DIM> contents;
+	nodeCandidate.node->getRawContents(contents);
+	const size_t index = nodeCandidate.index + contents.prefixLength;
+	assert (index < WIDTH);
+	const size_t hcBit = WIDTH - index - 1;
+
+	if (!nodeCandidate.prefixAdded && contents.prefixLength > 0) {
+		// the prefix narrows down the box of the subtree so the lower bound can only grow
+		Candidate withPrefix = nodeCandidate;
+		withPrefix.prefixAdded = true;
+		SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(contents.prefix,
+				DIM * contents.prefixLength, hcBit + 1, withPrefix.values);
+		unsigned long upper[DIM];
+		for (unsigned int d = 0; d < DIM; ++d) {
+			upper[d] = withPrefix.values[d] | MultiDimBitset<DIM>::lowerBitsMask(hcBit + 1);
+		}
+
+		withPrefix.distance = DistanceUtil<DIM>::minDistance(metric_, center_, withPrefix.values, upper);
+		if (withPrefix.distance > maxDistance()) {
+			return;
+		}
+
+		if (!queue_.empty() && withPrefix.distance > queue_.top().distance) {
+			// another candidate is nearer now
+			queue_.push(withPrefix);
+			return;
+		}
+
+		expand(withPrefix);
+		return;
+	}
+
+	const size_t suffixBits = DIM * hcBit;
+	const unsigned long flagMask = ~(3uL);
+	const unsigned long suffixAndIdMask = (-1uL) >> 32;
+	for (unsigned int row = contents.nextRow(0); row < contents.nRows; row = contents.nextRow(row + 1)) {
+		const unsigned long hcAddress = contents.getAddress(row);
+		const uintptr_t reference = contents.references[row];
+		assert (reference != 0);
+
+		unsigned long values[DIM];
+		for (unsigned int d = 0; d < DIM; ++d) {
+			values[d] = nodeCandidate.values[d] | (((hcAddress >> d) & 1uL) << hcBit);
+		}
+
+		const bool isSuffix = reference & 1;
+		const bool isPointer = (reference >> 1) & 1;
+		if (!isPointer && !isSuffix) {
+			// entries of a buffer that was not flushed yet
+			const EntryBuffer<DIM, WIDTH>* buffer = reinterpret_cast<const EntryBuffer<DIM, WIDTH>*>(reference);
+			auto queueBufferedEntry = [this, &values, suffixBits] (const unsigned long* suffixStartBlock, int id) {
+				unsigned long entryValues[DIM];
+				for (unsigned int d = 0; d < DIM; ++d) {
+					entryValues[d] = values[d];
+				}
+
+				if (suffixBits > 0) {
+					SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(
+							suffixStartBlock, suffixBits, 0, entryValues);
+				}
+
+				queueEntry(entryValues, id);
+			};
+
+			buffer->forEachCompletedEntry(queueBufferedEntry);
+		} else if (isPointer && !isSuffix) {
+			const Node<DIM>* subnode = reinterpret_cast<const Node<DIM>*>(reference & flagMask);
+			queueSubnode(subnode, index + 1, values);
+		} else {
+			if (suffixBits > 0) {
+				const unsigned long suffixPart = (reference & suffixAndIdMask) >> 2;
+				if (isPointer) {
+					assert (contents.suffixBlocks);
+					SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(
+							contents.suffixBlocks + suffixPart, suffixBits, 0, values);
+				} else {
+					SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(
+							&suffixPart, suffixBits, 0, values);
+				}
+			}
+
+			queueEntry(values, reference >> 32);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void KnnIterator<DIM, WIDTH>::queueEntry(const unsigned long* values, int id) {
+	const double distance = DistanceUtil<DIM>::minDistance(metric_, center_, values, values);
+	if (distance > maxDistance()) {
+		return;
+	}
+
+	nearestDistances_.push(distance);
+	if (nearestDistances_.size() > k_) {
+		nearestDistances_.pop();
+	}
+
+	Candidate candidate;
+	candidate.distance = distance;
+	candidate.node = NULL;
+	candidate.index = WIDTH;
+	candidate.prefixAdded = true;
+	candidate.id = id;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		candidate.values[d] = values[d];
+	}
+
+	queue_.push(candidate);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void KnnIterator<DIM, WIDTH>::queueSubnode(const Node<DIM>* subnode, size_t index, const unsigned long* values) {
+	assert (index < WIDTH);
+	// only the bits above the index are known before the prefix of the subnode is read
+	unsigned long upper[DIM];
+	for (unsigned int d = 0; d < DIM; ++d) {
+		upper[d] = values[d] | MultiDimBitset<DIM>::lowerBitsMask(WIDTH - index);
+	}
+
+	const double distance = DistanceUtil<DIM>::minDistance(metric_, center_, values, upper);
+	if (distance > maxDistance()) {
+		return;
+	}
+
+	Candidate candidate;
+	candidate.distance = distance;
+	candidate.node = subnode;
+	candidate.index = index;
+	candidate.prefixAdded = false;
+	candidate.id = 0;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		candidate.values[d] = values[d];
+	}
+
+	queue_.push(candidate);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+double KnnIterator<DIM, WIDTH>::maxDistance() const {
+	if (nearestDistances_.size() < k_) {
+		return numeric_limits<double>::infinity();
+	}
+
+	return nearestDistances_.top();
+}
+
+#endif /* SRC_ITERATORS_KNNITERATOR_H_ */
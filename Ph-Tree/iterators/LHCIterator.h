@@ -50,7 +50,7 @@ void LHCIterator<DIM, PREF_BLOCKS, N>::setAddress(size_t address) {
 	if (exists) {
 		// found address so set it
 		this-> address_ = address;
-	} else if (currentIndex > node_->m - 1) {
+	} else if (currentIndex >= node_->m) {
 		// did not find the address and it is not in the range
 		this->address_ = 1 << DIM;
 	} else {
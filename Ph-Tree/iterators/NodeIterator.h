@@ -29,6 +29,13 @@ protected:
 	unsigned long address_;
 };
 
+// memory for constructing a node iterator in place instead of on the heap
+template <unsigned int DIM>
+struct NodeIteratorStorage {
+	static const size_t size = 6 * sizeof (void*);
+	alignas (void*) char data_[size];
+};
+
 #include <stdexcept>
 
 template <unsigned int DIM>
@@ -1,7 +1,6 @@
 #ifndef SRC_ITERATORS_RANGEQUERYITERATOR_H_
 #define SRC_ITERATORS_RANGEQUERYITERATOR_H_
 
-#include <stack>
 #include "nodes/Node.h"
 #include "iterators/NodeIterator.h"
 #include "iterators/RangeQueryStackContent.h"
@@ -10,40 +9,52 @@
 
 template <unsigned int DIM>
 class Node;
+template <unsigned int DIM, unsigned int WIDTH>
+class PHTree;
 
 template <unsigned int DIM, unsigned int WIDTH>
 class RangeQueryIterator {
 public:
-	// TODO add version that does not recreate the spatial data but only returns IDs
 	RangeQueryIterator(std::vector<std::pair<unsigned long, const Node<DIM>*>>* nodeStack,
 			const Entry<DIM, WIDTH>& lowerLeft,
 			const Entry<DIM, WIDTH>& upperRight);
+	// creates an iterator without any entries that can be reset to different ranges of the tree
+	// and does not allocate any memory (can be placed on the stack)
+	explicit RangeQueryIterator(const PHTree<DIM, WIDTH>& tree);
 	virtual ~RangeQueryIterator();
 
+	// restarts the iteration on the given range
+	void reset(const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight);
+
 	Entry<DIM, WIDTH> next();
+	// only returns the ID of the next entry without recreating its values
+	int nextId();
 	bool hasNext() const;
 
 private:
 	static const size_t highestAddress = (1u << DIM) - 1;
 
+	// the tree to reset on (not set if the iterator was created from the visited nodes)
+	const PHTree<DIM, WIDTH>* tree_;
 	bool hasNext_;
 	size_t currentIndex_;
 
-	// TODO replace with array implementation
 	// stack of not fully traversed nodes
-	std::stack<RangeQueryStackContent<DIM>> stack_;
-	// relevant information for the currently processed node
-	RangeQueryStackContent<DIM> currentContent;
+	// (each node consumes at least one bit so the depth is limited by the bit width)
+	RangeQueryStackContent<DIM> stack_[WIDTH];
+	// relevant information for the currently processed node (top of the stack)
+	RangeQueryStackContent<DIM>* currentContent;
 	// storage for bits from higher nodes (lower levels from stack)
 	// Combined with a suffix this defines an entry.
 	unsigned long currentValue[1 + (DIM * WIDTH - 1) / (sizeof (unsigned long) * 8)];
 	// The address contents of the currently processed address in the currently processed node
 	NodeAddressContent<DIM> currentAddressContent;
 
-	const Entry<DIM, WIDTH> lowerLeftCorner_;
-	const Entry<DIM, WIDTH> upperRightCorner_;
-
+	Entry<DIM, WIDTH> lowerLeftCorner_;
+	Entry<DIM, WIDTH> upperRightCorner_;
 
+	void init(const Node<DIM>* root);
+	inline void releaseIterators(RangeQueryStackContent<DIM>* content);
 	void stepUp();
 	bool stepDown(const Node<DIM>* nextNode, unsigned long hcAddress);
 	inline bool isInMaskRange(unsigned long hcAddress) const;
@@ -73,38 +84,22 @@ private:
 #include <assert.h>
 #include "nodes/NodeAddressContent.h"
 #include "util/SpatialSelectionOperationsUtil.h"
+#include "PHTree.h"
 
 using namespace std;
 
 template <unsigned int DIM, unsigned int WIDTH>
 RangeQueryIterator<DIM, WIDTH>::RangeQueryIterator(vector<pair<unsigned long, const Node<DIM>*>>* visitedNodes,
-		const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight) : hasNext_(true),
-		currentIndex_(0), stack_(),
+		const Entry<DIM, WIDTH>& lowerLeft, const Entry<DIM, WIDTH>& upperRight) : tree_(NULL),
+		hasNext_(false), currentIndex_(0), currentContent(NULL),
 		currentValue(), lowerLeftCorner_(lowerLeft),
 		upperRightCorner_(upperRight) {
 
-#ifndef NDEBUG
-	// validation only: lower left < upper right
-	pair<unsigned long, unsigned long> comp = MultiDimBitset<DIM>::
-				compareSmallerEqual(lowerLeftCorner_.values_, upperRightCorner_.values_, DIM * WIDTH, 0, highestAddress);
-	assert ((comp.first == highestAddress) && "should be: lower left < upper right");
-#endif
-
 	assert (!visitedNodes->empty() && "at least the root node must have been visited");
-	if (visitedNodes->empty()) {
-		hasNext_ = false;
-	} else {
-		currentContent.fullyContained = false;
-		currentContent.lowerContained = false;
-		currentContent.upperContained = false;
-		// start: range window is fully included in domain
-		currentContent.lowerCompEqual = highestAddress;
-		currentContent.lowerCompSmaller = 0;
-		currentContent.upperCompEqual = highestAddress;
-		currentContent.upperCompSmaller = 0;
+	if (!visitedNodes->empty()) {
 		// the first node has to be the root node which does not have a prefix!
 		const Node<DIM>* root = (*visitedNodes)[0].second;
-		createCurrentContent(root, 0, 0);
+		init(root);
 		for (unsigned int i = 1; i < visitedNodes->size(); ++i) {
 			const pair<unsigned long, const Node<DIM>*> nextNode = (*visitedNodes)[i];
 			// TODO actually no need to validate prefixes since the lookup already did that?!
@@ -117,19 +112,71 @@ RangeQueryIterator<DIM, WIDTH>::RangeQueryIterator(vector<pair<unsigned long, co
 	}
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+RangeQueryIterator<DIM, WIDTH>::RangeQueryIterator(const PHTree<DIM, WIDTH>& tree) : tree_(&tree),
+		hasNext_(false), currentIndex_(0), currentContent(NULL),
+		currentValue(), lowerLeftCorner_(), upperRightCorner_() {
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 RangeQueryIterator<DIM, WIDTH>::~RangeQueryIterator() {
-	while (!stack_.empty()) {
-		RangeQueryStackContent<DIM> content = stack_.top();
-		delete content.startIt_;
-		delete content.endIt_;
-		stack_.pop();
+	if (currentContent) {
+		for (RangeQueryStackContent<DIM>* content = stack_; content <= currentContent; ++content) {
+			releaseIterators(content);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void RangeQueryIterator<DIM, WIDTH>::reset(const Entry<DIM, WIDTH>& lowerLeft,
+		const Entry<DIM, WIDTH>& upperRight) {
+	assert (tree_ && "can only reset iterators that were created for a tree");
+
+	if (currentContent) {
+		for (RangeQueryStackContent<DIM>* content = stack_; content <= currentContent; ++content) {
+			releaseIterators(content);
+		}
+	}
+
+	lowerLeftCorner_ = lowerLeft;
+	upperRightCorner_ = upperRight;
+	init(tree_->root_);
+	goToNextValidSuffix();
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void RangeQueryIterator<DIM, WIDTH>::init(const Node<DIM>* root) {
+#ifndef NDEBUG
+	// validation only: lower left < upper right
+	pair<unsigned long, unsigned long> comp = MultiDimBitset<DIM>::
+				compareSmallerEqual(lowerLeftCorner_.values_, upperRightCorner_.values_, DIM * WIDTH, 0, highestAddress);
+	assert ((comp.first == highestAddress) && "should be: lower left < upper right");
+#endif
+
+	hasNext_ = true;
+	currentIndex_ = 0;
+	// an aborted iteration might have left bits in the buffer
+	for (unsigned i = 0; i < 1 + (DIM * WIDTH - 1) / (sizeof (unsigned long) * 8); ++i) {
+		currentValue[i] = 0;
 	}
 
-	if (currentContent.startIt_)
-		delete currentContent.startIt_;
-	if (currentContent.endIt_)
-		delete currentContent.endIt_;
+	currentContent = stack_;
+	currentContent->fullyContained = false;
+	currentContent->lowerContained = false;
+	currentContent->upperContained = false;
+	// start: range window is fully included in domain
+	currentContent->lowerCompEqual = highestAddress;
+	currentContent->lowerCompSmaller = 0;
+	currentContent->upperCompEqual = highestAddress;
+	currentContent->upperCompSmaller = 0;
+	createCurrentContent(root, 0, 0);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void RangeQueryIterator<DIM, WIDTH>::releaseIterators(RangeQueryStackContent<DIM>* content) {
+	// the iterators were constructed in place so they are not deleted
+	content->startIt_->~NodeIterator<DIM>();
+	content->endIt_->~NodeIterator<DIM>();
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -157,25 +204,11 @@ Entry<DIM, WIDTH> RangeQueryIterator<DIM, WIDTH>::next() {
 
 #ifndef NDEBUG
 	// validation only: is the entry contained in the current node
-	assert (entry.id_ == currentContent.node_->lookup(currentAddressContent.address, true).id);
+	assert (entry.id_ == currentContent->node_->lookup(currentAddressContent.address, true).id);
 
 	// validation only: is the retrieved entry part of the tree?
-	const Node<DIM>* rootNode = NULL;
-	if (stack_.empty()) rootNode = currentContent.node_;
-	else {
-		// the root node is at the bottom of the stack
-		stack<RangeQueryStackContent<DIM>> reverseStack;
-		while (!stack_.empty()) {
-			RangeQueryStackContent<DIM> top = stack_.top();
-			rootNode = top.node_;
-			reverseStack.push(top);
-			stack_.pop();
-		}
-		while (!reverseStack.empty()) {
-			stack_.push(reverseStack.top());
-			reverseStack.pop();
-		}
-	}
+	// the root node is at the bottom of the stack
+	const Node<DIM>* rootNode = stack_[0].node_;
 
 	std::pair<bool, int> lookup = SpatialSelectionOperationsUtil<DIM, WIDTH>::lookup(entry, rootNode, NULL);
 	assert (lookup.first && lookup.second == entry.id_);
@@ -190,42 +223,57 @@ Entry<DIM, WIDTH> RangeQueryIterator<DIM, WIDTH>::next() {
 	assert (((upperComp.first | upperComp.second) == highestAddress) && "should be: entry <= upper right");
 #endif
 
-	++(*currentContent.startIt_);
+	++(*currentContent->startIt_);
 	goToNextValidSuffix();
 
 	return entry;
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+int RangeQueryIterator<DIM, WIDTH>::nextId() {
+	assert (hasNext());
+	assert (currentAddressContent.exists && isInMaskRange(currentAddressContent.address)
+		&& !currentAddressContent.hasSubnode);
+
+	// the suffix was already validated while searching for it
+	// so there is no need to copy the prefixes and the suffix into an entry
+	const int id = currentAddressContent.id;
+	++(*currentContent->startIt_);
+	goToNextValidSuffix();
+
+	return id;
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 void RangeQueryIterator<DIM, WIDTH>::goToNextValidSuffix() {
 	assert (hasNext_);
 
 	do {
-		while ((*currentContent.startIt_) == (*currentContent.endIt_) && hasNext_) {
+		while ((*currentContent->startIt_) == (*currentContent->endIt_) && hasNext_) {
 			// ascend to a previous level if the end of the node was reached
 			stepUp();
-			++(*currentContent.startIt_);
-			assert (!hasNext_ || (*currentContent.startIt_) <= (*currentContent.endIt_));
+			++(*currentContent->startIt_);
+			assert (!hasNext_ || (*currentContent->startIt_) <= (*currentContent->endIt_));
 		}
 
 		if (!hasNext_) break;
-		currentAddressContent = *(*currentContent.startIt_);
+		currentAddressContent = *(*currentContent->startIt_);
 		assert (currentAddressContent.exists);
 		if (!isInMaskRange(currentAddressContent.address)) {
-			++(*currentContent.startIt_);
+			++(*currentContent->startIt_);
 		} else if (currentAddressContent.hasSubnode) {
 			// descend to the next level in case of a subnode
 			bool prefixIncluded = stepDown(currentAddressContent.subnode, currentAddressContent.address);
 			if (!prefixIncluded) {
 				// the prefix of the current node was not included so do not descend
-				++(*currentContent.startIt_);
+				++(*currentContent->startIt_);
 			}
 		} else if (isSuffixInRange()) {
 			// found a suffix with a valid address
 			break;
 		} else {
 			// the suffix was invalid so continue the search
-			++(*currentContent.startIt_);
+			++(*currentContent->startIt_);
 		}
 	} while (hasNext_);
 
@@ -240,12 +288,12 @@ bool RangeQueryIterator<DIM, WIDTH>::hasNext() const {
 template <unsigned int DIM, unsigned int WIDTH>
 bool RangeQueryIterator<DIM, WIDTH>::isInMaskRange(unsigned long hcAddress) const {
 
-	assert (currentContent.upperMask_ < (1uL << DIM));
-	assert (currentContent.lowerMask_ <= currentContent.upperMask_);
-	assert (currentContent.lowerMask_ <= hcAddress && hcAddress <= currentContent.upperMask_);
+	assert (currentContent->upperMask_ < (1uL << DIM));
+	assert (currentContent->lowerMask_ <= currentContent->upperMask_);
+	assert (currentContent->lowerMask_ <= hcAddress && hcAddress <= currentContent->upperMask_);
 
-	const bool addressMatch = currentContent.fullyContained
-			|| (((hcAddress | currentContent.lowerMask_) & currentContent.upperMask_) == hcAddress);
+	const bool addressMatch = currentContent->fullyContained
+			|| (((hcAddress | currentContent->lowerMask_) & currentContent->upperMask_) == hcAddress);
 	return addressMatch;
 }
 
@@ -255,7 +303,7 @@ bool RangeQueryIterator<DIM, WIDTH>::isSuffixInRange() {
 			&& isInMaskRange(currentAddressContent.address));
 	assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, DIM * (WIDTH - currentIndex_), 0));
 
-	if (currentContent.fullyContained) { return true; }
+	if (currentContent->fullyContained) { return true; }
 
 	// <prev. compared>
 	//                 <---- local comparison --->
@@ -273,13 +321,13 @@ bool RangeQueryIterator<DIM, WIDTH>::isSuffixInRange() {
 	// local comparison: compare the entire suffix and the current address
 	const unsigned int compareLowestNBits = suffixBits + DIM;
 	// validate: range lower left <= entry (suffix)
-	if (!currentContent.lowerContained) {
+	if (!currentContent->lowerContained) {
 		unsigned long lowerCompRangeEqualLocal;
 		unsigned long lowerCompRangeSmallerLocal;
 		compareLocalRangeLower(0, compareLowestNBits, &lowerCompRangeEqualLocal, &lowerCompRangeSmallerLocal);
 		unsigned long lowerCompEqualWithSuffix;
 		unsigned long lowerCompSmallerWithSuffix;
-		connectLocalToPrevLower(currentContent.lowerCompEqual, currentContent.lowerCompSmaller,
+		connectLocalToPrevLower(currentContent->lowerCompEqual, currentContent->lowerCompSmaller,
 				lowerCompRangeEqualLocal, lowerCompRangeSmallerLocal,
 				&lowerCompEqualWithSuffix, &lowerCompSmallerWithSuffix);
 
@@ -288,13 +336,13 @@ bool RangeQueryIterator<DIM, WIDTH>::isSuffixInRange() {
 	}
 
 	// validate: entry (suffix) <= range upper right
-	if (suffixContained && !currentContent.upperContained) {
+	if (suffixContained && !currentContent->upperContained) {
 		unsigned long upperCompRangeEqualLocal;
 		unsigned long upperCompRangeSmallerLocal;
 		compareLocalRangeUpper(0, compareLowestNBits, &upperCompRangeEqualLocal, &upperCompRangeSmallerLocal);
 		unsigned long upperCompEqualWithSuffix;
 		unsigned long upperCompSmallerWithSuffix;
-		connectLocalToPrevUpper(currentContent.upperCompEqual, currentContent.upperCompSmaller,
+		connectLocalToPrevUpper(currentContent->upperCompEqual, currentContent->upperCompSmaller,
 				upperCompRangeEqualLocal, upperCompRangeSmallerLocal,
 				&upperCompEqualWithSuffix, &upperCompSmallerWithSuffix);
 
@@ -323,16 +371,16 @@ bool RangeQueryIterator<DIM, WIDTH>::isSuffixInRange() {
 template <unsigned int DIM, unsigned int WIDTH>
 void RangeQueryIterator<DIM, WIDTH>::stepUp() {
 	assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, DIM * (WIDTH - currentIndex_), 0));
-	assert ((*currentContent.startIt_) == (*currentContent.endIt_));
+	assert ((*currentContent->startIt_) == (*currentContent->endIt_));
 	// TODO if several stack contents are skipped only a single remove operation is needed!
-	if (stack_.empty()) {
+	if (currentContent == stack_) {
 		hasNext_ = false;
-		assert (currentContent.prefixLength_ == 0
+		assert (currentContent->prefixLength_ == 0
 				&& "the last node should be the root which does not have a prefix");
 		assert (currentIndex_ == 0);
 	} else {
 		// remove the prefix of the last node
-		const size_t prefixLength = currentContent.prefixLength_;
+		const size_t prefixLength = currentContent->prefixLength_;
 		if (prefixLength > 0) {
 			// remove current interleaved address (1) and prefix (+ prefixLength) bits (*DIM)
 			currentIndex_ -= (prefixLength + 1);
@@ -346,13 +394,9 @@ void RangeQueryIterator<DIM, WIDTH>::stepUp() {
 			assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, DIM * (WIDTH - currentIndex_), 0));
 		}
 
-		// clear memory
-		delete currentContent.startIt_;
-		delete currentContent.endIt_;
-
 		// restore the last contents from the top of the stack
-		currentContent = stack_.top();
-		stack_.pop();
+		releaseIterators(currentContent);
+		--currentContent;
 	}
 }
 
@@ -360,7 +404,7 @@ template <unsigned int DIM, unsigned int WIDTH>
 bool RangeQueryIterator<DIM, WIDTH>::stepDown(const Node<DIM>* nextNode, unsigned long hcAddress) {
 	assert (nextNode && hcAddress < (1uL << DIM));
 	assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, DIM * (WIDTH - currentIndex_), 0));
-	assert ((*currentContent.startIt_) < (*currentContent.endIt_));
+	assert ((*currentContent->startIt_) < (*currentContent->endIt_));
 
 	// msb               [interleaved format]                      lsb
 	// <-filled-><DIM><DIM *|prefix|><DIM><-------- ignored --------->
@@ -374,10 +418,10 @@ bool RangeQueryIterator<DIM, WIDTH>::stepDown(const Node<DIM>* nextNode, unsigne
 	currentIndex_ += 1;
 	MultiDimBitset<DIM>::pushBackValue(hcAddress, currentValue, (WIDTH - currentIndex_) * DIM);
 	const size_t prefixLength = nextNode->getPrefixLength();
-	unsigned long lowerCompEqualWithPrefix = currentContent.lowerCompEqual;
-	unsigned long lowerCompSmallerWithPrefix = currentContent.lowerCompSmaller;
-	unsigned long upperCompEqualWithPrefix = currentContent.upperCompEqual;
-	unsigned long upperCompSmallerWithPrefix = currentContent.upperCompSmaller;
+	unsigned long lowerCompEqualWithPrefix = currentContent->lowerCompEqual;
+	unsigned long lowerCompSmallerWithPrefix = currentContent->lowerCompSmaller;
+	unsigned long upperCompEqualWithPrefix = currentContent->upperCompEqual;
+	unsigned long upperCompSmallerWithPrefix = currentContent->upperCompSmaller;
 	unsigned long lastAddress = hcAddress;
 	if (prefixLength > 0) {
 		// add the prefix of the next node to the current prefix
@@ -390,11 +434,11 @@ bool RangeQueryIterator<DIM, WIDTH>::stepDown(const Node<DIM>* nextNode, unsigne
 		const unsigned int compareNBits = DIM * prefixLength + DIM;
 		// varify if the prefix is still within the range
 		bool prefixValid = true;
-		if (!currentContent.lowerContained) {
+		if (!currentContent->lowerContained) {
 			unsigned long lowerCompRangeEqualLocal;
 			unsigned long lowerCompRangeSmallerLocal;
 			compareLocalRangeLower(ignoreNLowestBits, compareNBits, &lowerCompRangeEqualLocal, &lowerCompRangeSmallerLocal);
-			connectLocalToPrevLower(currentContent.lowerCompEqual, currentContent.lowerCompSmaller,
+			connectLocalToPrevLower(currentContent->lowerCompEqual, currentContent->lowerCompSmaller,
 					lowerCompRangeEqualLocal, lowerCompRangeSmallerLocal,
 					&lowerCompEqualWithPrefix, &lowerCompSmallerWithPrefix);
 
@@ -402,11 +446,11 @@ bool RangeQueryIterator<DIM, WIDTH>::stepDown(const Node<DIM>* nextNode, unsigne
 			prefixValid = (lowerCompEqualWithPrefix | lowerCompSmallerWithPrefix) == highestAddress;
 		}
 
-		if (prefixValid && !currentContent.upperContained) {
+		if (prefixValid && !currentContent->upperContained) {
 			unsigned long upperCompRangeEqualLocal;
 			unsigned long upperCompRangeSmallerLocal;
 			compareLocalRangeUpper(ignoreNLowestBits, compareNBits, &upperCompRangeEqualLocal, &upperCompRangeSmallerLocal);
-			connectLocalToPrevUpper(currentContent.upperCompEqual, currentContent.upperCompSmaller,
+			connectLocalToPrevUpper(currentContent->upperCompEqual, currentContent->upperCompSmaller,
 					upperCompRangeEqualLocal, upperCompRangeSmallerLocal,
 					&upperCompEqualWithPrefix, &upperCompSmallerWithPrefix);
 
@@ -437,11 +481,13 @@ bool RangeQueryIterator<DIM, WIDTH>::stepDown(const Node<DIM>* nextNode, unsigne
 	}
 
 	// puts a duplicate on the stack
-	stack_.push(currentContent);
-	currentContent.lowerCompEqual = lowerCompEqualWithPrefix;
-	currentContent.lowerCompSmaller = lowerCompSmallerWithPrefix;
-	currentContent.upperCompEqual = upperCompEqualWithPrefix;
-	currentContent.upperCompSmaller = upperCompSmallerWithPrefix;
+	assert (currentContent + 1 < stack_ + WIDTH);
+	*(currentContent + 1) = *currentContent;
+	++currentContent;
+	currentContent->lowerCompEqual = lowerCompEqualWithPrefix;
+	currentContent->lowerCompSmaller = lowerCompSmallerWithPrefix;
+	currentContent->upperCompEqual = upperCompEqualWithPrefix;
+	currentContent->upperCompSmaller = upperCompSmallerWithPrefix;
 
 	createCurrentContent(nextNode, lastAddress, prefixLength);
 	assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, DIM * (WIDTH - currentIndex_), 0));
@@ -496,7 +542,7 @@ template <unsigned int DIM, unsigned int WIDTH>
 void RangeQueryIterator<DIM, WIDTH>::compareLocalRangeLower(unsigned int skipLowerNBits, unsigned int compareNBits,
 			unsigned long* outCompEqual, unsigned long* outCompSmaller) const {
 	// all dimensions need to be compared where the lower left range is not already < current
-	unsigned long compareDimMask = currentContent.lowerCompEqual | (highestAddress & (~currentContent.lowerCompSmaller));
+	unsigned long compareDimMask = currentContent->lowerCompEqual | (highestAddress & (~currentContent->lowerCompSmaller));
 	pair<unsigned long, unsigned long> lowerComp = MultiDimBitset<DIM>::compareSmallerEqual(
 			lowerLeftCorner_.values_, currentValue,
 			skipLowerNBits + compareNBits, skipLowerNBits,
@@ -509,7 +555,7 @@ template <unsigned int DIM, unsigned int WIDTH>
 void RangeQueryIterator<DIM, WIDTH>::compareLocalRangeUpper(unsigned int skipLowerNBits, unsigned int compareNBits,
 			unsigned long* outCompEqual, unsigned long* outCompSmaller) const {
 	// all dimensions need to be compared where the upper right range is not already > current
-	unsigned long compareDimMask = currentContent.upperCompEqual | currentContent.upperCompSmaller;
+	unsigned long compareDimMask = currentContent->upperCompEqual | currentContent->upperCompSmaller;
 	pair<unsigned long, unsigned long> upperComp = MultiDimBitset<DIM>::compareSmallerEqual(
 			upperRightCorner_.values_, currentValue,
 			skipLowerNBits + compareNBits, skipLowerNBits,
@@ -522,8 +568,8 @@ template <unsigned int DIM, unsigned int WIDTH>
 void RangeQueryIterator<DIM, WIDTH>::createCurrentContent(const Node<DIM>* nextNode,
 		unsigned long hcAddress, unsigned int prefixLength) {
 
-	currentContent.node_ = nextNode;
-	currentContent.prefixLength_ = prefixLength;
+	currentContent->node_ = nextNode;
+	currentContent->prefixLength_ = prefixLength;
 	assert (nextNode->getPrefixLength() == prefixLength);
 
 #ifndef NDEBUG
@@ -553,7 +599,7 @@ void RangeQueryIterator<DIM, WIDTH>::createCurrentContent(const Node<DIM>* nextN
 	// calculate current local lower comparisons
 	unsigned long lowerCompEqualLocal = highestAddress;
 	unsigned long lowerCompSmallerLocal = 0;
-	if (!currentContent.fullyContained && !currentContent.lowerContained) {
+	if (!currentContent->fullyContained && !currentContent->lowerContained) {
 		// <-filled-><DIM><-------- ignored --------->
 		// [ higher |00000|     lower node bits      ]
 		const unsigned long prevLowerHC = (currentIndex_ == 0)? 0 : MultiDimBitset<DIM>::interleaveBits(lowerLeftCorner_.values_, currentIndex_ - 1, DIM * WIDTH);
@@ -562,30 +608,27 @@ void RangeQueryIterator<DIM, WIDTH>::createCurrentContent(const Node<DIM>* nextN
 	}
 
 	// combine lower local comparison with previous lower comparison
-	if (!currentContent.lowerContained) {
-		const unsigned long lastLowerCompEqual = currentContent.lowerCompEqual;
-		const unsigned long lastLowerCompSmaller = currentContent.lowerCompSmaller;
+	if (!currentContent->lowerContained) {
+		const unsigned long lastLowerCompEqual = currentContent->lowerCompEqual;
+		const unsigned long lastLowerCompSmaller = currentContent->lowerCompSmaller;
 		connectLocalToPrevLower(lastLowerCompEqual, lastLowerCompSmaller, lowerCompEqualLocal, lowerCompSmallerLocal,
-				&(currentContent.lowerCompEqual), &(currentContent.lowerCompSmaller));
+				&(currentContent->lowerCompEqual), &(currentContent->lowerCompSmaller));
 
 		// lower mask: for i=0 to DIM - 1 do
 		// 		lowerMask[i] = 0 <=> current value (in dimension i) is less or equal to the lower left corner (in dimension i)
-		currentContent.lowerMask_ =  highestAddress & (~(currentContent.lowerCompSmaller | currentContent.lowerCompEqual));
-		currentContent.lowerContained = (currentContent.lowerCompEqual == 0)
-				&& (currentContent.lowerCompSmaller == highestAddress);
+		currentContent->lowerMask_ =  highestAddress & (~(currentContent->lowerCompSmaller | currentContent->lowerCompEqual));
+		currentContent->lowerContained = (currentContent->lowerCompEqual == 0)
+				&& (currentContent->lowerCompSmaller == highestAddress);
 	}
 
 	// set the start iterator
-	if (currentContent.lowerContained) { // TODO or if the value is 0
-		currentContent.startIt_ = nextNode->begin();
-	} else {
-		currentContent.startIt_ = nextNode->it(currentContent.lowerMask_);
-	}
+	const unsigned long startAddress = (currentContent->lowerContained)? 0 : currentContent->lowerMask_;
+	currentContent->startIt_ = nextNode->it(startAddress, currentContent->startItStorage_);
 
 	// calculate current local upper comparisons
 	unsigned long upperCompEqualLocal = highestAddress;
 	unsigned long upperCompSmallerLocal = 0;
-	if (!currentContent.fullyContained && !currentContent.upperContained) {
+	if (!currentContent->fullyContained && !currentContent->upperContained) {
 		// <-filled-><DIM><-------- ignored --------->
 		// [ higher |11111|     lower node bits      ]
 		const unsigned long prevUpperHC = (currentIndex_ == 0)? 0 : MultiDimBitset<DIM>::interleaveBits(upperRightCorner_.values_, currentIndex_ - 1, DIM * WIDTH);
@@ -594,45 +637,42 @@ void RangeQueryIterator<DIM, WIDTH>::createCurrentContent(const Node<DIM>* nextN
 	}
 
 	// combine lower local comparison with previous lower comparison
-	if (!currentContent.upperContained) {
-		const unsigned long lastUpperCompEqual = currentContent.upperCompEqual;
-		const unsigned long lastUpperCompSmaller = currentContent.upperCompSmaller;
+	if (!currentContent->upperContained) {
+		const unsigned long lastUpperCompEqual = currentContent->upperCompEqual;
+		const unsigned long lastUpperCompSmaller = currentContent->upperCompSmaller;
 		connectLocalToPrevUpper(lastUpperCompEqual, lastUpperCompSmaller, upperCompEqualLocal, upperCompSmallerLocal,
-				&(currentContent.upperCompEqual), &(currentContent.upperCompSmaller));
+				&(currentContent->upperCompEqual), &(currentContent->upperCompSmaller));
 
 		// upper mask: for i=0 to DIM - 1 do
 		// 		lowerMask[i] = 1 <=> current value (in dimension i) is higher or equal to upper right corner (in dimension i)
-		currentContent.upperMask_ = highestAddress & ((~currentContent.upperCompSmaller) | currentContent.upperCompEqual);
-		currentContent.upperContained = (currentContent.upperCompEqual == 0)
-				&& (currentContent.upperCompSmaller == 0);
+		currentContent->upperMask_ = highestAddress & ((~currentContent->upperCompSmaller) | currentContent->upperCompEqual);
+		currentContent->upperContained = (currentContent->upperCompEqual == 0)
+				&& (currentContent->upperCompSmaller == 0);
 	}
 
 	// set the start iterator
-	if (currentContent.upperContained) { // TODO or if the value is highestAddress
-		currentContent.endIt_ = nextNode->end();
-	} else {
-		currentContent.endIt_ = nextNode->it(currentContent.upperMask_ + 1);
-	}
+	const unsigned long endAddress = (currentContent->upperContained)? (1uL << DIM) : currentContent->upperMask_ + 1;
+	currentContent->endIt_ = nextNode->it(endAddress, currentContent->endItStorage_);
 
-	currentContent.fullyContained = currentContent.lowerMask_ == 0
-					&& currentContent.upperMask_ == highestAddress
-					&& currentContent.upperCompEqual == 0
-					&& currentContent.lowerCompEqual == 0;
+	currentContent->fullyContained = currentContent->lowerMask_ == 0
+					&& currentContent->upperMask_ == highestAddress
+					&& currentContent->upperCompEqual == 0
+					&& currentContent->lowerCompEqual == 0;
 
 #ifndef NDEBUG
 	// validation:
 	// - are the local and connected values possible?
 	assert ((lowerCompEqualLocal & lowerCompSmallerLocal) == 0);
 	assert ((upperCompEqualLocal & upperCompSmallerLocal) == 0);
-	assert ((currentContent.lowerCompEqual & currentContent.lowerCompSmaller) == 0);
-	assert ((currentContent.upperCompEqual & currentContent.upperCompSmaller) == 0);
+	assert ((currentContent->lowerCompEqual & currentContent->lowerCompSmaller) == 0);
+	assert ((currentContent->upperCompEqual & currentContent->upperCompSmaller) == 0);
 
 	// - are the <= comparisons for the lower range correctly assembled?
 	pair<unsigned long, unsigned long> fullLowerComp = MultiDimBitset<DIM>::
 				compareSmallerEqual(lowerLeftCorner_.values_, currentValue, DIM * WIDTH, ignoreNLowestBits, highestAddress);
 	unsigned int fullLowerMask =  highestAddress & (~(fullLowerComp.first | fullLowerComp.second));
-	assert (fullLowerComp.first == currentContent.lowerCompSmaller && fullLowerComp.second == currentContent.lowerCompEqual);
-	assert (fullLowerMask == currentContent.lowerMask_);
+	assert (fullLowerComp.first == currentContent->lowerCompSmaller && fullLowerComp.second == currentContent->lowerCompEqual);
+	assert (fullLowerMask == currentContent->lowerMask_);
 
 	// - are the <= comparisons for the upper range correctly assembled?
 	MultiDimBitset<DIM>::pushBackValue(highestAddress, currentValue, ignoreNLowestBits);
@@ -641,18 +681,18 @@ void RangeQueryIterator<DIM, WIDTH>::createCurrentContent(const Node<DIM>* nextN
 	MultiDimBitset<DIM>::clearValue(currentValue, ignoreNLowestBits);
 	assert (MultiDimBitset<DIM>::checkRangeUnset(currentValue, ignoreNLowestBits, 0));
 	unsigned int fullUpperMask = highestAddress & ((~fullUpperComp.first) | fullUpperComp.second);
-	assert (fullUpperComp.first == currentContent.upperCompSmaller && fullUpperComp.second == currentContent.upperCompEqual);
-	assert (fullUpperMask == currentContent.upperMask_);
+	assert (fullUpperComp.first == currentContent->upperCompSmaller && fullUpperComp.second == currentContent->upperCompEqual);
+	assert (fullUpperMask == currentContent->upperMask_);
 
 	// - do the mask values have the correct order and are the iterators correctly set?
-	assert (currentContent.lowerMask_ <= currentContent.upperMask_ && currentContent.upperMask_ < (1uL << DIM));
-	assert ((*currentContent.startIt_) <= (*currentContent.endIt_));
-	assert (currentContent.lowerMask_ <= currentContent.startIt_->getAddress());
-	assert (currentContent.upperMask_ < currentContent.endIt_->getAddress());
+	assert (currentContent->lowerMask_ <= currentContent->upperMask_ && currentContent->upperMask_ < (1uL << DIM));
+	assert ((*currentContent->startIt_) <= (*currentContent->endIt_));
+	assert (currentContent->lowerMask_ <= currentContent->startIt_->getAddress());
+	assert (currentContent->upperMask_ < currentContent->endIt_->getAddress());
 
 	// - if the lower and upper range is contained than the node definitely fully contained
 	// notice that the inversion is not always tree
-	assert (!(currentContent.lowerContained && currentContent.upperContained) || currentContent.fullyContained);
+	assert (!(currentContent->lowerContained && currentContent->upperContained) || currentContent->fullyContained);
 #endif
 }
 
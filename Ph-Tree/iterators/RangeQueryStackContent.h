@@ -26,9 +26,11 @@ public:
 	unsigned long upperCompSmaller;
 
 	const Node<DIM>* node_;
-	// TODO make iterators lokal
+	// both iterators point into the storages below
 	NodeIterator<DIM>* startIt_;
 	NodeIterator<DIM>* endIt_;
+	NodeIteratorStorage<DIM> startItStorage_;
+	NodeIteratorStorage<DIM> endItStorage_;
 };
 
 #endif /* SRC_ITERATORS_RANGEQUERYSTACKCONTENT_H_ */
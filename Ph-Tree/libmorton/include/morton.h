@@ -5,6 +5,7 @@
 
 #include "morton2D.h"
 #include "morton3D.h"
+#include "morton_BMI.h"
 
 // ENCODE
 inline uint_fast32_t morton2D_32_encode(const uint_fast16_t x, const uint_fast16_t y);
@@ -1,5 +1,65 @@
 #pragma once
 
+// Libmorton - Bit deposit/extract methods for Morton codes of any dimensionality
+// The BMI2 methods (PDEP/PEXT) are compiled for the BMI2 target independent of the compiler flags
+// and must only be called if m_bmi2_supported() holds. Functions calling them should be compiled
+// for the BMI2 target as well (M_BMI2_TARGET) so the instructions are inlined.
+
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define M_BMI2_AVAILABLE 1
+#define M_BMI2_TARGET __attribute__((target("bmi2")))
+#else
+#define M_BMI2_AVAILABLE 0
+#define M_BMI2_TARGET
+#endif
+
+// RUNTIME CHECK
+inline bool m_bmi2_supported() {
 #if defined(__BMI2__)
+	return true;
+#elif M_BMI2_AVAILABLE
+	// may run in a static initializer before the CPU features are known otherwise
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("bmi2");
+#else
+	return false;
+#endif
+}
+
+#if M_BMI2_AVAILABLE
+// DEPOSIT the lowest bits of x at the set bits of mask (BMI2)
+M_BMI2_TARGET inline uint_fast64_t m_pdep_64(const uint_fast64_t x, const uint_fast64_t mask) {
+	return _pdep_u64(x, mask);
+}
 
+// EXTRACT the bits of x at the set bits of mask into the lowest bits (BMI2)
+M_BMI2_TARGET inline uint_fast64_t m_pext_64(const uint_fast64_t x, const uint_fast64_t mask) {
+	return _pext_u64(x, mask);
+}
 #endif
+
+// DEPOSIT without BMI2: visits the set bits of the mask from the lowest one
+inline uint_fast64_t m_pdep_64_for(uint_fast64_t x, uint_fast64_t mask) {
+	uint_fast64_t answer = 0;
+	while (mask) {
+		const uint_fast64_t lowest = mask & (~mask + 1);
+		answer |= (x & 1) ? lowest : 0;
+		x >>= 1;
+		mask ^= lowest;
+	}
+	return answer;
+}
+
+// EXTRACT without BMI2: visits the set bits of the mask from the lowest one
+inline uint_fast64_t m_pext_64_for(const uint_fast64_t x, uint_fast64_t mask) {
+	uint_fast64_t answer = 0;
+	for (unsigned int i = 0; mask; ++i) {
+		const uint_fast64_t lowest = mask & (~mask + 1);
+		answer |= (x & lowest) ? (uint_fast64_t(1) << i) : 0;
+		mask ^= lowest;
+	}
+	return answer;
+}
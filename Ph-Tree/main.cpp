@@ -1,6 +1,16 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <assert.h>
 
 #ifndef BOOST_THREAD_VERSION
@@ -10,6 +20,7 @@
 
 #include "Entry.h"
 #include "PHTree.h"
+#include "FrozenPHTree.h"
 #include "util/PlotUtil.h"
 #include "util/rdtsc.h"
 #include "visitors/CountNodeTypesVisitor.h"
@@ -160,6 +171,14 @@ int mainFull1DExample() {
 
 			assert (nIntersects == (1 + width));
 			delete it;
+
+			vector<int> ids;
+			phtree->rangeQueryIds({lower}, {lower + width}, ids);
+			assert (ids.size() == (1 + width));
+
+			size_t nCallbacks = 0;
+			phtree->forEachInRange({lower}, {lower + width}, [&nCallbacks](int id) { ++nCallbacks; });
+			assert (nCallbacks == (1 + width));
 		}
 	}
 
@@ -202,6 +221,680 @@ int mainSharing1DExample() {
 	return 1;
 }
 
+int mainErase1DExample() {
+	const unsigned int bitLength = 6;
+	PHTree<1, bitLength>* phtree = new PHTree<1, bitLength>();
+
+	const unsigned long upperBoundary = (1uL << bitLength);
+	for (unsigned long i = 0; i < upperBoundary; ++i) {
+		phtree->insert({i}, i);
+	}
+
+	// remove every second entry so that nodes have to be merged
+	for (unsigned long i = 0; i < upperBoundary; i += 2) {
+		const bool erased = phtree->erase({i});
+		const bool erasedTwice = phtree->erase({i});
+		assert (erased && !erasedTwice);
+	}
+
+	cout << (*phtree) << endl;
+
+	for (unsigned long i = 0; i < upperBoundary; ++i) {
+		assert (phtree->lookup({i}).first == (i % 2 == 1));
+	}
+
+	RangeQueryIterator<1, bitLength>* it = phtree->rangeQuery({0}, {upperBoundary - 1});
+	unsigned int points = 0;
+	while (it->hasNext()) {
+		it->next();
+		points++;
+	}
+	assert (points == upperBoundary / 2);
+	delete it;
+
+	for (unsigned long i = 1; i < upperBoundary; i += 2) {
+		const bool erased = phtree->erase({i});
+		assert (erased);
+	}
+
+	assert (!phtree->lookup({1}).first);
+	delete phtree;
+	return 0;
+}
+
+int mainBulkLoadExample() {
+	const unsigned int bitLength = 10;
+	const size_t nValues = 2000;
+
+	// distinct values in random order
+	vector<vector<unsigned long>> values;
+	vector<int> ids;
+	for (unsigned long i = 0; i < nValues; ++i) {
+		values.push_back({i % 1000, (i * 7) % 1024, i / 1000});
+	}
+	shuffle(values.begin(), values.end(), mt19937(42));
+	for (size_t i = 0; i < nValues; ++i) {
+		ids.push_back(i);
+	}
+
+	// every second value once as it is stored and once with a last dimension that is missing
+	vector<vector<unsigned long>> lookups;
+	for (size_t i = 0; i < nValues; i += 2) {
+		lookups.push_back(values[i]);
+		lookups.push_back({values[i][0], values[i][1], 2});
+	}
+
+	for (unsigned int loader = 0; loader < 4; ++loader) {
+		PHTree<3, bitLength>* phtree = new PHTree<3, bitLength>();
+		switch (loader) {
+		case 0: phtree->bulkLoad(values, ids); break;
+		case 1: phtree->parallelBulkLoad(values, &ids, 4); break;
+		case 2: phtree->bulkInsert(values, ids); break;
+		default: phtree->parallelBulkInsert(values, &ids, 4); break;
+		}
+
+		for (size_t i = 0; i < nValues; ++i) {
+			const pair<bool, int> result = phtree->lookup(values[i]);
+			assert (result.first && result.second == ids[i]);
+		}
+
+		vector<pair<bool, int>> results;
+		phtree->lookupBatch(PointSpan<3>(lookups), results);
+		assert (results.size() == lookups.size());
+		for (size_t i = 0; i < lookups.size(); ++i) {
+			assert (results[i] == phtree->lookup(lookups[i]));
+			assert (results[i].first == (i % 2 == 0));
+		}
+
+		size_t nInRange = 0;
+		phtree->forEachInRange({0, 0, 0}, {499, 1023, 1}, [&nInRange](int id) { ++nInRange; });
+		assert (nInRange == nValues / 2);
+
+		// the loaded nodes can be changed like inserted ones
+		for (size_t i = 0; i < nValues; i += 2) {
+			const bool erased = phtree->erase(values[i]);
+			assert (erased);
+		}
+
+		for (size_t i = 0; i < nValues; ++i) {
+			assert (phtree->lookup(values[i]).first == (i % 2 == 1));
+		}
+
+		delete phtree;
+	}
+
+	return 0;
+}
+
+// the distance between the values as returned by KnnIterator::getDistance()
+double bruteForceDistance(DistanceMetric metric, const vector<unsigned long>& v1, const vector<unsigned long>& v2) {
+	double sum = 0.0;
+	for (unsigned int d = 0; d < v1.size(); ++d) {
+		const double difference = (v1[d] > v2[d])? v1[d] - v2[d] : v2[d] - v1[d];
+		sum += (metric == euclidean_distance)? difference * difference : difference;
+	}
+
+	return (metric == euclidean_distance)? sqrt(sum) : sum;
+}
+
+// distinct values in four clusters so that some nodes have long prefixes
+template <unsigned int WIDTH>
+vector<vector<unsigned long>> insertClusteredValues(PHTree<2, WIDTH>* phtree, size_t nValues) {
+	mt19937 generator(42);
+	uniform_int_distribution<unsigned long> distribution(0, 63);
+	vector<vector<unsigned long>> values;
+	while (values.size() < nValues) {
+		const unsigned long cluster = 64 * (values.size() % 4);
+		const vector<unsigned long> value = {cluster + distribution(generator), 2 * distribution(generator)};
+		if (!phtree->lookup(value).first) {
+			phtree->insert(value, values.size());
+			values.push_back(value);
+		}
+	}
+
+	return values;
+}
+
+int mainKnnExample() {
+	const unsigned int bitLength = 8;
+	PHTree<2, bitLength>* phtree = new PHTree<2, bitLength>();
+	const vector<vector<unsigned long>> values = insertClusteredValues(phtree, 500);
+
+	const DistanceMetric metrics[] = {euclidean_distance, l1_distance};
+	for (DistanceMetric metric : metrics) {
+		for (unsigned long c = 0; c < 256; c += 15) {
+			const vector<unsigned long> center = {c, 255 - c};
+			vector<double> distances;
+			for (const auto& value : values) {
+				distances.push_back(bruteForceDistance(metric, center, value));
+			}
+			sort(distances.begin(), distances.end());
+
+			// entries with the same distance can be returned in any order
+			const size_t k = 10;
+			vector<int> ids;
+			phtree->knnQueryIds(center, k, ids, metric);
+			assert (ids.size() == k);
+			for (size_t i = 0; i < k; ++i) {
+				assert (bruteForceDistance(metric, center, values[ids[i]]) == distances[i]);
+			}
+
+			KnnIterator<2, bitLength>* it = phtree->knnQuery(center, k, metric);
+			for (size_t i = 0; it->hasNext(); ++i) {
+				it->next();
+				assert (it->getDistance() == distances[i]);
+			}
+			delete it;
+		}
+	}
+
+	delete phtree;
+	return 0;
+}
+
+int mainDistanceExample() {
+	const unsigned int bitLength = 8;
+	PHTree<2, bitLength>* phtree = new PHTree<2, bitLength>();
+	const vector<vector<unsigned long>> values = insertClusteredValues(phtree, 500);
+
+	const DistanceMetric metrics[] = {euclidean_distance, l1_distance};
+	for (DistanceMetric metric : metrics) {
+		for (unsigned long c = 0; c < 256; c += 15) {
+			const vector<unsigned long> center = {c, 255 - c};
+			vector<double> distances;
+			for (const auto& value : values) {
+				distances.push_back(bruteForceDistance(metric, center, value));
+			}
+			sort(distances.begin(), distances.end());
+
+			// the radius is the (rounded) distance of an entry so entries on the sphere have to be included
+			const size_t ranks[] = {0, 9, 99};
+			for (size_t rank : ranks) {
+				const double maxDistance = distances[rank];
+				vector<int> ids;
+				phtree->distanceQueryIds(center, maxDistance, ids, metric);
+				const size_t nInDistance = upper_bound(distances.begin(), distances.end(), maxDistance) - distances.begin();
+				assert (ids.size() == nInDistance);
+				for (int id : ids) {
+					assert (bruteForceDistance(metric, center, values[id]) <= maxDistance);
+				}
+			}
+		}
+	}
+
+	delete phtree;
+
+	// the distances of 64 bit values cannot be represented exactly as doubles
+	PHTree<2, 64>* wideTree = new PHTree<2, 64>();
+	mt19937_64 generator(42);
+	vector<vector<unsigned long>> wideValues;
+	while (wideValues.size() < 500) {
+		const vector<unsigned long> value = {generator(), generator()};
+		if (!wideTree->lookup(value).first) {
+			wideTree->insert(value, wideValues.size());
+			wideValues.push_back(value);
+		}
+	}
+
+	for (DistanceMetric metric : metrics) {
+		for (size_t c = 0; c < 20; ++c) {
+			const vector<unsigned long> center = {generator(), generator()};
+			vector<double> distances;
+			for (const auto& value : wideValues) {
+				distances.push_back(bruteForceDistance(metric, center, value));
+			}
+			sort(distances.begin(), distances.end());
+
+			const size_t ranks[] = {0, 9, 99};
+			for (size_t rank : ranks) {
+				vector<int> ids;
+				wideTree->distanceQueryIds(center, distances[rank], ids, metric);
+				assert (ids.size() == rank + 1);
+			}
+		}
+	}
+
+	delete wideTree;
+	return 0;
+}
+
+int mainSnapshotExample() {
+	const unsigned int bitLength = 16;
+	PHTree<2, bitLength>* phtree = new PHTree<2, bitLength>();
+	vector<vector<unsigned long>> values;
+	for (unsigned long i = 0; i < 1000; ++i) {
+		values.push_back({(i * 7919) % 65536, i * 13});
+		phtree->insert(values.back(), i);
+	}
+	phtree->erase(values[0]);
+
+	stringstream snapshot;
+	phtree->save(snapshot);
+	const string bytes = snapshot.str();
+
+	PHTree<2, bitLength>* loaded = new PHTree<2, bitLength>();
+	loaded->load(snapshot);
+	for (const auto& value : values) {
+		assert (loaded->lookup(value) == phtree->lookup(value));
+		assert (!loaded->lookup({value[0], value[1] + 1}).first);
+	}
+
+	vector<int> ids;
+	vector<int> loadedIds;
+	phtree->rangeQueryIds({0, 0}, {30000, 5000}, ids);
+	loaded->rangeQueryIds({0, 0}, {30000, 5000}, loadedIds);
+	assert (!ids.empty() && ids == loadedIds);
+
+	// the loaded tree can be changed like the original one
+	loaded->insert(values[0], 0);
+	assert (loaded->lookup(values[0]).second == 0);
+	const bool erased = loaded->erase(values[1]);
+	assert (erased && !loaded->lookup(values[1]).first);
+	delete loaded;
+
+	// streams that end early, contain something else or belong to a different tree are rejected
+	vector<string> invalidStreams;
+	invalidStreams.push_back(bytes.substr(0, bytes.size() / 2));
+	invalidStreams.push_back(bytes.substr(0, bytes.size() - 1));
+	invalidStreams.push_back(string(bytes.size(), 'x'));
+	stringstream otherSnapshot;
+	PHTree<2, bitLength / 2> otherTree;
+	otherTree.insert({1, 2}, 1);
+	otherTree.save(otherSnapshot);
+	invalidStreams.push_back(otherSnapshot.str());
+
+	for (const string& invalidBytes : invalidStreams) {
+		stringstream invalid(invalidBytes);
+		PHTree<2, bitLength> failed;
+		bool thrown = false;
+		try {
+			failed.load(invalid);
+		} catch (const runtime_error&) {
+			thrown = true;
+		}
+		assert (thrown);
+	}
+
+	delete phtree;
+	return 0;
+}
+
+int mainFrozenExample() {
+	const unsigned int bitLength = 12;
+	PHTree<3, bitLength>* phtree = new PHTree<3, bitLength>();
+	vector<vector<unsigned long>> values;
+	for (unsigned long i = 0; i < 3000; ++i) {
+		values.push_back({(i * 37) % 4096, (i * 101) % 4096, i % 64});
+		phtree->insert(values.back(), i);
+	}
+
+	const string fileLocation = "./frozen-example.phtree";
+	{
+		FrozenPHTree<3, bitLength> frozen(*phtree);
+		ofstream file(fileLocation, ios::binary);
+		frozen.write(file);
+	}
+
+	FrozenPHTree<3, bitLength>* mapped = new FrozenPHTree<3, bitLength>(fileLocation);
+	for (const auto& value : values) {
+		assert (mapped->lookup(value) == phtree->lookup(value));
+		const vector<unsigned long> missing = {value[0], value[1], 64 + value[2]};
+		assert (!mapped->lookup(missing).first);
+	}
+
+	for (unsigned long lower = 0; lower + 700 < 4096; lower += 500) {
+		const vector<unsigned long> lowerLeft = {lower, lower / 2, 0};
+		const vector<unsigned long> upperRight = {lower + 700, 4095, 31};
+		vector<int> ids;
+		vector<int> mappedIds;
+		phtree->rangeQueryIds(lowerLeft, upperRight, ids);
+		mapped->rangeQueryIds(lowerLeft, upperRight, mappedIds);
+		sort(ids.begin(), ids.end());
+		sort(mappedIds.begin(), mappedIds.end());
+		assert (!ids.empty() && ids == mappedIds);
+	}
+
+	delete mapped;
+	remove(fileLocation.c_str());
+	delete phtree;
+	return 0;
+}
+
+int mainParallelQueryExample() {
+	const unsigned int bitLength = 10;
+	PHTree<4, bitLength>* phtree = new PHTree<4, bitLength>();
+	for (unsigned long i = 0; i < 2000; ++i) {
+		const unsigned long x = (i * 37) % 1000;
+		const unsigned long y = (i * 101) % 1000;
+		phtree->insertHyperRect({x, y}, {x + i % 24, y + i % 17}, i);
+	}
+
+	// every query is stored as lower left values followed by upper right values
+	vector<vector<unsigned long>> queries;
+	for (unsigned long i = 0; i < 200; ++i) {
+		const unsigned long x = (i * 53) % 950;
+		const unsigned long y = (i * 29) % 950;
+		const unsigned long width = 1 + (i % 5) * 40;
+		queries.push_back({x, y, min(x + width, 1023uL), min(y + width / 2 + 1, 1023uL)});
+	}
+
+	ResultStorage intersections;
+	ResultStorage inclusions;
+	phtree->parallelIntersectionQuery(PointSpan<4>(queries), intersections, 4);
+	phtree->parallelInclusionQuery(PointSpan<4>(queries), inclusions, 4);
+	assert (intersections.getNQueries() == queries.size() && inclusions.getNQueries() == queries.size());
+
+	size_t nIntersections = 0;
+	size_t nInclusions = 0;
+	for (size_t q = 0; q < queries.size(); ++q) {
+		for (unsigned int type = 0; type < 2; ++type) {
+			const ResultStorage& results = (type == 0)? intersections : inclusions;
+			RangeQueryIterator<4, bitLength>* it = (type == 0)?
+					phtree->intersectionQuery(queries[q]) : phtree->inclusionQuery(queries[q]);
+			vector<int> ids;
+			while (it->hasNext()) {
+				ids.push_back(it->next().id_);
+			}
+			delete it;
+
+			vector<int> parallelIds(results.getResults(q), results.getResults(q) + results.getNResults(q));
+			sort(ids.begin(), ids.end());
+			sort(parallelIds.begin(), parallelIds.end());
+			assert (ids == parallelIds);
+		}
+
+		assert (inclusions.getNResults(q) <= intersections.getNResults(q));
+		nIntersections += intersections.getNResults(q);
+		nInclusions += inclusions.getNResults(q);
+	}
+
+	assert (nIntersections > 0 && nIntersections == intersections.getTotalNResults());
+	assert (nInclusions > 0 && nInclusions == inclusions.getTotalNResults());
+
+	delete phtree;
+	return 0;
+}
+
+int mainOptimisticReadExample() {
+	const unsigned int bitLength = 10;
+	const size_t nValues = 20000;
+	vector<vector<unsigned long>> values;
+	for (unsigned long i = 0; i < nValues; ++i) {
+		values.push_back({(i * 37) % 1024, (i * 101) % 1024, i / 1024});
+	}
+
+	const vector<unsigned long> lowerLeft = {100, 200, 3};
+	const vector<unsigned long> upperRight = {600, 900, 12};
+	PHTree<3, bitLength>* phtree = new PHTree<3, bitLength>();
+	const unsigned long nRestartsBefore = SpatialSelectionOperationsUtil<3, bitLength>::nRestartOptimisticRead;
+	atomic<bool> inserted(false);
+	vector<thread> readers;
+	for (unsigned int reader = 0; reader < 2; ++reader) {
+		readers.emplace_back([&, reader]() {
+			size_t i = reader;
+			while (!inserted) {
+				// the ID is the position of the values so every hit can be verified
+				const pair<bool, int> result = phtree->optimisticLookup(values[i % nValues]);
+				assert (!result.first || size_t(result.second) == i % nValues);
+				vector<int> ids;
+				phtree->optimisticRangeQueryIds(lowerLeft, upperRight, ids);
+				sort(ids.begin(), ids.end());
+				assert (adjacent_find(ids.begin(), ids.end()) == ids.end());
+				for (int id : ids) {
+					for (unsigned int d = 0; d < 3; ++d) {
+						assert (lowerLeft[d] <= values[id][d] && values[id][d] <= upperRight[d]);
+					}
+				}
+
+				i += 7919;
+			}
+		});
+	}
+
+	vector<int> ids;
+	for (size_t i = 0; i < nValues; ++i) {
+		ids.push_back(i);
+	}
+
+	phtree->parallelBulkInsert(values, &ids, 4);
+	inserted = true;
+	for (auto& reader : readers) {
+		reader.join();
+	}
+
+	cout << "restarted optimistic reads: "
+			<< (SpatialSelectionOperationsUtil<3, bitLength>::nRestartOptimisticRead - nRestartsBefore) << endl;
+
+	// once the insertion finished the optimistic reads see every entry
+	for (size_t i = 0; i < nValues; ++i) {
+		const pair<bool, int> result = phtree->optimisticLookup(values[i]);
+		assert (result.first && size_t(result.second) == i);
+	}
+
+	vector<int> rangeIds;
+	vector<int> optimisticRangeIds;
+	phtree->rangeQueryIds(lowerLeft, upperRight, rangeIds);
+	phtree->optimisticRangeQueryIds(lowerLeft, upperRight, optimisticRangeIds);
+	sort(rangeIds.begin(), rangeIds.end());
+	sort(optimisticRangeIds.begin(), optimisticRangeIds.end());
+	assert (!rangeIds.empty() && rangeIds == optimisticRangeIds);
+
+	delete phtree;
+	return 0;
+}
+
+int mainParallelRangeExample() {
+	const unsigned int bitLength = 16;
+	PHTree<3, bitLength>* phtree = new PHTree<3, bitLength>();
+	for (unsigned long i = 0; i < 50000; ++i) {
+		// the first dimension alone is distinct for all values
+		phtree->insert({(i * 7919) % 65536, (i * 104729) % 65536, i % 1024}, i);
+	}
+
+	const vector<vector<unsigned long>> windows = {
+		{1000, 0, 0}, {60000, 65535, 900},
+		{0, 0, 0}, {65535, 65535, 65535},
+		{20000, 30000, 100}, {21000, 40000, 300}
+	};
+
+	for (size_t w = 0; w < windows.size(); w += 2) {
+		vector<int> ids;
+		phtree->rangeQueryIds(windows[w], windows[w + 1], ids);
+		sort(ids.begin(), ids.end());
+		assert (!ids.empty());
+
+		for (size_t nThreads = 1; nThreads <= 4; nThreads += 3) {
+			vector<vector<int>> partitions;
+			phtree->parallelRangeQueryIds(windows[w], windows[w + 1], partitions, nThreads);
+			assert (nThreads == 1 || ids.size() < 1000 || partitions.size() > nThreads);
+
+			vector<int> unitedIds;
+			for (const vector<int>& partition : partitions) {
+				unitedIds.insert(unitedIds.end(), partition.begin(), partition.end());
+			}
+
+			// an ID in more than one partition would show up twice
+			sort(unitedIds.begin(), unitedIds.end());
+			assert (adjacent_find(unitedIds.begin(), unitedIds.end()) == unitedIds.end());
+			assert (unitedIds == ids);
+		}
+	}
+
+	delete phtree;
+	return 0;
+}
+
+int mainQueryStatisticsExample() {
+	const unsigned int bitLength = 10;
+	const size_t nRectangles = 5000;
+	PHTree<4, bitLength>* phtree = new PHTree<4, bitLength>();
+	for (unsigned long i = 0; i < nRectangles; ++i) {
+		const unsigned long x = (i * 37) % 1000;
+		const unsigned long y = (i * 101) % 1000;
+		phtree->insertHyperRect({x, y}, {x + i % 24, y + i % 17}, i);
+	}
+
+	// a few queries intersect every rectangle while all others only intersect a few
+	vector<vector<unsigned long>> queries;
+	for (unsigned long i = 0; i < 400; ++i) {
+		const unsigned long x = (i * 53) % 1000;
+		const unsigned long y = (i * 29) % 1000;
+		if (i % 50 == 0) {
+			queries.push_back({0, 0, 1023, 1023});
+		} else {
+			queries.push_back({x, y, x + 1, y + 1});
+		}
+	}
+
+	for (size_t nThreads = 1; nThreads <= 4; nThreads += 3) {
+		ResultStorage results;
+		vector<RangeQueryThreadStatistics> statistics;
+		const auto start = chrono::steady_clock::now();
+		phtree->parallelIntersectionQuery(PointSpan<4>(queries), results, nThreads, &statistics);
+		const unsigned long batchMicros = chrono::duration_cast<chrono::microseconds>(
+				chrono::steady_clock::now() - start).count();
+
+		assert (statistics.size() == nThreads);
+		size_t nQueries = 0;
+		for (const RangeQueryThreadStatistics& threadStatistics : statistics) {
+			// every thread is either busy or idle while the batch is processed
+			const unsigned long poolMicros = threadStatistics.busyMicros + threadStatistics.idleMicros;
+			assert (poolMicros == statistics[0].busyMicros + statistics[0].idleMicros);
+			assert (poolMicros <= batchMicros);
+			nQueries += threadStatistics.nQueries;
+		}
+
+		assert (nQueries == queries.size());
+		for (size_t q = 0; q < queries.size(); q += 50) {
+			assert (results.getNResults(q) == nRectangles);
+		}
+	}
+
+	delete phtree;
+	return 0;
+}
+
+// builds the largest node type for any number of contents
+template <unsigned int DIM>
+class AhcNodeTypePolicy : public NodeTypePolicy<DIM> {
+public:
+	NodeSizeClass selectSizeClass(size_t nContents) const override {
+		return ahc_all_contents;
+	}
+};
+
+int mainNodeTypePolicyExample() {
+	const unsigned int bitLength = 8;
+	vector<vector<unsigned long>> values;
+	for (unsigned long i = 0; i < 3000; ++i) {
+		values.push_back({(i * 37) % 256, i / 256, (i * 11) % 256, (i * 5) % 256});
+	}
+
+	const vector<unsigned long> lowerLeft = {20, 0, 0, 10};
+	const vector<unsigned long> upperRight = {200, 8, 127, 255};
+	const FillRatioNodeTypePolicy<4> fillRatioPolicy;
+	const AhcNodeTypePolicy<4> ahcPolicy;
+	const NodeTypePolicy<4>* policies[] = {NULL, &fillRatioPolicy, &ahcPolicy};
+	vector<pair<bool, int>> expectedLookups;
+	vector<int> expectedIds;
+	for (const NodeTypePolicy<4>* policy : policies) {
+		NodeTypeUtil<4>::setPolicy(policy);
+		PHTree<4, bitLength>* phtree = new PHTree<4, bitLength>();
+		for (size_t i = 0; i < values.size(); ++i) {
+			phtree->insert(values[i], i);
+		}
+
+		stringstream snapshot;
+		phtree->save(snapshot);
+		CountNodeTypesVisitor<4> visitor;
+		phtree->accept(&visitor);
+		assert (policy != &ahcPolicy || visitor.getNumberOfVisitedLHCNodes() == 0);
+		delete phtree;
+
+		// the loaded tree keeps the node types of the saved one while new nodes use the default again
+		NodeTypeUtil<4>::setPolicy(NULL);
+		PHTree<4, bitLength>* loaded = new PHTree<4, bitLength>();
+		loaded->load(snapshot);
+		CountNodeTypesVisitor<4> loadedVisitor;
+		loaded->accept(&loadedVisitor);
+		assert (loadedVisitor.getNumberOfVisitedAHCNodes() == visitor.getNumberOfVisitedAHCNodes());
+		assert (loadedVisitor.getNumberOfVisitedLHCNodes() == visitor.getNumberOfVisitedLHCNodes());
+
+		vector<pair<bool, int>> lookups;
+		for (const auto& value : values) {
+			lookups.push_back(loaded->lookup(value));
+			lookups.push_back(loaded->lookup({value[0], value[1] + 16, value[2], value[3]}));
+		}
+
+		vector<int> ids;
+		loaded->rangeQueryIds(lowerLeft, upperRight, ids);
+		sort(ids.begin(), ids.end());
+		if (!policy) {
+			expectedLookups = lookups;
+			expectedIds = ids;
+			assert (!expectedIds.empty());
+		}
+
+		assert (lookups == expectedLookups && ids == expectedIds);
+
+		for (size_t i = 0; i < values.size(); i += 2) {
+			const bool erased = loaded->erase(values[i]);
+			assert (erased);
+		}
+
+		for (size_t i = 0; i < values.size(); ++i) {
+			assert (loaded->lookup(values[i]).first == (i % 2 == 1));
+		}
+
+		delete loaded;
+	}
+
+	return 0;
+}
+
+int mainEstimator1DExample() {
+	const unsigned int bitLength = 6;
+	const unsigned long upperBoundary = (1uL << bitLength);
+
+	// every value is contained three times but only stored once
+	vector<vector<unsigned long>> values;
+	for (unsigned long i = 0; i < 3 * upperBoundary; ++i) {
+		values.push_back({i % upperBoundary});
+	}
+
+	PHTree<1, bitLength>* phtree = new PHTree<1, bitLength>();
+	for (unsigned long i = 0; i < values.size(); ++i) {
+		phtree->insert(values[i], i);
+	}
+	assert (phtree->estimateRangeQuerySize({0}, {upperBoundary - 1}) == upperBoundary);
+	delete phtree;
+
+	phtree = new PHTree<1, bitLength>();
+	phtree->bulkLoad(PointSpan<1>(values));
+	assert (phtree->estimateRangeQuerySize({0}, {upperBoundary - 1}) == upperBoundary);
+	delete phtree;
+
+	phtree = new PHTree<1, bitLength>();
+	phtree->parallelBulkLoad(PointSpan<1>(values), NULL, 2);
+	assert (phtree->estimateRangeQuerySize({0}, {upperBoundary - 1}) == upperBoundary);
+
+	// the estimate is exact if the counted levels cover all bits
+	for (unsigned long i = 0; i < upperBoundary; i += 2) {
+		phtree->erase({i});
+	}
+
+	for (unsigned long lower = 0; lower < upperBoundary; ++lower) {
+		for (unsigned long upper = lower; upper < upperBoundary; ++upper) {
+			size_t nEntries = 0;
+			phtree->forEachInRange({lower}, {upper}, [&nEntries](int id) { ++nEntries; });
+			assert (phtree->estimateRangeQuerySize({lower}, {upper}) == nEntries);
+		}
+	}
+
+	delete phtree;
+	return 0;
+}
+
 int mainHyperCubeExample() {
 	const unsigned int bitLength = 4;
 	vector<unsigned long> e1Lower = {5, 5};
@@ -297,6 +990,18 @@ int main(int argc, char* argv[]) {
 		mainFull1DExample();
 		cout << endl;
 		mainSharing1DExample();
+		mainErase1DExample();
+		mainEstimator1DExample();
+		mainBulkLoadExample();
+		mainKnnExample();
+		mainDistanceExample();
+		mainSnapshotExample();
+		mainNodeTypePolicyExample();
+		mainFrozenExample();
+		mainParallelQueryExample();
+		mainQueryStatisticsExample();
+		mainOptimisticReadExample();
+		mainParallelRangeExample();
 		mainSimpleExample();
 		cout << endl;
 		mainHyperCubeExample();
@@ -328,6 +1033,8 @@ int main(int argc, char* argv[]) {
 //		PlotUtil::plotRangeQueryTimePerPercentFilledRandom();
 //		PlotUtil::plotRangeQueryTimePerSelectivityRandom();
 //		PlotUtil::plotAverageInsertTimePerNumberOfEntries<6, 64>("./axons.dat", true);
+//		PlotUtil::plotLhcAddressSearch<6>();
+//		PlotUtil::plotNodeTypeCost();
 		return 0;
 	} else if (rand.compare(argv[1]) == 0) {
 		vector<size_t> nEntries;
@@ -25,16 +25,18 @@ public:
 	virtual ~AHC();
 	NodeIterator<DIM>* begin() const override;
 	NodeIterator<DIM>* it(unsigned long hcAddress) const override;
+	NodeIterator<DIM>* it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const override;
 	NodeIterator<DIM>* end() const override;
 	void accept(Visitor<DIM>* visitor, size_t depth, unsigned int index) override;
-	void recursiveDelete() override;
 	size_t getNumberOfContents() const override;
 	size_t getMaximumNumberOfContents() const override;
 	void lookup(unsigned long address, NodeAddressContent<DIM>& outContent, bool resolveSuffixIndex) const override;
+	void getRawContents(NodeRawContents<DIM>& outContents) const override;
 	void insertAtAddress(unsigned long hcAddress, uintptr_t pointer) override;
 	void insertAtAddress(unsigned long hcAddress, unsigned long suffix, int id) override;
 	void insertAtAddress(unsigned long hcAddress, unsigned int suffixStartBlockIndex, int id) override;
 	void insertAtAddress(unsigned long hcAddress, const Node<DIM>* const subnode) override;
+	void removeAtAddress(unsigned long hcAddress) override;
 	Node<DIM>* adjustSize() override;
 
 protected:
@@ -51,74 +53,56 @@ private:
 	// 10 					- the entry holds a reference to a subnode
 	// 11 					- the entry holds the index of the suffix and the ID
 	std::uintptr_t references_[1 << DIM];
+	// bit i is set iff references_[i] holds an entry so empty slots can be skipped with ctz
+	unsigned long occupied_[1 + ((1uL << DIM) - 1) / (8 * sizeof (unsigned long))];
 	static const unsigned long refMask = (-1uL) << 2uL; // mask to remove the 2 flag bits
 
 	void inline getRef(unsigned long hcAddress, bool* exists, bool* hasSub,
 			bool* directlyStoredSuffix, bool* isSpecial, std::uintptr_t* ref) const;
+	void inline setOccupied(unsigned long hcAddress);
+	// returns the first filled address >= hcAddress or 2^DIM if there is none
+	unsigned long inline nextOccupied(unsigned long hcAddress) const;
+	size_t countOccupied() const;
 };
 
 #include <assert.h>
+#include <new>
 #include "nodes/AHC.h"
 #include "iterators/AHCIterator.h"
 #include "iterators/NodeIterator.h"
 #include "nodes/NodeAddressContent.h"
 #include "visitors/Visitor.h"
+#include "util/NodeTypeUtil.h"
 
 using namespace std;
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
-AHC<DIM, PREF_BLOCKS>::AHC(size_t prefixLength) : TNode<DIM, PREF_BLOCKS>(prefixLength), nContents(0), references_() {
+AHC<DIM, PREF_BLOCKS>::AHC(size_t prefixLength) : TNode<DIM, PREF_BLOCKS>(prefixLength), nContents(0), references_(), occupied_() {
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
-AHC<DIM, PREF_BLOCKS>::AHC(TNode<DIM, PREF_BLOCKS>* other) : TNode<DIM, PREF_BLOCKS>(other), nContents(0), references_() {
-
-	// TODO use more efficient way to convert LHC->AHC
-	NodeIterator<DIM>* it;
-	NodeIterator<DIM>* endIt = other->end();
-	for (it = other->begin(); (*it) != *endIt; ++(*it)) {
-		NodeAddressContent<DIM> content = *(*it);
-		assert (content.exists);
+AHC<DIM, PREF_BLOCKS>::AHC(TNode<DIM, PREF_BLOCKS>* other) : TNode<DIM, PREF_BLOCKS>(other), nContents(0), references_(), occupied_() {
+
+	// the suffix storage is shared so the suffix indices remain valid
+	auto insertContent = [this] (const NodeAddressContent<DIM>& content) {
 		if (content.hasSubnode) {
 			insertAtAddress(content.address, content.subnode);
+		} else if (content.hasSpecialPointer) {
+			insertAtAddress(content.address, content.specialPointer);
 		} else if (content.directlyStoredSuffix) {
-			assert (content.suffix < sizeof (int) * 8 - 2);
 			insertAtAddress(content.address, content.suffix, content.id);
 		} else {
-			assert (content.suffixStartBlock);
-			insertAtAddress(content.address, content.suffixStartBlock, content.id);
+			insertAtAddress(content.address, content.suffixStartBlockIndex, content.id);
 		}
-	}
+	};
 
-	delete it;
-	delete endIt;
+	other->forEachContent(insertContent, false);
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 AHC<DIM, PREF_BLOCKS>::~AHC() {
 }
 
-template <unsigned int DIM, unsigned int PREF_BLOCKS>
-void AHC<DIM, PREF_BLOCKS>::recursiveDelete() {
-	bool hasSubnode = false;
-	bool filled = false;
-	bool isDirectlyStoredSuffix = false;
-	bool isSpecial = false;
-	uintptr_t ref = 0;
-	for (size_t i = 0; i < 1uL << DIM; ++i) {
-		getRef(i, &filled, &hasSubnode, &isDirectlyStoredSuffix, &isSpecial, &ref);
-		assert (!isSpecial);
-		if (filled && hasSubnode) {
-			Node<DIM>* subnode = reinterpret_cast<Node<DIM>*>(ref);
-			assert (subnode);
-			subnode->recursiveDelete();
-		}
-	}
-
-	if (this->suffixes_) { delete this->suffixes_; }
-	delete this;
-}
-
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 string AHC<DIM,PREF_BLOCKS>::getName() const {
 	return "AHC";
@@ -142,8 +126,46 @@ void AHC<DIM,PREF_BLOCKS>::getRef(unsigned long hcAddress, bool* exists, bool* h
 	(*isSpecial) = !isSuffix && !isPointer && (reference != 0);
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+void AHC<DIM,PREF_BLOCKS>::setOccupied(unsigned long hcAddress) {
+	const size_t bitsPerBlock = 8 * sizeof (unsigned long);
+	occupied_[hcAddress / bitsPerBlock] |= 1uL << (hcAddress % bitsPerBlock);
+}
+
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+unsigned long AHC<DIM,PREF_BLOCKS>::nextOccupied(unsigned long hcAddress) const {
+	const size_t bitsPerBlock = 8 * sizeof (unsigned long);
+	const size_t nBlocks = sizeof (occupied_) / sizeof (unsigned long);
+	if (hcAddress >= (1uL << DIM)) {
+		return 1uL << DIM;
+	}
+
+	size_t block = hcAddress / bitsPerBlock;
+	unsigned long bits = occupied_[block] & ((-1uL) << (hcAddress % bitsPerBlock));
+	while (bits == 0) {
+		if (++block >= nBlocks) {
+			return 1uL << DIM;
+		}
+
+		bits = occupied_[block];
+	}
+
+	return block * bitsPerBlock + __builtin_ctzl(bits);
+}
+
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+size_t AHC<DIM,PREF_BLOCKS>::countOccupied() const {
+	size_t nOccupied = 0;
+	for (unsigned long block : occupied_) {
+		nOccupied += __builtin_popcountl(block);
+	}
+
+	return nOccupied;
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 size_t AHC<DIM, PREF_BLOCKS>::getNumberOfContents() const {
+	assert (nContents == countOccupied());
 	return nContents;
 }
 
@@ -189,6 +211,15 @@ void AHC<DIM, PREF_BLOCKS>::lookup(unsigned long address, NodeAddressContent<DIM
 	}
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+void AHC<DIM, PREF_BLOCKS>::getRawContents(NodeRawContents<DIM>& outContents) const {
+	outContents.addresses = NULL;
+	outContents.occupied = occupied_;
+	outContents.references = references_;
+	outContents.nRows = 1u << DIM;
+	this->getRawPrefixAndSuffixes(outContents);
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, unsigned long  suffix, int id) {
 	assert (hcAddress < 1ul << DIM);
@@ -204,6 +235,7 @@ void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, unsigned lo
 
 	if (!exists) {
 		nContents++;
+		setOccupied(hcAddress);
 		assert ((references_[hcAddress] & 3) == 0);
 	}
 
@@ -235,6 +267,7 @@ void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, unsigned in
 
 	if (!exists) {
 		nContents++;
+		setOccupied(hcAddress);
 		assert ((references_[hcAddress] & 3) == 0);
 	}
 
@@ -266,6 +299,7 @@ void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, const Node<
 
 	if (!exists) {
 		nContents++;
+		setOccupied(hcAddress);
 		assert ((references_[hcAddress] & 3) == 0);
 	}
 
@@ -293,6 +327,7 @@ void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, uintptr_t p
 
 	if (!exists) {
 		nContents++;
+		setOccupied(hcAddress);
 	}
 
 	// 00 & pointer != 0 -> special pointer
@@ -303,10 +338,29 @@ void AHC<DIM, PREF_BLOCKS>::insertAtAddress(unsigned long hcAddress, uintptr_t p
 	assert (((NodeAddressContent<DIM>)Node<DIM>::lookup(hcAddress, true)).specialPointer == pointer);
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+void AHC<DIM, PREF_BLOCKS>::removeAtAddress(unsigned long hcAddress) {
+	assert (hcAddress < 1uL << DIM);
+	assert (references_[hcAddress] != 0 && "can only remove existing entries");
+	assert (nContents > 0);
+
+	const size_t bitsPerBlock = 8 * sizeof (unsigned long);
+	references_[hcAddress] = 0;
+	occupied_[hcAddress / bitsPerBlock] &= ~(1uL << (hcAddress % bitsPerBlock));
+	--nContents;
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 Node<DIM>* AHC<DIM, PREF_BLOCKS>::adjustSize() {
-	// TODO currently there is no need to switch from AHC to LHC because there is no delete function
-	return this;
+	// switch to a LHC once less than half of the addresses are in use and
+	// the node type policy would not build an AHC for the remaining contents
+	const size_t newNContents = (nContents == 0)? 1 : nContents;
+	if (2 * nContents < (1uL << DIM)
+			&& NodeTypeUtil<DIM>::determineNodeCapacity(newNContents) < (1uL << DIM)) {
+		return NodeTypeUtil<DIM>::copyIntoSmallerNode(newNContents, this);
+	} else {
+		return this;
+	}
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
@@ -321,6 +375,13 @@ NodeIterator<DIM>* AHC<DIM, PREF_BLOCKS>::it(unsigned long hcAddress) const {
 	return new AHCIterator<DIM, PREF_BLOCKS>(hcAddress, *this);
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+NodeIterator<DIM>* AHC<DIM, PREF_BLOCKS>::it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const {
+	static_assert (sizeof (AHCIterator<DIM, PREF_BLOCKS>) <= NodeIteratorStorage<DIM>::size,
+			"the iterator needs to fit into the storage");
+	return new (storage.data_) AHCIterator<DIM, PREF_BLOCKS>(hcAddress, *this);
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 NodeIterator<DIM>* AHC<DIM, PREF_BLOCKS>::end() const {
 	NodeIterator<DIM>* it = new AHCIterator<DIM, PREF_BLOCKS>(*this);
@@ -22,16 +22,18 @@ public:
 	virtual ~LHC();
 	NodeIterator<DIM>* begin() const override;
 	NodeIterator<DIM>* it(unsigned long hcAddress) const override;
+	NodeIterator<DIM>* it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const override;
 	NodeIterator<DIM>* end() const override;
 	void accept(Visitor<DIM>* visitor, size_t depth, unsigned int index) override;
-	void recursiveDelete() override;
 	size_t getNumberOfContents() const override;
 	size_t getMaximumNumberOfContents() const override;
 	void lookup(unsigned long address, NodeAddressContent<DIM>& outContent, bool resolveSuffixIndex) const override;
+	void getRawContents(NodeRawContents<DIM>& outContents) const override;
 	void insertAtAddress(unsigned long hcAddress, uintptr_t pointer) override;
 	void insertAtAddress(unsigned long hcAddress, unsigned int suffixStartBlockIndex, int id) override;
 	void insertAtAddress(unsigned long hcAddress, unsigned long suffix, int id) override;
 	void insertAtAddress(unsigned long hcAddress, const Node<DIM>* const subnode) override;
+	void removeAtAddress(unsigned long hcAddress) override;
 	Node<DIM>* adjustSize() override;
 
 protected:
@@ -40,12 +42,13 @@ protected:
 private:
 	static const unsigned long fullBlock = -1;
 	static const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+	static const unsigned int nAddressBlocks = 1 + ((N * DIM) - 1) / bitsPerBlock;
 
 	// map of valid HC addresses in ascending order
 	// block : <-------------------- 64 --------------------><--- ...
 	// bits  : <-   DIM    ->|<-   DIM    -> * N
 	// N rows: [ hc address ] [ hc address ] ...
-	unsigned long addresses_[1 + ((N * DIM) - 1) / bitsPerBlock];
+	unsigned long addresses_[nAddressBlocks];
 	// stores flags in 2 lowest bits per reference:
 	// meaning of flags: isPointer | isSuffix
 	// 00 - special pointer
@@ -61,17 +64,20 @@ private:
 	void lookupIndex(unsigned int index, unsigned long* outHcAddress) const;
 	void fillLookupContent(NodeAddressContent<DIM>& outContent, uintptr_t reference, bool resolveSuffixIndex) const;
 	inline void addRow(unsigned int index, unsigned long hcAddress, std::uintptr_t reference);
+	inline void removeRow(unsigned int index);
 	inline void insertAddress(unsigned int index, unsigned long hcAddress);
 	inline void interpretReference(std::uintptr_t ref, bool* isPointer, bool* isSuffix) const;
 };
 
 #include <assert.h>
+#include <new>
 #include <utility>
 #include "nodes/AHC.h"
 #include "nodes/LHC.h"
 #include "iterators/LHCIterator.h"
 #include "visitors/Visitor.h"
 #include "util/NodeTypeUtil.h"
+#include "util/AddressSearchUtil.h"
 
 using namespace std;
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
@@ -85,22 +91,6 @@ template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 LHC<DIM, PREF_BLOCKS, N>::~LHC() {
 }
 
-template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
-void LHC<DIM, PREF_BLOCKS, N>::recursiveDelete() {
-	bool isPointer, isSuffix;
-	const unsigned long flagMask = ~(3uL);
-	for (unsigned int i = 0; i < m; ++i) {
-		interpretReference(references_[i], &isPointer, &isSuffix);
-		if (isPointer && !isSuffix) {
-			Node<DIM>* subnode = reinterpret_cast<Node<DIM>*>(references_[i] & flagMask);
-			subnode->recursiveDelete();
-		}
-	}
-
-	if (this->suffixes_) { delete this->suffixes_; }
-	delete this;
-}
-
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 string LHC<DIM,PREF_BLOCKS, N>::getName() const {
 	return "LHC";
@@ -111,31 +101,7 @@ void LHC<DIM,PREF_BLOCKS, N>::lookupIndex(unsigned int index, unsigned long* out
 	assert (index < m && m <= N);
 	assert (DIM <= bitsPerBlock);
 
-	const unsigned int firstBit = index * DIM;
-	const unsigned int lastBit = (index + 1) * DIM;
-	const unsigned int firstBitBlockIndex = firstBit / bitsPerBlock;
-	const unsigned int lastBitBlockIndex = lastBit / bitsPerBlock;
-	const unsigned int firstBitIndex = firstBit % bitsPerBlock;
-	const unsigned int lastBitIndex = lastBit % bitsPerBlock;
-
-	const unsigned long firstBlock = addresses_[firstBitBlockIndex];
-	assert (lastBitBlockIndex - firstBitBlockIndex <= 1);
-	if (firstBitBlockIndex == lastBitBlockIndex || lastBitIndex == 0) {
-		// all required bits are in one block
-		const unsigned long singleBlockAddressMask = (1uL << DIM) - 1uL;
-		const unsigned long extracted = firstBlock >> firstBitIndex;
-		(*outHcAddress) = extracted & singleBlockAddressMask;
-	} else {
-		// the address is split into two blocks
-		const unsigned long secondBlock = addresses_[lastBitBlockIndex];
-		assert (0 < lastBitIndex && lastBitIndex < DIM);
-		const unsigned int firstBlockBits = bitsPerBlock - firstBitIndex;
-		const unsigned int secondBlockBits = DIM - firstBlockBits;
-		const unsigned long secondBlockMask = (1uL << secondBlockBits) - 1uL;
-		(*outHcAddress) = (firstBlock >> firstBitIndex)
-						| ((secondBlock & secondBlockMask) << firstBlockBits);
-	}
-
+	(*outHcAddress) = AddressSearchUtil<DIM>::getAddress(addresses_, nAddressBlocks, index);
 	assert (*outHcAddress < (1uL << DIM));
 }
 
@@ -178,37 +144,10 @@ void LHC<DIM,PREF_BLOCKS, N>::insertAddress(unsigned int index, unsigned long hc
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 void LHC<DIM, PREF_BLOCKS, N>::lookupAddress(unsigned long hcAddress, bool* outExists,
 		unsigned int* outIndex) const {
-	if (m == 0) {
-		(*outExists) = false;
-		(*outIndex) = 0;
-		return;
-	}
-
-	// perform binary search in range [0, m)
-	unsigned int l = 0;
-	unsigned int r = m;
-	unsigned long currentHcAddress = -1;
-	while (l < r) {
-		// check interval [l, r)
-		const unsigned int middle = (l + r) / 2;
-		assert (0 <= middle && middle < m);
-		lookupIndex(middle, &currentHcAddress);
-		if (currentHcAddress < hcAddress) {
-			l = middle + 1;
-		} else if (currentHcAddress > hcAddress) {
-			r = middle;
-		} else {
-			// found the correct index
-			(*outExists) = true;
-			(*outIndex) = middle;
-			return;
-		}
-	}
-
-	// did not find the entry so set the position it should have
-	assert (l - r == 0);
-	(*outExists) = false;
-	(*outIndex) = r;
+	// sets the position the address has or should have
+	(*outIndex) = AddressSearchUtil<DIM>::branchlessSearch(addresses_, nAddressBlocks, m, hcAddress);
+	(*outExists) = (*outIndex) < m
+			&& AddressSearchUtil<DIM>::getAddress(addresses_, nAddressBlocks, *outIndex) == hcAddress;
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
@@ -266,6 +205,15 @@ void LHC<DIM, PREF_BLOCKS, N>::lookup(unsigned long address, NodeAddressContent<
 	}
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
+void LHC<DIM, PREF_BLOCKS, N>::getRawContents(NodeRawContents<DIM>& outContents) const {
+	outContents.addresses = addresses_;
+	outContents.occupied = NULL;
+	outContents.references = references_;
+	outContents.nRows = m;
+	this->getRawPrefixAndSuffixes(outContents);
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 void LHC<DIM, PREF_BLOCKS, N>::addRow(unsigned int index, unsigned long newHcAddress,
 		uintptr_t newReference) {
@@ -416,14 +364,45 @@ void LHC<DIM, PREF_BLOCKS, N>::insertAtAddress(unsigned long hcAddress, const No
 #endif
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
+void LHC<DIM, PREF_BLOCKS, N>::removeRow(unsigned int index) {
+	assert (index < m && m <= N);
+
+	// move all contents after the given index one row up
+	unsigned long tmpAddress = 0;
+	for (unsigned i = index + 1; i < m; ++i) {
+		lookupIndex(i, &tmpAddress);
+		references_[i - 1] = references_[i];
+		insertAddress(i - 1, tmpAddress);
+	}
+
+	--m;
+	references_[m] = 0;
+}
+
+template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
+void LHC<DIM, PREF_BLOCKS, N>::removeAtAddress(unsigned long hcAddress) {
+	assert (hcAddress < 1uL << DIM);
+
+	unsigned int index = m;
+	bool exists;
+	lookupAddress(hcAddress, &exists, &index);
+	assert (exists && "can only remove existing entries");
+	removeRow(index);
+
+	assert (!((NodeAddressContent<DIM>)Node<DIM>::lookup(hcAddress, true)).exists);
+}
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 Node<DIM>* LHC<DIM, PREF_BLOCKS, N>::adjustSize() {
-	// TODO put this method into insert method instead
-	if (m <= N) {
-		return this;
+	assert (m <= N);
+	// only shrink the node if less than half of the rows are in use so that
+	// alternating inserts and removals do not copy the node back and forth
+	const size_t nContents = (m == 0)? 1 : m;
+	if (2 * m < N && NodeTypeUtil<DIM>::determineNodeCapacity(nContents) < N) {
+		return NodeTypeUtil<DIM>::copyIntoSmallerNode(nContents, this);
 	} else {
-		return NodeTypeUtil<DIM>::copyIntoLargerNode(N + 1, this);
+		return this;
 	}
 }
 
@@ -440,6 +419,13 @@ NodeIterator<DIM>* LHC<DIM, PREF_BLOCKS, N>::it(unsigned long hcAddress) const {
 	return new LHCIterator<DIM, PREF_BLOCKS, N>(hcAddress, *this);
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
+NodeIterator<DIM>* LHC<DIM, PREF_BLOCKS, N>::it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const {
+	static_assert (sizeof (LHCIterator<DIM, PREF_BLOCKS, N>) <= NodeIteratorStorage<DIM>::size,
+			"the iterator needs to fit into the storage");
+	return new (storage.data_) LHCIterator<DIM, PREF_BLOCKS, N>(hcAddress, *this);
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS, unsigned int N>
 NodeIterator<DIM>* LHC<DIM, PREF_BLOCKS, N>::end() const {
 	NodeIterator<DIM>* it = new LHCIterator<DIM, PREF_BLOCKS, N>(*this);
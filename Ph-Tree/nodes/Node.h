@@ -9,8 +9,11 @@
 #include "Entry.h"
 #include "iterators/NodeIterator.h"
 #include "nodes/NodeAddressContent.h"
+#include "nodes/NodeRawContents.h"
 #include "util/MultiDimBitset.h"
+#include "util/NodeArena.h"
 #include <pthread.h>
+#include <atomic>
 
 template <unsigned int DIM>
 class Visitor;
@@ -31,17 +34,22 @@ class Node {
 public:
 
 	bool removed;
-	unsigned int updateCounter;
+	// seqlock style version of the node for optimistic readers: odd while a writer changes the node
+	std::atomic<unsigned int> updateCounter;
 	pthread_rwlock_t rwLock = PTHREAD_RWLOCK_INITIALIZER;
 
 	Node();
 	virtual ~Node();
+	// nodes are allocated from the arena of the tree they belong to
+	static void* operator new(size_t bytes);
+	static void operator delete(void* pointer, size_t bytes);
 	virtual std::ostream& output(std::ostream& os, size_t depth, size_t index, size_t totalBitLength) = 0;
 	virtual NodeIterator<DIM>* begin() const = 0;
 	virtual NodeIterator<DIM>* it(unsigned long hcAddress) const =0;
+	// constructs the iterator in the given storage so it needs to be destructed but not deleted
+	virtual NodeIterator<DIM>* it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const =0;
 	virtual NodeIterator<DIM>* end() const = 0;
 	virtual void accept(Visitor<DIM>* visitor, size_t depth, unsigned int index) =0;
-	virtual void recursiveDelete() = 0;
 	// gets the number of contents: #suffixes + #subnodes
 	virtual size_t getNumberOfContents() const = 0;
 	virtual size_t getMaximumNumberOfContents() const = 0;
@@ -50,10 +58,13 @@ public:
 	virtual unsigned long* getPrefixStartBlock() =0;
 	virtual const unsigned long* getFixPrefixStartBlock() const =0;
 	virtual void lookup(unsigned long address, NodeAddressContent<DIM>& outContent, bool resolveSuffixIndex) const = 0;
+	virtual void getRawContents(NodeRawContents<DIM>& outContents) const = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, uintptr_t pointer) =0;
 	virtual void insertAtAddress(unsigned long hcAddress, unsigned int suffixStartBlockIndex, int id) = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, unsigned long suffix, int id) = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, const Node<DIM>* const subnode) = 0;
+	virtual void removeAtAddress(unsigned long hcAddress) = 0;
+	// returns a smaller copy of the node if it is underfilled or the node itself
 	virtual Node<DIM>* adjustSize() = 0;
 	virtual bool canStoreSuffixInternally(size_t nSuffixBits) const =0;
 	virtual unsigned int canStoreSuffix(size_t nSuffixBits) const =0;
@@ -66,6 +77,10 @@ public:
 	virtual void copySuffixStorageFrom(const Node<DIM>& other) =0;
 
 	NodeAddressContent<DIM> lookup(unsigned long address, bool resolveSuffixIndex) const;
+	// calls callback(content) for every content in ascending address order without
+	// creating iterators (the callback must not change the contents of this node)
+	template <typename CALLBACK>
+	void forEachContent(CALLBACK& callback, bool resolveSuffixIndex = true) const;
 	// attention: linear checks! should be used for validation only
 	bool containsId(int id) const;
 	size_t getNStoredSuffixes() const;
@@ -83,6 +98,16 @@ Node<DIM>::~Node() {
 	pthread_rwlock_destroy(&rwLock);
 }
 
+template <unsigned int DIM>
+void* Node<DIM>::operator new(size_t bytes) {
+	return NodeArena::allocateOwned(bytes);
+}
+
+template <unsigned int DIM>
+void Node<DIM>::operator delete(void* pointer, size_t bytes) {
+	NodeArena::deallocateOwned(pointer, bytes);
+}
+
 template <unsigned int DIM>
 NodeAddressContent<DIM> Node<DIM>::lookup(unsigned long address, bool resolveSuffixIndex) const {
 	NodeAddressContent<DIM> content;
@@ -91,40 +116,41 @@ NodeAddressContent<DIM> Node<DIM>::lookup(unsigned long address, bool resolveSuf
 }
 
 template <unsigned int DIM>
-bool Node<DIM>::containsId(int id) const {
-	NodeIterator<DIM>* startIt = this->begin();
-	NodeIterator<DIM>* endIt = this->end();
-	for (; (*startIt) != (*endIt); ++(*startIt)) {
-		NodeAddressContent<DIM> content = *(*startIt);
-		if (content.exists && !content.hasSubnode && content.id == id) {
-			return true;
+template <typename CALLBACK>
+void Node<DIM>::forEachContent(CALLBACK& callback, bool resolveSuffixIndex) const {
+	NodeRawContents<DIM> contents;
+	this->getRawContents(contents);
+	NodeAddressContent<DIM> content;
+	for (unsigned int row = contents.nextRow(0); row < contents.nRows; row = contents.nextRow(row + 1)) {
+		contents.getContent(row, content, resolveSuffixIndex);
+		if (content.exists) {
+			callback(content);
 		}
 	}
+}
+
+template <unsigned int DIM>
+bool Node<DIM>::containsId(int id) const {
+	bool found = false;
+	auto checkId = [id, &found] (const NodeAddressContent<DIM>& content) {
+		found = found || (!content.hasSubnode && !content.hasSpecialPointer && content.id == id);
+	};
 
-	delete startIt;
-	delete endIt;
-	return false;
+	this->forEachContent(checkId, false);
+	return found;
 }
 
 template <unsigned int DIM>
 size_t Node<DIM>::getNStoredSuffixes() const {
-	if (this->getNumberOfContents() != 0) {
-		size_t nSuffixes = 0;
-		NodeIterator<DIM>* startIt = this->begin();
-		NodeIterator<DIM>* endIt = this->end();
-		for (; (*startIt) != (*endIt); ++(*startIt)) {
-			NodeAddressContent<DIM> content = *(*startIt);
-			if (content.exists && !content.hasSubnode && !content.hasSpecialPointer) {
-				++nSuffixes;
-			}
+	size_t nSuffixes = 0;
+	auto countSuffix = [&nSuffixes] (const NodeAddressContent<DIM>& content) {
+		if (!content.hasSubnode && !content.hasSpecialPointer) {
+			++nSuffixes;
 		}
+	};
 
-		delete startIt;
-		delete endIt;
-		return nSuffixes;
-	} else {
-		return 0;
-	}
+	this->forEachContent(countSuffix, false);
+	return nSuffixes;
 }
 
 #endif /* SRC_NODE_H_ */
@@ -0,0 +1,161 @@
+#ifndef SRC_NODES_NODERAWCONTENTS_H_
+#define SRC_NODES_NODERAWCONTENTS_H_
+
+#include <cstdint>
+#include "nodes/NodeAddressContent.h"
+
+// Plain view on the arrays of a node that can be traversed without virtual calls.
+// Rows hold the references in ascending HC address order:
+// - LHC: the addresses of the rows are bit-packed in 'addresses'
+// - AHC: the row is the address, 'addresses' is NULL and empty rows hold a 0 reference
+//   while 'occupied' has a bit per row which is only set for filled rows
+// The view is only valid as long as the node is not changed.
+template <unsigned int DIM>
+struct NodeRawContents {
+	const unsigned long* addresses;
+	const unsigned long* occupied;
+	const std::uintptr_t* references;
+	unsigned int nRows;
+	// suffix indices of references flagged with 11 are relative to this block
+	const unsigned long* suffixBlocks;
+	const unsigned long* prefix;
+	size_t prefixLength;
+
+	inline unsigned long getAddress(unsigned int row) const;
+	// returns the first row with an address >= hcAddress
+	inline unsigned int lowerBound(unsigned long hcAddress) const;
+	// returns the first row >= the given one that holds an entry or nRows if there is none
+	// (all LHC rows hold an entry so only empty AHC rows are skipped)
+	inline unsigned int nextRow(unsigned int row) const;
+	// lets nextRow also skip AHC rows whose address does not contain all bits of lowerMask
+	// or contains bits outside of upperMask (LHC rows still need to be checked by the caller)
+	inline void restrictRows(unsigned long lowerMask, unsigned long upperMask);
+	// decodes the reference of the row (does not exist for empty AHC rows)
+	inline void getContent(unsigned int row, NodeAddressContent<DIM>& outContent, bool resolveSuffixIndex) const;
+
+	NodeRawContents();
+
+private:
+	unsigned long rowLowerMask_;
+	unsigned long rowUpperMask_;
+	// the bits of the occupancy blocks that belong to addresses within the masks
+	unsigned long validInBlock_;
+};
+
+#include <assert.h>
+#include "util/AddressSearchUtil.h"
+
+template <unsigned int DIM>
+unsigned long NodeRawContents<DIM>::getAddress(unsigned int row) const {
+	assert (row < nRows);
+	if (!addresses) {
+		return row;
+	}
+
+	const unsigned int nBlocks = 1 + (nRows * DIM - 1) / (sizeof (unsigned long) * 8);
+	return AddressSearchUtil<DIM>::getAddress(addresses, nBlocks, row);
+}
+
+template <unsigned int DIM>
+unsigned int NodeRawContents<DIM>::lowerBound(unsigned long hcAddress) const {
+	if (!addresses) {
+		return (hcAddress < nRows)? hcAddress : nRows;
+	} else if (nRows == 0) {
+		return 0;
+	}
+
+	const unsigned int nBlocks = 1 + (nRows * DIM - 1) / (sizeof (unsigned long) * 8);
+	return AddressSearchUtil<DIM>::branchlessSearch(addresses, nBlocks, nRows, hcAddress);
+}
+
+template <unsigned int DIM>
+NodeRawContents<DIM>::NodeRawContents() : addresses(NULL), occupied(NULL), references(NULL), nRows(0),
+		suffixBlocks(NULL), prefix(NULL), prefixLength(0), rowLowerMask_(0), rowUpperMask_(-1uL),
+		validInBlock_(-1uL) {
+}
+
+template <unsigned int DIM>
+void NodeRawContents<DIM>::restrictRows(unsigned long lowerMask, unsigned long upperMask) {
+	rowLowerMask_ = lowerMask;
+	rowUpperMask_ = upperMask;
+	// the lowest 6 address bits select the bit within a block
+	const unsigned long lowBitPatterns[] = {0xAAAAAAAAAAAAAAAAuL, 0xCCCCCCCCCCCCCCCCuL,
+			0xF0F0F0F0F0F0F0F0uL, 0xFF00FF00FF00FF00uL, 0xFFFF0000FFFF0000uL, 0xFFFFFFFF00000000uL};
+	validInBlock_ = -1uL;
+	for (unsigned int bit = 0; bit < 6; ++bit) {
+		if ((lowerMask >> bit) & 1uL) {
+			validInBlock_ &= lowBitPatterns[bit];
+		}
+		if (!((upperMask >> bit) & 1uL)) {
+			validInBlock_ &= ~lowBitPatterns[bit];
+		}
+	}
+}
+
+template <unsigned int DIM>
+unsigned int NodeRawContents<DIM>::nextRow(unsigned int row) const {
+	if (addresses || row >= nRows) {
+		return (row < nRows)? row : nRows;
+	}
+
+	assert (occupied);
+	const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+	const unsigned int nBlocks = 1 + (nRows - 1) / bitsPerBlock;
+	// the remaining address bits select the block
+	const unsigned long lowerBlockMask = rowLowerMask_ & ~(bitsPerBlock - 1uL);
+	unsigned int block = row / bitsPerBlock;
+	unsigned long bits = occupied[block] & ((-1uL) << (row % bitsPerBlock));
+	while (true) {
+		const unsigned long blockAddress = block * bitsPerBlock;
+		if ((blockAddress & lowerBlockMask) == lowerBlockMask && (blockAddress & ~rowUpperMask_) == 0) {
+			bits &= validInBlock_;
+			if (bits != 0) {
+				return blockAddress + __builtin_ctzl(bits);
+			}
+		}
+
+		if (++block >= nBlocks) {
+			return nRows;
+		}
+
+		bits = occupied[block];
+	}
+}
+
+template <unsigned int DIM>
+void NodeRawContents<DIM>::getContent(unsigned int row, NodeAddressContent<DIM>& outContent,
+		bool resolveSuffixIndex) const {
+	const std::uintptr_t reference = references[row];
+	outContent.address = getAddress(row);
+	outContent.exists = reference != 0;
+	if (!outContent.exists) {
+		return;
+	}
+
+	const bool isSuffix = reference & 1;
+	const bool isPointer = (reference >> 1) & 1;
+	outContent.hasSubnode = isPointer && !isSuffix;
+	outContent.directlyStoredSuffix = !isPointer && isSuffix;
+	outContent.hasSpecialPointer = !isPointer && !isSuffix;
+
+	if (outContent.hasSubnode) {
+		const unsigned long flagMask = ~(3uL);
+		outContent.subnode = reinterpret_cast<Node<DIM>*>(reference & flagMask);
+	} else if (outContent.hasSpecialPointer) {
+		outContent.specialPointer = reference;
+	} else {
+		const unsigned long suffixMask = (-1uL) >> 32;
+		const unsigned int suffixPart = (reference & suffixMask) >> 2;
+		outContent.id = reference >> 32;
+		if (outContent.directlyStoredSuffix) {
+			outContent.suffix = suffixPart;
+		} else if (resolveSuffixIndex) {
+			assert (suffixBlocks);
+			outContent.suffixStartBlock = suffixBlocks + suffixPart;
+		} else {
+			outContent.suffixStartBlockIndex = suffixPart;
+		}
+	}
+}
+
+#endif /* SRC_NODES_NODERAWCONTENTS_H_ */
@@ -37,7 +37,7 @@ using namespace std;
 #include <assert.h>
 
 template <unsigned int SUFFIX_BLOCKS>
-SuffixStorage<SUFFIX_BLOCKS>::SuffixStorage() : currentBlock(0), suffixBlocks() { }
+SuffixStorage<SUFFIX_BLOCKS>::SuffixStorage() : TSuffixStorage(suffixBlocks), currentBlock(0), suffixBlocks() { }
 
 template <unsigned int SUFFIX_BLOCKS>
 unsigned int  SuffixStorage<SUFFIX_BLOCKS>::getNMaxStorageBlocks() const {
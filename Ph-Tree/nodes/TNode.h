@@ -4,6 +4,7 @@
 #include "Entry.h"
 #include "iterators/NodeIterator.h"
 #include "nodes/NodeAddressContent.h"
+#include "nodes/NodeRawContents.h"
 #include "util/MultiDimBitset.h"
 #include "nodes/Node.h"
 
@@ -30,17 +31,19 @@ public:
 	virtual std::ostream& output(std::ostream& os, size_t depth, size_t index, size_t totalBitLength) override;
 	virtual NodeIterator<DIM>* begin() const = 0;
 	virtual NodeIterator<DIM>* it(unsigned long hcAddress) const =0;
+	virtual NodeIterator<DIM>* it(unsigned long hcAddress, NodeIteratorStorage<DIM>& storage) const =0;
 	virtual NodeIterator<DIM>* end() const = 0;
 	virtual void accept(Visitor<DIM>* visitor, size_t depth, unsigned int index) override;
-	virtual void recursiveDelete() = 0;
 	// gets the number of contents: #suffixes + #subnodes
 	virtual size_t getNumberOfContents() const = 0;
 	virtual size_t getMaximumNumberOfContents() const = 0;
 	virtual void lookup(unsigned long address, NodeAddressContent<DIM>& outContent, bool resolveSuffixIndex) const = 0;
+	virtual void getRawContents(NodeRawContents<DIM>& outContents) const = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, uintptr_t pointer) =0;
 	virtual void insertAtAddress(unsigned long hcAddress, unsigned int suffixStartBlockIndex, int id) = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, unsigned long startSuffixBlock, int id) = 0;
 	virtual void insertAtAddress(unsigned long hcAddress, const Node<DIM>* const subnode) = 0;
+	virtual void removeAtAddress(unsigned long hcAddress) = 0;
 	virtual Node<DIM>* adjustSize() = 0;
 
 	size_t getMaxPrefixLength() const override;
@@ -64,6 +67,8 @@ protected:
 
 	TSuffixStorage* getChangeableSuffixStorage() const override;
 	virtual string getName() const =0;
+	// fills the prefix and suffix storage parts of the raw contents
+	void getRawPrefixAndSuffixes(NodeRawContents<DIM>& outContents) const;
 };
 
 #include <assert.h>
@@ -112,19 +117,14 @@ const unsigned long* TNode<DIM, PREF_BLOCKS>::getFixPrefixStartBlock() const {
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 void TNode<DIM, PREF_BLOCKS>::accept(Visitor<DIM>* visitor, size_t depth, unsigned int index) {
 
-	NodeIterator<DIM>* it;
-	NodeIterator<DIM>* endIt = this->end();
-	for (it = this->begin(); (*it) != *endIt; ++(*it)) {
-		NodeAddressContent<DIM> content = *(*it);
-		assert (content.exists);
+	auto acceptSubnode = [visitor, depth, index] (const NodeAddressContent<DIM>& content) {
 		if (content.hasSubnode) {
 			const size_t prefixLength = content.subnode->getPrefixLength();
 			content.subnode->accept(visitor, depth + 1, index + prefixLength + 1);
 		}
-	}
+	};
 
-	delete it;
-	delete endIt;
+	this->forEachContent(acceptSubnode, false);
 }
 
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
@@ -215,6 +215,13 @@ void TNode<DIM, PREF_BLOCKS>::copySuffixStorageFrom(const Node<DIM>& other) {
 	suffixes_ = other.getChangeableSuffixStorage();
 }
 
+template <unsigned int DIM, unsigned int PREF_BLOCKS>
+void TNode<DIM, PREF_BLOCKS>::getRawPrefixAndSuffixes(NodeRawContents<DIM>& outContents) const {
+	outContents.prefix = prefix_;
+	outContents.prefixLength = prefixBits_ / DIM;
+	outContents.suffixBlocks = (suffixes_)? suffixes_->getStartBlock() : NULL;
+}
+
 template <unsigned int DIM, unsigned int PREF_BLOCKS>
 ostream& TNode<DIM, PREF_BLOCKS>::output(std::ostream& os, size_t depth, size_t index, size_t totalBitLength) {
 	os << this->getName() << " | prefix: ";
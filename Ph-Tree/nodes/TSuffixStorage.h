@@ -1,6 +1,8 @@
 #ifndef SRC_NODES_TSUFFIXSTORAGE_H_
 #define SRC_NODES_TSUFFIXSTORAGE_H_
 
+#include "util/NodeArena.h"
+
 template <unsigned int DIM>
 class SizeVisitor;
 
@@ -8,8 +10,11 @@ class TSuffixStorage {
 	template <unsigned int D>
 	friend class SizeVisitor;
 public:
-	TSuffixStorage() {};
+	explicit TSuffixStorage(unsigned long* startBlock) : startBlock_(startBlock) {};
 	virtual ~TSuffixStorage() {};
+	// suffix storages are allocated from the arena of the tree they belong to
+	static void* operator new(size_t bytes) { return NodeArena::allocateOwned(bytes); }
+	static void operator delete(void* pointer, size_t bytes) { NodeArena::deallocateOwned(pointer, bytes); }
 	virtual bool canStoreBits(size_t nBitsToStore) const =0;
 	virtual unsigned int getTotalBlocksToStoreAdditionalSuffix(size_t nSuffixBits) const =0;
 	// override the given index blocks with the last index blocks
@@ -27,9 +32,14 @@ public:
 	virtual size_t getByteSize() const =0;
 
 	size_t getNStoredSuffixes(size_t suffixBits) const;
+	// same as getPointerFromIndex(0) but without a virtual call for walking raw node contents
+	const unsigned long* getStartBlock() const { return startBlock_; }
+
+private:
+	unsigned long* const startBlock_;
 };
 
-size_t TSuffixStorage::getNStoredSuffixes(size_t suffixBits) const {
+inline size_t TSuffixStorage::getNStoredSuffixes(size_t suffixBits) const {
 	const size_t currentBlocks = this->getNCurrentStorageBlocks();
 	const size_t blocksPerSuffix = 1 + (suffixBits - 1) / (8 * sizeof (unsigned long));
 	assert (currentBlocks % blocksPerSuffix == 0);
@@ -0,0 +1,86 @@
+#ifndef SRC_UTIL_ADDRESSSEARCHUTIL_H_
+#define SRC_UTIL_ADDRESSSEARCHUTIL_H_
+
+// Search in ascending HC addresses that are bit-packed with DIM bits per row as in the LHC:
+// block : <-------------------- 64 --------------------><--- ...
+// bits  : <-   DIM    ->|<-   DIM    -> * m
+template <unsigned int DIM>
+class AddressSearchUtil {
+public:
+	// nBlocks is the number of blocks that can be read
+	static inline unsigned long getAddress(const unsigned long* addresses, unsigned int nBlocks, unsigned int row);
+	// both searches return the first row in [0, m) with an address >= hcAddress or m if there is none
+	static inline unsigned int binarySearch(const unsigned long* addresses, unsigned int nBlocks,
+			unsigned int m, unsigned long hcAddress);
+	static inline unsigned int branchlessSearch(const unsigned long* addresses, unsigned int nBlocks,
+			unsigned int m, unsigned long hcAddress);
+
+private:
+	static const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+};
+
+#include <assert.h>
+
+template <unsigned int DIM>
+unsigned long AddressSearchUtil<DIM>::getAddress(const unsigned long* addresses,
+		unsigned int nBlocks, unsigned int row) {
+	assert (DIM < bitsPerBlock);
+	const unsigned long addressMask = (1uL << DIM) - 1uL;
+	const unsigned int firstBit = row * DIM;
+	const unsigned int blockIndex = firstBit / bitsPerBlock;
+	const unsigned int bitIndex = firstBit % bitsPerBlock;
+	assert (blockIndex < nBlocks);
+
+	if (bitsPerBlock % DIM == 0) {
+		// addresses are never split into two blocks
+		return (addresses[blockIndex] >> bitIndex) & addressMask;
+	}
+
+	// always combine with the next block (if there is one) to not branch on split addresses
+	// and shift in two steps to avoid an undefined shift by 64 bits for bitIndex == 0
+	const unsigned int nextBlockIndex = (blockIndex + 1 < nBlocks)? blockIndex + 1 : blockIndex;
+	const unsigned long nextBlockBits = (addresses[nextBlockIndex] << 1) << (bitsPerBlock - 1 - bitIndex);
+	return ((addresses[blockIndex] >> bitIndex) | nextBlockBits) & addressMask;
+}
+
+template <unsigned int DIM>
+unsigned int AddressSearchUtil<DIM>::binarySearch(const unsigned long* addresses,
+		unsigned int nBlocks, unsigned int m, unsigned long hcAddress) {
+	unsigned int l = 0;
+	unsigned int r = m;
+	while (l < r) {
+		const unsigned int middle = (l + r) / 2;
+		const unsigned long currentHcAddress = getAddress(addresses, nBlocks, middle);
+		if (currentHcAddress < hcAddress) {
+			l = middle + 1;
+		} else if (currentHcAddress > hcAddress) {
+			r = middle;
+		} else {
+			return middle;
+		}
+	}
+
+	return l;
+}
+
+template <unsigned int DIM>
+unsigned int AddressSearchUtil<DIM>::branchlessSearch(const unsigned long* addresses,
+		unsigned int nBlocks, unsigned int m, unsigned long hcAddress) {
+	if (m == 0) {
+		return 0;
+	}
+
+	// halve the range with a conditional move instead of a hard to predict branch
+	unsigned int base = 0;
+	unsigned int n = m;
+	while (n > 1) {
+		const unsigned int half = n / 2;
+		const unsigned long middleHcAddress = getAddress(addresses, nBlocks, base + half);
+		base = (middleHcAddress < hcAddress)? base + half : base;
+		n -= half;
+	}
+
+	return base + (getAddress(addresses, nBlocks, base) < hcAddress);
+}
+
+#endif /* SRC_UTIL_ADDRESSSEARCHUTIL_H_ */
@@ -0,0 +1,306 @@
+#ifndef SRC_UTIL_BULKLOADTHREADPOOL_H_
+#define SRC_UTIL_BULKLOADTHREADPOOL_H_
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <boost/thread/barrier.hpp>
+#include "util/PointSpan.h"
+
+template <unsigned int DIM, unsigned int WIDTH>
+class Entry;
+template <unsigned int DIM>
+class Node;
+class NodeArena;
+
+// Builds a tree from unsorted entries with several threads. The entries are sorted in Z-order
+// by a sample sort: splitters taken from a sorted sample assign every entry to a partition, the
+// partitions are scattered into one array and sorted independently. The sorted entries are then
+// split from the root downwards (i.e. by the HC addresses of the top nodes) until every subtree
+// is small enough, so skewed data is split deeper than uniform data. The threads build the
+// subtrees in their own arenas without any locking and the top nodes are built on top of them.
+template <unsigned int DIM, unsigned int WIDTH>
+class BulkLoadThreadPool {
+public:
+
+	// loads the i-th point with ids[i] or with the ID i if there are no IDs
+	BulkLoadThreadPool(size_t nAdditionalThreads, const PointSpan<DIM>& values,
+			const int* ids, NodeArena* arena);
+	~BulkLoadThreadPool();
+	// returns the root of the loaded tree which is allocated from the arena of the calling thread
+	Node<DIM>* joinPool();
+	// the entries sorted in Z-order (including duplicates of which only the first one was stored)
+	const std::vector<Entry<DIM, WIDTH>>& getSortedEntries() const;
+
+private:
+	// enough partitions and subtrees to balance their different sizes between the threads
+	static const size_t partitionsPerThread = 8;
+	// number of samples per partition to find the splitters
+	static const size_t samplesPerPartition = 16;
+
+	// consecutive sorted entries [first, last] that form the subnode below the given index
+	struct Subtree {
+		const Entry<DIM, WIDTH>* first;
+		const Entry<DIM, WIDTH>* last;
+		size_t index;
+		size_t prefixLength;
+		Node<DIM>* node;
+	};
+
+	// returns the subtrees built by the threads and builds all nodes above them
+	struct AttachingBuilder {
+		BulkLoadThreadPool<DIM, WIDTH>* pool;
+		size_t nextSubtree;
+
+		Node<DIM>* operator()(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+				size_t index, size_t prefixLength);
+	};
+
+	size_t nThreads_;
+	std::vector<std::thread> threads_;
+	boost::barrier* phaseBarrier_;
+	const PointSpan<DIM> values_;
+	const int* ids_;
+	// every thread builds its subtrees in its own arena
+	std::vector<NodeArena*> arenas_;
+
+	std::vector<Entry<DIM, WIDTH>> splitters_;
+	// entries in input order, their partitions and the number of entries per thread and partition
+	std::vector<Entry<DIM, WIDTH>> unsortedEntries_;
+	std::vector<unsigned int> partitionOf_;
+	std::vector<std::vector<size_t>> partitionSizes_;
+	// first entry of each partition in the sorted entries (the last offset is the number of entries)
+	std::vector<size_t> partitionOffsets_;
+	// per thread and partition the position of the thread's next entry
+	std::vector<std::vector<size_t>> scatterOffsets_;
+	std::vector<Entry<DIM, WIDTH>> entries_;
+	std::atomic<size_t> nextPartition_;
+
+	size_t maxSubtreeEntries_;
+	std::vector<Subtree> subtrees_;
+	std::atomic<size_t> nextSubtree_;
+
+	void selectSplitters();
+	void classify(size_t threadIndex);
+	void computeOffsets();
+	void scatter(size_t threadIndex);
+	void sortPartitions();
+	void split(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last, size_t index, size_t prefixLength);
+	void buildSubtrees(size_t threadIndex);
+	void processNext(size_t threadIndex);
+};
+
+#include <assert.h>
+#include <algorithm>
+#include "Entry.h"
+#include "nodes/Node.h"
+#include "util/BulkLoadUtil.h"
+#include "util/NodeArena.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+BulkLoadThreadPool<DIM, WIDTH>::BulkLoadThreadPool(size_t nAdditionalThreads,
+		const PointSpan<DIM>& values, const int* ids, NodeArena* arena)
+		: nThreads_(nAdditionalThreads + 1), threads_(), phaseBarrier_(NULL), values_(values),
+		  ids_(ids), arenas_(), splitters_(), unsortedEntries_(values.size()), partitionOf_(values.size()),
+		  partitionSizes_(), partitionOffsets_(), scatterOffsets_(), entries_(values.size()),
+		  nextPartition_(0), maxSubtreeEntries_(0), subtrees_(), nextSubtree_(0) {
+	assert (values.size() > 0);
+
+	selectSplitters();
+	const size_t nPartitions = splitters_.size() + 1;
+	partitionSizes_.assign(nThreads_, vector<size_t>(nPartitions, 0));
+	scatterOffsets_.assign(nThreads_, vector<size_t>(nPartitions, 0));
+
+	arenas_.reserve(nThreads_);
+	for (unsigned tCount = 0; tCount < nThreads_; ++tCount) {
+		arenas_.push_back(arena->createWorkerArena());
+	}
+
+	phaseBarrier_ = new boost::barrier(nThreads_);
+	threads_.reserve(nAdditionalThreads);
+	for (unsigned tCount = 0; tCount < nAdditionalThreads; ++tCount) {
+		threads_.emplace_back(&BulkLoadThreadPool<DIM,WIDTH>::processNext, this, tCount + 1);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+BulkLoadThreadPool<DIM, WIDTH>::~BulkLoadThreadPool() {
+	for (auto &t : threads_) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+
+	delete phaseBarrier_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Node<DIM>* BulkLoadThreadPool<DIM, WIDTH>::joinPool() {
+	processNext(0);
+	for (auto &t : threads_) {
+		t.join();
+	}
+
+	// the root node never has a prefix so it can be split by later insertions
+	AttachingBuilder buildSubnode = {this, 0};
+	Node<DIM>* root = BulkLoadUtil<DIM, WIDTH>::buildNode(&entries_.front(), &entries_.back(), 0, 0, buildSubnode);
+	assert (buildSubnode.nextSubtree == subtrees_.size());
+	return root;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+const vector<Entry<DIM, WIDTH>>& BulkLoadThreadPool<DIM, WIDTH>::getSortedEntries() const {
+	return entries_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Node<DIM>* BulkLoadThreadPool<DIM, WIDTH>::AttachingBuilder::operator()(const Entry<DIM, WIDTH>* first,
+		const Entry<DIM, WIDTH>* last, size_t index, size_t prefixLength) {
+	// visits the subnodes in the same order as split()
+	if (size_t(last - first) < pool->maxSubtreeEntries_) {
+		const Subtree& subtree = pool->subtrees_[nextSubtree++];
+		assert (subtree.first == first && subtree.last == last);
+		assert (subtree.node);
+		return subtree.node;
+	}
+
+	return BulkLoadUtil<DIM, WIDTH>::buildNode(first, last, index, prefixLength, *this);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::selectSplitters() {
+	const size_t size = values_.size();
+	const size_t nPartitions = (nThreads_ == 1)? 1 : nThreads_ * partitionsPerThread;
+	const size_t nSamples = min(size, nPartitions * samplesPerPartition);
+
+	// samples at regular positions so presorted input is split evenly as well
+	vector<Entry<DIM, WIDTH>> samples(nSamples);
+	for (size_t s = 0; s < nSamples; ++s) {
+		samples[s].reinit(values_[s * size / nSamples], 0);
+	}
+
+	sort(samples.begin(), samples.end(), BulkLoadUtil<DIM, WIDTH>::zOrderLess);
+	for (size_t p = 1; p < nPartitions; ++p) {
+		splitters_.push_back(samples[p * nSamples / nPartitions]);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::classify(size_t threadIndex) {
+	const size_t size = values_.size();
+	const size_t start = size * threadIndex / nThreads_;
+	const size_t end = size * (threadIndex + 1) / nThreads_;
+	vector<size_t>& sizes = partitionSizes_[threadIndex];
+	for (size_t i = start; i < end; ++i) {
+		const int id = (ids_)? ids_[i] : i;
+		unsortedEntries_[i].reinit(values_[i], id);
+		// equal entries always end up in the same partition
+		const size_t partition = upper_bound(splitters_.begin(), splitters_.end(), unsortedEntries_[i],
+				BulkLoadUtil<DIM, WIDTH>::zOrderLess) - splitters_.begin();
+		partitionOf_[i] = partition;
+		++sizes[partition];
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::computeOffsets() {
+	// within a partition the entries of lower threads come first which keeps the input order
+	const size_t nPartitions = splitters_.size() + 1;
+	partitionOffsets_.resize(nPartitions + 1);
+	size_t offset = 0;
+	for (size_t p = 0; p < nPartitions; ++p) {
+		partitionOffsets_[p] = offset;
+		for (size_t t = 0; t < nThreads_; ++t) {
+			scatterOffsets_[t][p] = offset;
+			offset += partitionSizes_[t][p];
+		}
+	}
+
+	assert (offset == values_.size());
+	partitionOffsets_[nPartitions] = offset;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::scatter(size_t threadIndex) {
+	const size_t size = values_.size();
+	const size_t start = size * threadIndex / nThreads_;
+	const size_t end = size * (threadIndex + 1) / nThreads_;
+	vector<size_t>& offsets = scatterOffsets_[threadIndex];
+	for (size_t i = start; i < end; ++i) {
+		entries_[offsets[partitionOf_[i]]++] = unsortedEntries_[i];
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::sortPartitions() {
+	const size_t nPartitions = splitters_.size() + 1;
+	size_t p = nextPartition_.fetch_add(1, memory_order_relaxed);
+	while (p < nPartitions) {
+		// the stable sort keeps the first of several equal entries in front
+		stable_sort(entries_.begin() + partitionOffsets_[p], entries_.begin() + partitionOffsets_[p + 1],
+				BulkLoadUtil<DIM, WIDTH>::zOrderLess);
+		p = nextPartition_.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::split(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+		size_t index, size_t prefixLength) {
+	// subnodes with too many entries are split further in ascending HC address order
+	auto addSubtree = [this] (const Entry<DIM, WIDTH>* rangeFirst, const Entry<DIM, WIDTH>* rangeLast,
+			size_t subIndex, size_t subPrefixLength) {
+		if (size_t(rangeLast - rangeFirst) < maxSubtreeEntries_) {
+			subtrees_.push_back({rangeFirst, rangeLast, subIndex, subPrefixLength, NULL});
+		} else {
+			split(rangeFirst, rangeLast, subIndex, subPrefixLength);
+		}
+	};
+
+	BulkLoadUtil<DIM, WIDTH>::forEachSubnode(first, last, index, prefixLength, addSubtree);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::buildSubtrees(size_t threadIndex) {
+	// the subtrees are disjoint and only reference the nodes of the building thread
+	NodeArena::Scope arenaScope(arenas_[threadIndex]);
+	typename BulkLoadUtil<DIM, WIDTH>::RecursiveBuilder buildSubnode;
+	size_t i = nextSubtree_.fetch_add(1, memory_order_relaxed);
+	while (i < subtrees_.size()) {
+		Subtree& subtree = subtrees_[i];
+		subtree.node = BulkLoadUtil<DIM, WIDTH>::buildNode(subtree.first, subtree.last,
+				subtree.index, subtree.prefixLength, buildSubnode);
+		i = nextSubtree_.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadThreadPool<DIM, WIDTH>::processNext(size_t threadIndex) {
+	classify(threadIndex);
+	phaseBarrier_->wait();
+	if (threadIndex == 0) {
+		computeOffsets();
+	}
+
+	phaseBarrier_->wait();
+	scatter(threadIndex);
+	phaseBarrier_->wait();
+	if (threadIndex == 0) {
+		vector<Entry<DIM, WIDTH>>().swap(unsortedEntries_);
+	}
+
+	sortPartitions();
+	phaseBarrier_->wait();
+	if (threadIndex == 0) {
+		// more subtrees than threads so large and small subtrees can be balanced
+		const size_t nSubtrees = (nThreads_ == 1)? 1 : nThreads_ * partitionsPerThread;
+		maxSubtreeEntries_ = max(size_t(1), entries_.size() / nSubtrees);
+		split(&entries_.front(), &entries_.back(), 0, 0);
+	}
+
+	phaseBarrier_->wait();
+	buildSubtrees(threadIndex);
+}
+
+#endif /* SRC_UTIL_BULKLOADTHREADPOOL_H_ */
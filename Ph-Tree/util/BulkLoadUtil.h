@@ -0,0 +1,211 @@
+#ifndef SRC_UTIL_BULKLOADUTIL_H_
+#define SRC_UTIL_BULKLOADUTIL_H_
+
+#include <vector>
+
+template <unsigned int DIM, unsigned int WIDTH>
+class Entry;
+template <unsigned int DIM>
+class Node;
+
+// Builds a tree from entries that are sorted by their interleaved bits (Z-order). Entries that
+// share a node are stored next to each other so the prefix of a node is the common prefix of its
+// first and last entry and all entries of one HC address form a consecutive range. Thus, every
+// node is built once with its final type, number of contents, prefix and suffix storage size.
+template <unsigned int DIM, unsigned int WIDTH>
+class BulkLoadUtil {
+public:
+	// sorts the entries in Z-order (duplicates keep their relative order)
+	static void sortByZOrder(std::vector<Entry<DIM, WIDTH>>& entries);
+	// builds a root node (without prefix) for the sorted entries, only the first of several equal entries is stored
+	static Node<DIM>* buildTree(const std::vector<Entry<DIM, WIDTH>>& sortedEntries);
+	// builds the node for the entries [first, last] which share all bits before the given index and
+	// gets each of its subnodes from buildSubnode(first, last, index, prefixLength)
+	template <typename SUBNODE_BUILDER>
+	static Node<DIM>* buildNode(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+			size_t index, size_t prefixLength, SUBNODE_BUILDER& buildSubnode);
+	// calls callback(first, last, index, prefixLength) for the entries of every subnode buildNode() would create
+	template <typename CALLBACK>
+	static void forEachSubnode(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+			size_t index, size_t prefixLength, CALLBACK& callback);
+
+	static bool zOrderLess(const Entry<DIM, WIDTH>& entry1, const Entry<DIM, WIDTH>& entry2);
+
+	// builds all subnodes recursively on the calling thread
+	struct RecursiveBuilder {
+		Node<DIM>* operator()(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+				size_t index, size_t prefixLength) {
+			return buildNode(first, last, index, prefixLength, *this);
+		}
+	};
+
+private:
+	static const unsigned int nBlocks = 1 + (DIM * WIDTH - 1) / (8 * sizeof (unsigned long));
+
+	// calls callback(first, last, hcAddress, differentIndex) for the consecutive entries of every HC address
+	// at the given index where differentIndex is the first index at which these entries differ
+	template <typename CALLBACK>
+	static void forEachAddressRange(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+			size_t index, CALLBACK& callback);
+	// returns the last entry that has the same HC address at the given index as the first one
+	static const Entry<DIM, WIDTH>* lastWithAddress(const Entry<DIM, WIDTH>* first,
+			const Entry<DIM, WIDTH>* last, size_t index, unsigned long hcAddress);
+	// returns the index of the first bit at which the entries differ (WIDTH if they are equal)
+	static size_t firstDifferentIndex(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last);
+};
+
+#include <assert.h>
+#include <algorithm>
+#include "Entry.h"
+#include "nodes/Node.h"
+#include "util/MultiDimBitset.h"
+#include "util/NodeTypeUtil.h"
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool BulkLoadUtil<DIM, WIDTH>::zOrderLess(const Entry<DIM, WIDTH>& entry1, const Entry<DIM, WIDTH>& entry2) {
+	// the highest bits are stored in the last block
+	for (unsigned block = nBlocks - 1; block != -1u; --block) {
+		if (entry1.values_[block] != entry2.values_[block]) {
+			return entry1.values_[block] < entry2.values_[block];
+		}
+	}
+
+	return false;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void BulkLoadUtil<DIM, WIDTH>::sortByZOrder(std::vector<Entry<DIM, WIDTH>>& entries) {
+	std::stable_sort(entries.begin(), entries.end(), zOrderLess);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Node<DIM>* BulkLoadUtil<DIM, WIDTH>::buildTree(const std::vector<Entry<DIM, WIDTH>>& sortedEntries) {
+	assert (!sortedEntries.empty());
+	assert (std::is_sorted(sortedEntries.begin(), sortedEntries.end(), zOrderLess));
+	// the root node never has a prefix so it can be split by later insertions
+	RecursiveBuilder buildSubnode;
+	return buildNode(&sortedEntries.front(), &sortedEntries.back(), 0, 0, buildSubnode);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+size_t BulkLoadUtil<DIM, WIDTH>::firstDifferentIndex(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last) {
+	if (first == last) {
+		return WIDTH;
+	}
+
+	return MultiDimBitset<DIM>::compareFullAligned(first->values_, DIM * WIDTH, last->values_);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+const Entry<DIM, WIDTH>* BulkLoadUtil<DIM, WIDTH>::lastWithAddress(const Entry<DIM, WIDTH>* first,
+		const Entry<DIM, WIDTH>* last, size_t index, unsigned long hcAddress) {
+	assert (MultiDimBitset<DIM>::interleaveBits(first->values_, index, DIM * WIDTH) == hcAddress);
+	// the ranges of single entries are most common so check the next entry before searching
+	if (first == last || MultiDimBitset<DIM>::interleaveBits((first + 1)->values_, index, DIM * WIDTH) != hcAddress) {
+		return first;
+	}
+
+	// binary search for the last entry with the address in (first, last]
+	const Entry<DIM, WIDTH>* l = first + 1;
+	const Entry<DIM, WIDTH>* r = last + 1;
+	while (r - l > 1) {
+		const Entry<DIM, WIDTH>* middle = l + (r - l) / 2;
+		if (MultiDimBitset<DIM>::interleaveBits(middle->values_, index, DIM * WIDTH) == hcAddress) {
+			l = middle;
+		} else {
+			r = middle;
+		}
+	}
+
+	return l;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void BulkLoadUtil<DIM, WIDTH>::forEachAddressRange(const Entry<DIM, WIDTH>* first,
+		const Entry<DIM, WIDTH>* last, size_t index, CALLBACK& callback) {
+	for (const Entry<DIM, WIDTH>* rangeFirst = first; rangeFirst <= last;) {
+		const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(rangeFirst->values_, index, DIM * WIDTH);
+		const Entry<DIM, WIDTH>* rangeLast = lastWithAddress(rangeFirst, last, index, hcAddress);
+		callback(rangeFirst, rangeLast, hcAddress, firstDifferentIndex(rangeFirst, rangeLast));
+		rangeFirst = rangeLast + 1;
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void BulkLoadUtil<DIM, WIDTH>::forEachSubnode(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+		size_t index, size_t prefixLength, CALLBACK& callback) {
+	const size_t currentIndex = index + prefixLength;
+	auto subnodeRange = [currentIndex, &callback] (const Entry<DIM, WIDTH>* rangeFirst,
+			const Entry<DIM, WIDTH>* rangeLast, unsigned long hcAddress, size_t differentIndex) {
+		if (differentIndex < WIDTH) {
+			callback(rangeFirst, rangeLast, currentIndex + 1, differentIndex - currentIndex - 1);
+		}
+	};
+
+	forEachAddressRange(first, last, currentIndex, subnodeRange);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename SUBNODE_BUILDER>
+Node<DIM>* BulkLoadUtil<DIM, WIDTH>::buildNode(const Entry<DIM, WIDTH>* first, const Entry<DIM, WIDTH>* last,
+		size_t index, size_t prefixLength, SUBNODE_BUILDER& buildSubnode) {
+	const size_t currentIndex = index + prefixLength;
+	assert (currentIndex < WIDTH);
+	const size_t suffixBits = DIM * (WIDTH - currentIndex - 1);
+
+	// 1. count the contents: a range of entries with the same address becomes a subnode
+	// unless all of its entries are equal
+	size_t nContents = 0;
+	size_t nSuffixes = 0;
+	auto countContent = [&nContents, &nSuffixes] (const Entry<DIM, WIDTH>* rangeFirst,
+			const Entry<DIM, WIDTH>* rangeLast, unsigned long hcAddress, size_t differentIndex) {
+		++nContents;
+		if (differentIndex == WIDTH) {
+			++nSuffixes;
+		}
+	};
+
+	forEachAddressRange(first, last, currentIndex, countContent);
+
+	// 2. build the smallest node that holds all contents and copy the common prefix of all entries
+	assert (nContents <= (1uL << DIM));
+	assert (nContents > 1 || index == 0);
+	Node<DIM>* node = NodeTypeUtil<DIM>::template buildTightNodeWithSuffixes<WIDTH>(
+			DIM * prefixLength, nContents, nSuffixes, suffixBits);
+	if (prefixLength > 0) {
+		MultiDimBitset<DIM>::duplicateBits(first->values_, DIM * (WIDTH - index),
+				prefixLength, node->getPrefixStartBlock());
+	}
+
+	// 3. insert the contents in ascending address order
+	const bool storeSuffixInNode = node->canStoreSuffixInternally(suffixBits);
+	auto insertContent = [node, currentIndex, suffixBits, storeSuffixInNode, &buildSubnode] (
+			const Entry<DIM, WIDTH>* rangeFirst, const Entry<DIM, WIDTH>* rangeLast,
+			unsigned long hcAddress, size_t differentIndex) {
+		if (differentIndex < WIDTH) {
+			assert (differentIndex > currentIndex);
+			Node<DIM>* subnode = buildSubnode(rangeFirst, rangeLast, currentIndex + 1, differentIndex - currentIndex - 1);
+			node->insertAtAddress(hcAddress, subnode);
+		} else if (storeSuffixInNode) {
+			unsigned long suffix = 0uL;
+			MultiDimBitset<DIM>::removeHighestBits(rangeFirst->values_, DIM * WIDTH, currentIndex + 1, &suffix);
+			node->insertAtAddress(hcAddress, suffix, rangeFirst->id_);
+		} else {
+			assert (node->canStoreSuffix(suffixBits) == 0);
+			const pair<unsigned long*, unsigned int> suffixStartBlock = node->reserveSuffixSpace(suffixBits);
+			MultiDimBitset<DIM>::removeHighestBits(rangeFirst->values_, DIM * WIDTH, currentIndex + 1, suffixStartBlock.first);
+			node->insertAtAddress(hcAddress, suffixStartBlock.second, rangeFirst->id_);
+		}
+	};
+
+	forEachAddressRange(first, last, currentIndex, insertContent);
+
+	assert (node->getNumberOfContents() == nContents);
+	assert (!node->getSuffixStorage()
+			|| node->getSuffixStorage()->getNStoredSuffixes(suffixBits) == nSuffixes);
+	return node;
+}
+
+#endif /* SRC_UTIL_BULKLOADUTIL_H_ */
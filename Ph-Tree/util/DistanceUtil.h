@@ -0,0 +1,82 @@
+#ifndef SRC_UTIL_DISTANCEUTIL_H_
+#define SRC_UTIL_DISTANCEUTIL_H_
+
+enum DistanceMetric {
+	euclidean_distance, // DEFAULT
+	l1_distance
+};
+
+// Distances between points and boxes of per dimension values. The Euclidean distance is
+// returned squared so that it can be compared without taking the root.
+template <unsigned int DIM>
+class DistanceUtil {
+public:
+	// distance between the point and the closest point of the box [lower, upper]
+	static inline double minDistance(DistanceMetric metric, const unsigned long* point,
+			const unsigned long* lower, const unsigned long* upper);
+	// distance between the point and the farthest point of the box [lower, upper]
+	static inline double maxDistance(DistanceMetric metric, const unsigned long* point,
+			const unsigned long* lower, const unsigned long* upper);
+	// converts a distance bound into the form returned above and back (the bound is inclusive: points
+	// at exactly the given distance stay within it even if the distance was rounded, e.g. by a root)
+	static inline double toComparable(DistanceMetric metric, double distance);
+	static inline double fromComparable(DistanceMetric metric, double comparable);
+
+private:
+	static inline double add(DistanceMetric metric, double distance, unsigned long difference);
+};
+
+#include <cmath>
+#include <cfloat>
+
+template <unsigned int DIM>
+double DistanceUtil<DIM>::add(DistanceMetric metric, double distance, unsigned long difference) {
+	const double dimensionDistance = difference;
+	return distance + ((metric == euclidean_distance)? dimensionDistance * dimensionDistance : dimensionDistance);
+}
+
+template <unsigned int DIM>
+double DistanceUtil<DIM>::minDistance(DistanceMetric metric, const unsigned long* point,
+		const unsigned long* lower, const unsigned long* upper) {
+	double distance = 0.0;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		if (point[d] < lower[d]) {
+			distance = add(metric, distance, lower[d] - point[d]);
+		} else if (point[d] > upper[d]) {
+			distance = add(metric, distance, point[d] - upper[d]);
+		}
+	}
+
+	return distance;
+}
+
+template <unsigned int DIM>
+double DistanceUtil<DIM>::maxDistance(DistanceMetric metric, const unsigned long* point,
+		const unsigned long* lower, const unsigned long* upper) {
+	double distance = 0.0;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		const unsigned long toLower = (point[d] > lower[d])? point[d] - lower[d] : lower[d] - point[d];
+		const unsigned long toUpper = (point[d] > upper[d])? point[d] - upper[d] : upper[d] - point[d];
+		distance = add(metric, distance, (toLower > toUpper)? toLower : toUpper);
+	}
+
+	return distance;
+}
+
+template <unsigned int DIM>
+double DistanceUtil<DIM>::toComparable(DistanceMetric metric, double distance) {
+	// a few ulps cover the rounding error of distance = sqrt(d), distance * distance and the sum
+	// over the dimensions. All distances between integer values are integers so the bound can be
+	// rounded down if the distances are exact as doubles (i.e. below 2^53).
+	const double maxExactComparable = 9007199254740992.0;
+	const double comparable = (metric == euclidean_distance)? distance * distance : distance;
+	const double tolerantComparable = comparable * (1.0 + (DIM + 4) * DBL_EPSILON);
+	return (tolerantComparable < maxExactComparable)? floor(tolerantComparable) : tolerantComparable;
+}
+
+template <unsigned int DIM>
+double DistanceUtil<DIM>::fromComparable(DistanceMetric metric, double comparable) {
+	return (metric == euclidean_distance)? sqrt(comparable) : comparable;
+}
+
+#endif /* SRC_UTIL_DISTANCEUTIL_H_ */
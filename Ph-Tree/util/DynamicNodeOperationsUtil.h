@@ -8,7 +8,7 @@
 
 #include <atomic>
 #include "nodes/NodeAddressContent.h"
-#include "util/DeletedNodes.h"
+#include "util/EpochReclamation.h"
 #include "util/EntryTreeMap.h"
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -34,6 +34,8 @@ public:
 	static unsigned int nInsertSplitPrefix;
 	static unsigned int nFlushCountWithin;
 	static unsigned int nFlushCountAfter;
+	static unsigned int nEraseMergeIntoParent;
+	static unsigned int nEraseShrinkNode;
 
 	static unsigned int nThreads;
 
@@ -44,13 +46,18 @@ public:
 	static atomic<unsigned long> nRestartWriteSwapSuffix;
 	static atomic<unsigned long> nRestartWriteInsertSuffixEnlarge;
 	static atomic<unsigned long> nRestartWriteInsertSuffix;
+	// buffers flushed during the parallel insertion because they were full
+	static atomic<unsigned long> nFlushCountParallel;
 
 	static void resetCounters();
-	static void insert(const Entry<DIM, WIDTH>& e, PHTree<DIM, WIDTH>& tree);
+	// returns false and leaves the tree unchanged if an entry with the same values is already stored
+	static bool insert(const Entry<DIM, WIDTH>& e, PHTree<DIM, WIDTH>& tree);
 	static void parallelInsert(const Entry<DIM, WIDTH>& e, PHTree<DIM, WIDTH>& tree);
 	static void bulkInsert(const std::vector<Entry<DIM, WIDTH>>& entries, PHTree<DIM, WIDTH>& tree);
+	// replaced nodes are retired so the calling thread needs a guard of the tree's epoch reclamation
 	static bool parallelBulkInsert(const Entry<DIM, WIDTH>& e, PHTree<DIM, WIDTH>& tree,
-			EntryBufferPool<DIM, WIDTH>& pool, DeletedNodes<DIM>& deletedNodes, EntryTreeMap<DIM,WIDTH>& entryTreeMap);
+			EntryBufferPool<DIM, WIDTH>& pool, EntryTreeMap<DIM,WIDTH>& entryTreeMap);
+	static bool erase(const Entry<DIM, WIDTH>& e, PHTree<DIM, WIDTH>& tree);
 
 	static void createSubnodeWithExistingSuffix(size_t currentIndex, Node<DIM>* currentNode,
 			const NodeAddressContent<DIM>& content, const Entry<DIM, WIDTH>& entry,
@@ -64,18 +71,28 @@ public:
 			Node<DIM>* currentNode, const NodeAddressContent<DIM>& content, const Entry<DIM, WIDTH>& entry,
 			PHTree<DIM, WIDTH>& tree);
 
+	static void removeSuffix(size_t currentIndex, Node<DIM>* currentNode,
+			const NodeAddressContent<DIM>& content);
+	static void mergeIntoParent(size_t currentIndex, Node<DIM>* currentNode,
+			Node<DIM>* parentNode, unsigned long parentHcAddress);
+
 	static void flushSubtree(EntryBuffer<DIM, WIDTH>* buffer, bool deallocate);
 private:
 
+	static inline void pushBackLevels(const unsigned long* fromStartBlock, size_t nLevels,
+			unsigned long* toStartBlock, size_t toNBits);
+
 	static inline bool needToCopyNodeForSuffixInsertion(Node<DIM>* currentNode);
 
 	static inline bool writeLockBlocking(Node<DIM>* node);
 	static inline bool writeLockBlocking(Node<DIM>* currentNode, Node<DIM>* previousNode);
 	static inline bool tryWriteLock(Node<DIM>* node);
 	static inline bool tryWriteLock(Node<DIM>* currentNode, Node<DIM>* previousNode);
+	// marks a node that was just write locked as changing (odd version) for optimistic readers
+	static inline void beginWrite(Node<DIM>* node);
 	static inline void writeUnlock(Node<DIM>* node, bool changedSomething = true);
 	static inline void writeUnlock(Node<DIM>* currentNode, Node<DIM>* previousNode);
-	static inline bool downgradeWriterToReader(Node<DIM>* node);
+	static inline bool downgradeWriterToReader(Node<DIM>* node, bool changedSomething);
 	static inline bool readLockBlocking(Node<DIM>* node);
 	static inline bool tryReadLock(Node<DIM>* node);
 	static inline void readUnlock(Node<DIM>* node);
@@ -96,6 +113,10 @@ unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nFlushCountWithin = 0;
 template <unsigned int DIM, unsigned int WIDTH>
 unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nFlushCountAfter = 0;
 template <unsigned int DIM, unsigned int WIDTH>
+unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nEraseMergeIntoParent = 0;
+template <unsigned int DIM, unsigned int WIDTH>
+unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nEraseShrinkNode = 0;
+template <unsigned int DIM, unsigned int WIDTH>
 unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nInsertSuffixBuffer = 0;
 template <unsigned int DIM, unsigned int WIDTH>
 unsigned int DynamicNodeOperationsUtil<DIM, WIDTH>::nInsertSuffixIntoBuffer = 0;
@@ -116,6 +137,8 @@ template <unsigned int DIM, unsigned int WIDTH>
 atomic<unsigned long> DynamicNodeOperationsUtil<DIM, WIDTH>::nRestartWriteInsertSuffixEnlarge;
 template <unsigned int DIM, unsigned int WIDTH>
 atomic<unsigned long> DynamicNodeOperationsUtil<DIM, WIDTH>::nRestartWriteInsertSuffix;
+template <unsigned int DIM, unsigned int WIDTH>
+atomic<unsigned long> DynamicNodeOperationsUtil<DIM, WIDTH>::nFlushCountParallel;
 
 #include <assert.h>
 #include <stdexcept>
@@ -149,6 +172,8 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::resetCounters() {
 	nFlushCountWithin = 0;
 	nInsertSuffixBuffer = 0;
 	nInsertSuffixIntoBuffer = 0;
+	nEraseMergeIntoParent = 0;
+	nEraseShrinkNode = 0;
 
 	nRestartReadRecurse = 0;
 	nRestartWriteSplitPrefix = 0;
@@ -157,6 +182,7 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::resetCounters() {
 	nRestartWriteSwapSuffix = 0;
 	nRestartWriteInsertSuffixEnlarge = 0;
 	nRestartWriteInsertSuffix = 0;
+	nFlushCountParallel = 0;
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -458,6 +484,7 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::writeLockBlocking(Node<DIM>* node) {
 		return false;
 	} else {
 		// got write permission and the node is still valid
+		beginWrite(node);
 		return true;
 	}
 }
@@ -479,6 +506,7 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::tryWriteLock(Node<DIM>* node) {
 		return false;
 	} else if (result == 0) {
 		// got write permission and the node is still valid
+		beginWrite(node);
 		return true;
 	} else {
 		// did not get write permission -> fail
@@ -487,7 +515,10 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::tryWriteLock(Node<DIM>* node) {
 }
 
 template<unsigned int DIM, unsigned int WIDTH>
-bool DynamicNodeOperationsUtil<DIM, WIDTH>::downgradeWriterToReader(Node<DIM>* node) {
+bool DynamicNodeOperationsUtil<DIM, WIDTH>::downgradeWriterToReader(Node<DIM>* node, bool changedSomething) {
+	assert (node->updateCounter % 2 == 1);
+	if (changedSomething) { ++node->updateCounter; }
+	else { --node->updateCounter; }
 	unsigned int updatesBefore = node->updateCounter;
 	int result = pthread_rwlock_unlock(&(node->rwLock));
 	assert (result == 0);
@@ -514,10 +545,12 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::writeLockBlocking(
 		assert (result == 0);
 		unsigned int updatesAfter = child->updateCounter;
 		if (child->removed || updatesBefore != updatesAfter) {
-			writeUnlock(child, false);
+			result = pthread_rwlock_unlock(&(child->rwLock));
+			assert (result == 0);
 			writeUnlock(parent, false);
 			return false;
 		} else {
+			beginWrite(child);
 			return true;
 		}
 	}
@@ -550,10 +583,21 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::writeUnlock(Node<DIM>* child, Node<D
 	writeUnlock(parent);
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void DynamicNodeOperationsUtil<DIM, WIDTH>::beginWrite(Node<DIM>* node) {
+	assert (node->updateCounter % 2 == 0);
+	++node->updateCounter;
+	// the changes must not become visible before the odd version
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 void DynamicNodeOperationsUtil<DIM, WIDTH>::writeUnlock(Node<DIM>* node, bool changedSomething) {
 	assert (node);
+	assert (node->updateCounter % 2 == 1);
+	// writers compare versions to detect changes so an unchanged node gets its previous version back
 	if (changedSomething) { ++node->updateCounter; }
+	else { --node->updateCounter; }
 	const int result = pthread_rwlock_unlock(&(node->rwLock));
 	assert (result == 0);
 }
@@ -561,6 +605,10 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::writeUnlock(Node<DIM>* node, bool ch
 template <unsigned int DIM, unsigned int WIDTH>
 bool DynamicNodeOperationsUtil<DIM, WIDTH>::tryWriteLockWithoutRead(Node<DIM>* node) {
 	const int result = pthread_rwlock_trywrlock(&(node->rwLock));
+	if (result == 0) {
+		beginWrite(node);
+	}
+
 	return result == 0;
 }
 
@@ -720,7 +768,7 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::parallelInsert(const Entry<DIM, WIDT
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-void DynamicNodeOperationsUtil<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& entry,
+bool DynamicNodeOperationsUtil<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& entry,
 		PHTree<DIM, WIDTH>& tree) {
 
 	size_t lastHcAddress = 0;
@@ -771,6 +819,13 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& entr
 				break;
 			}
 		} else if (content.exists && !content.hasSubnode) {
+			const size_t suffixBits = DIM * (WIDTH - currentIndex - 1);
+			if (suffixBits == 0 || MultiDimBitset<DIM>::compare(entry.values_, DIM * WIDTH,
+					currentIndex + 1, WIDTH, content.getSuffixStartBlock(), suffixBits).first) {
+				// the entry is already stored
+				return false;
+			}
+
 			// node entry and suffix exist:
 			// convert suffix to new node with prefix (longest common) + insert
 			createSubnodeWithExistingSuffix(currentIndex, currentNode, content, entry, tree);
@@ -813,6 +868,182 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& entr
 		//const size_t blocksPerSuffix = 1 + (remainingSuffixBits - 1) / (8 * sizeof (unsigned long));
 		//size_t suffixesInNode =
 	#endif
+
+	return true;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool DynamicNodeOperationsUtil<DIM, WIDTH>::erase(const Entry<DIM, WIDTH>& entry,
+		PHTree<DIM, WIDTH>& tree) {
+
+	unsigned long lastHcAddress = 0;
+	size_t index = 0;
+	Node<DIM>* lastNode = NULL;
+	Node<DIM>* currentNode = tree.root_;
+	NodeAddressContent<DIM> content;
+
+	while (true) {
+		const size_t prefixLength = currentNode->getPrefixLength();
+		if (prefixLength > 0) {
+			// validate prefix
+			const pair<bool, size_t> prefixComp = MultiDimBitset<DIM>::compare(entry.values_, DIM * WIDTH,
+					index, index + prefixLength,
+					currentNode->getFixPrefixStartBlock(), prefixLength * DIM);
+			if (!prefixComp.first) {
+				return false;
+			}
+		}
+
+		const size_t currentIndex = index + prefixLength;
+		const unsigned long hcAddress =
+				MultiDimBitset<DIM>::interleaveBits(entry.values_, currentIndex, WIDTH * DIM);
+		currentNode->lookup(hcAddress, content, true);
+		assert(!content.exists || content.address == hcAddress);
+		assert(!content.exists || !content.hasSpecialPointer);
+
+		if (!content.exists) {
+			return false;
+		}
+
+		if (content.hasSubnode) {
+			#ifdef PRINT
+				cout << "recurse -> ";
+			#endif
+			lastHcAddress = hcAddress;
+			lastNode = currentNode;
+			currentNode = content.subnode;
+			index = currentIndex + 1;
+			continue;
+		}
+
+		// validate suffix
+		const size_t suffixBits = DIM * (WIDTH - currentIndex - 1);
+		if (suffixBits > 0) {
+			const pair<bool, size_t> suffixComp = MultiDimBitset<DIM>::compare(entry.values_, DIM * WIDTH,
+					currentIndex + 1, WIDTH, content.getSuffixStartBlock(), suffixBits);
+			if (!suffixComp.first) {
+				return false;
+			}
+		}
+
+		removeSuffix(currentIndex, currentNode, content);
+
+		if (lastNode && currentNode->getNumberOfContents() == 1) {
+			// a subnode with a single entry is not needed anymore:
+			// move the remaining entry into the parent
+			mergeIntoParent(currentIndex, currentNode, lastNode, lastHcAddress);
+			++nEraseMergeIntoParent;
+		} else {
+			Node<DIM>* adjustedNode = currentNode->adjustSize();
+			assert (adjustedNode);
+			if (adjustedNode != currentNode) {
+				// the node was downsized: store the new one and delete the old
+				// (the suffix storage is shared between both nodes)
+				if (lastNode) {
+					lastNode->insertAtAddress(lastHcAddress, adjustedNode);
+				} else {
+					tree.root_ = adjustedNode;
+				}
+
+				delete currentNode;
+				++nEraseShrinkNode;
+			}
+		}
+
+		#ifdef PRINT
+			cout << "erased" << endl;
+		#endif
+
+		assert (!tree.lookup(entry).first
+				&& "after removal the entry is not contained in the tree anymore");
+		return true;
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void DynamicNodeOperationsUtil<DIM, WIDTH>::removeSuffix(size_t currentIndex,
+		Node<DIM>* currentNode, const NodeAddressContent<DIM>& content) {
+
+	assert (content.exists && !content.hasSubnode && !content.hasSpecialPointer);
+
+	currentNode->removeAtAddress(content.address);
+	if (!content.directlyStoredSuffix) {
+		// the address needs to be removed first so the freed suffix space can be reused
+		const size_t suffixBits = DIM * (WIDTH - currentIndex - 1);
+		unsigned long* suffixStartBlock = const_cast<unsigned long*>(content.suffixStartBlock);
+		currentNode->freeSuffixSpace(suffixBits, suffixStartBlock);
+		NodeTypeUtil<DIM>::template shrinkSuffixStorageIfPossible<WIDTH>(currentNode);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void DynamicNodeOperationsUtil<DIM, WIDTH>::mergeIntoParent(size_t currentIndex,
+		Node<DIM>* currentNode, Node<DIM>* parentNode, unsigned long parentHcAddress) {
+
+	assert (currentNode->getNumberOfContents() == 1);
+	NodeIterator<DIM>* it = currentNode->begin();
+	const NodeAddressContent<DIM> remaining = *(*it);
+	delete it;
+	assert (remaining.exists && !remaining.hasSpecialPointer);
+
+	// the remaining entry is moved one level up: [ prefix | address | remaining bits ]
+	const size_t prefixLength = currentNode->getPrefixLength();
+	unsigned long merged[1 + (DIM * WIDTH - 1) / (8 * sizeof (unsigned long))] = {};
+
+	if (remaining.hasSubnode) {
+		// the subnode receives the merged prefix
+		Node<DIM>* subnode = remaining.subnode;
+		const size_t subnodePrefixLength = subnode->getPrefixLength();
+		const size_t mergedPrefixLength = prefixLength + 1 + subnodePrefixLength;
+		pushBackLevels(currentNode->getFixPrefixStartBlock(), prefixLength,
+				merged, DIM * (1 + subnodePrefixLength));
+		MultiDimBitset<DIM>::pushBackValue(remaining.address, merged, DIM * subnodePrefixLength);
+		pushBackLevels(subnode->getFixPrefixStartBlock(), subnodePrefixLength, merged, 0);
+
+		Node<DIM>* subnodeCopy = NodeTypeUtil<DIM>::copyWithoutPrefix(DIM * mergedPrefixLength, subnode);
+		MultiDimBitset<DIM>::duplicateLowestBitsAligned(merged, DIM * mergedPrefixLength,
+				subnodeCopy->getPrefixStartBlock());
+		parentNode->insertAtAddress(parentHcAddress, subnodeCopy);
+		delete subnode;
+	} else {
+		// the parent receives a suffix that is longer by the prefix and the address
+		const size_t suffixLength = WIDTH - currentIndex - 1;
+		const size_t mergedSuffixBits = DIM * (prefixLength + 1 + suffixLength);
+		pushBackLevels(currentNode->getFixPrefixStartBlock(), prefixLength,
+				merged, DIM * (1 + suffixLength));
+		MultiDimBitset<DIM>::pushBackValue(remaining.address, merged, DIM * suffixLength);
+		pushBackLevels(remaining.getSuffixStartBlock(), suffixLength, merged, 0);
+
+		if (parentNode->canStoreSuffixInternally(mergedSuffixBits)) {
+			parentNode->insertAtAddress(parentHcAddress, merged[0], remaining.id);
+		} else {
+			const unsigned int totalSuffixBlocks = parentNode->canStoreSuffix(mergedSuffixBits);
+			if (totalSuffixBlocks != 0) {
+				NodeTypeUtil<DIM>::template enlargeSuffixStorage<WIDTH>(totalSuffixBlocks, parentNode);
+			}
+
+			pair<unsigned long*, unsigned int> suffixStartBlock = parentNode->reserveSuffixSpace(mergedSuffixBits);
+			MultiDimBitset<DIM>::duplicateLowestBitsAligned(merged, mergedSuffixBits, suffixStartBlock.first);
+			parentNode->insertAtAddress(parentHcAddress, suffixStartBlock.second, remaining.id);
+		}
+	}
+
+	if (currentNode->getSuffixStorage()) {
+		delete currentNode->getSuffixStorage();
+	}
+
+	delete currentNode;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void DynamicNodeOperationsUtil<DIM, WIDTH>::pushBackLevels(const unsigned long* fromStartBlock,
+		size_t nLevels, unsigned long* toStartBlock, size_t toNBits) {
+
+	// copies level by level as the bitsets are not necessarily aligned
+	for (size_t level = 0; level < nLevels; ++level) {
+		const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(fromStartBlock, level, DIM * nLevels);
+		MultiDimBitset<DIM>::pushBackValue(hcAddress, toStartBlock, toNBits + DIM * (nLevels - level - 1));
+	}
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -822,7 +1053,7 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::bulkInsert(
 
 	Node<DIM>* currentRoot = tree.root_;
 	NodeAddressContent<DIM> content;
-	EntryBufferPool<DIM, WIDTH>* pool = new EntryBufferPool<DIM,WIDTH>();
+	EntryBufferPool<DIM, WIDTH>* pool = new EntryBufferPool<DIM,WIDTH>(EntryBufferPool<DIM,WIDTH>::boundedCapacity_);
 
 	for (const auto &entry : entries) {
 		size_t lastHcAddress = 0;
@@ -930,8 +1161,7 @@ void DynamicNodeOperationsUtil<DIM, WIDTH>::bulkInsert(
 template<unsigned int DIM, unsigned int WIDTH>
 bool DynamicNodeOperationsUtil<DIM, WIDTH>::parallelBulkInsert(
 		const Entry<DIM, WIDTH>& entry, PHTree<DIM, WIDTH>& tree,
-		EntryBufferPool<DIM, WIDTH>& pool, DeletedNodes<DIM>& deletedNodes,
-		EntryTreeMap<DIM,WIDTH>& entryTreeMap) {
+		EntryBufferPool<DIM, WIDTH>& pool, EntryTreeMap<DIM,WIDTH>& entryTreeMap) {
 
 #ifdef PRINT
 		cout << entry.id_ << ": " << flush;
@@ -1006,7 +1236,7 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::parallelBulkInsert(
 					// create new node with prefix A and only leave prefix B in old subnode
 					if (writeLockBlocking(currentNode, lastNode)) {
 						splitSubnodePrefix(currentIndex, differentBitAtPrefixIndex, subnodePrefixLength, lastNode, content, entry, tree);
-						deletedNodes.add(currentNode);
+						EpochReclamation<DIM>::retire(currentNode);
 						writeUnlock(currentNode, lastNode);
 						break;
 					} else {
@@ -1026,12 +1256,13 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::parallelBulkInsert(
 			EntryBuffer<DIM, WIDTH>* buffer = reinterpret_cast<EntryBuffer<DIM,WIDTH>*>(content.specialPointer);
 			if (buffer->full()) {
 				if (writeLockBlocking(currentNode)) {
-					if (buffer->full()) {
-						assert (buffer->full());
+					const bool flush = buffer->full();
+					if (flush) {
 						// cleaning the old buffer and restart
 						flushSubtree(buffer, true);
+						++nFlushCountParallel;
 					}
-					restart = !downgradeWriterToReader(currentNode);
+					restart = !downgradeWriterToReader(currentNode, flush);
 					// continue with the current node
 				} else {
 					restart = true;
@@ -1084,7 +1315,7 @@ bool DynamicNodeOperationsUtil<DIM, WIDTH>::parallelBulkInsert(
 				Node<DIM>* adjustedNode = insertSuffix(currentIndex, hcAddress, currentNode, entry, tree);
 				assert(adjustedNode && (adjustedNode != currentNode));
 				lastNode->insertAtAddress(lastHcAddress, adjustedNode);
-				deletedNodes.add(currentNode);
+				EpochReclamation<DIM>::retire(currentNode);
 				writeUnlock(currentNode, lastNode);
 				break;
 			} else {
@@ -30,6 +30,10 @@ public:
 	std::pair<Node<DIM>*, unsigned long> getNodeAndAddress();
 	Node<DIM>* flushToSubtree(); // TODO should be made const
 	EntryBufferPool<DIM, WIDTH>* getPool();
+	// calls callback(suffixStartBlock, id) for every entry whose insertion completed (optimistic readers
+	// need to validate the version of the buffer's node afterwards as the buffer could have been flushed)
+	template <typename CALLBACK>
+	void forEachCompletedEntry(CALLBACK& callback) const;
 
 	bool assertCleared() const;
 
@@ -42,6 +46,8 @@ private:
 	bool inUse;
 	size_t suffixBits_;
 	EntryBufferPool<DIM, WIDTH>* pool_;
+	// next free buffer of the pool
+	EntryBuffer<DIM, WIDTH>* nextFree_;
 	// - symmetric matrix: need to store n/2 (n+1) fields only
 	// - stores the diagonal too for easier access
 	// - stores the lower matrix because LCP values of one row are stored together
@@ -65,7 +71,7 @@ private:
 #include "util/EntryBufferPool.h"
 
 template <unsigned int DIM, unsigned int WIDTH>
-EntryBuffer<DIM, WIDTH>::EntryBuffer() : flushing_(false), nextIndex_(0), inUse(false), suffixBits_(0), pool_(NULL), lcps_(), buffer_(), insertCompleted_() {
+EntryBuffer<DIM, WIDTH>::EntryBuffer() : flushing_(false), nextIndex_(0), inUse(false), suffixBits_(0), pool_(NULL), nextFree_(NULL), lcps_(), buffer_(), insertCompleted_() {
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -157,6 +163,18 @@ void EntryBuffer<DIM, WIDTH>::setPool(EntryBufferPool<DIM,WIDTH>* pool) {
 	pool_ = pool;
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void EntryBuffer<DIM, WIDTH>::forEachCompletedEntry(CALLBACK& callback) const {
+	const size_t capacity = capacity_;
+	const size_t n = min(size_t(nextIndex_), capacity);
+	for (unsigned i = 0; i < n; ++i) {
+		if (__atomic_load_n(&insertCompleted_[i], __ATOMIC_ACQUIRE)) {
+			callback(buffer_[i].values_, buffer_[i].id_);
+		}
+	}
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 size_t EntryBuffer<DIM, WIDTH>::capacity() const {
 	return capacity_;
@@ -184,9 +202,10 @@ bool EntryBuffer<DIM, WIDTH>::insert(const Entry<DIM, WIDTH>& entry) {
 	assert (!insertCompleted_[i]);
 	// copy ID and necessary bits into the local buffer
 	MultiDimBitset<DIM>::duplicateLowestBitsAligned(entry.values_, suffixBits_, buffer_[i].values_);
-	insertCompleted_[i] = true; // TODO place after duplication?
 	buffer_[i].id_ = entry.id_;
 	originals_[i] = &entry;
+	// publishes the entry to other inserting threads and optimistic readers
+	__atomic_store_n(&insertCompleted_[i], true, __ATOMIC_RELEASE);
 
 	// compare the new entry to all previously inserted entries
 	const unsigned int startIndexDim = WIDTH - (suffixBits_ / DIM);
@@ -1,18 +1,23 @@
 #ifndef SRC_UTIL_ENTRYBUFFERPOOL_H_
 #define SRC_UTIL_ENTRYBUFFERPOOL_H_
 
-#include <mutex>
+#include <atomic>
+#include <vector>
 
 template <unsigned int DIM, unsigned int WIDTH>
 class EntryBuffer;
 
+// Buffers are created on demand in chunks of growing size and belong to the thread owning
+// the pool. Buffers flushed by other threads are handed back without locking and are taken
+// over by the owner on its next allocation.
 template <unsigned int DIM, unsigned int WIDTH>
 class EntryBufferPool {
 public:
-	EntryBufferPool();
-	~EntryBufferPool() {};
+	// a pool without a maximum capacity grows as long as buffers are needed
+	explicit EntryBufferPool(size_t maxCapacity = 0);
+	~EntryBufferPool();
 
-	// allocate must only be called by one thread at a time
+	// allocate must only be called by the owning thread (NULL if the maximum capacity is reached)
 	EntryBuffer<DIM, WIDTH>* allocate();
 	// deallocate can be called by any number of threads at a time
 	void deallocate(EntryBuffer<DIM, WIDTH>* buffer);
@@ -25,14 +30,25 @@ public:
 	void doFullDeallocatePart(size_t part, size_t total);
 	void finishFullDeallocate();
 
-	static const size_t capacity_ = 10000;
-private:
-	size_t headIndex_;
-	size_t nInitialized_;
-	size_t nFree_;
-	mutex singleOperationMutex_;
-	EntryBuffer<DIM, WIDTH> pool_[capacity_];
+	// number of buffers created so far
+	size_t getNBuffers() const;
 
+	// maximum capacity of the pool used by the sequential bulk insertion
+	static const size_t boundedCapacity_ = 10000;
+private:
+	static const size_t INITIAL_CHUNK_BUFFERS = 16;
+	static const size_t MAX_CHUNK_BUFFERS = 1024;
+
+	const size_t maxCapacity_;
+	size_t nBuffers_;
+	// <first buffer, number of buffers> of all chunks (buffers never move)
+	std::vector<std::pair<EntryBuffer<DIM, WIDTH>*, size_t>> chunks_;
+	// free buffers that can only be used by the owning thread
+	EntryBuffer<DIM, WIDTH>* freeList_;
+	// stack of deallocated buffers which the owner takes over as a whole
+	std::atomic<EntryBuffer<DIM, WIDTH>*> returned_;
+
+	void grow();
 	bool assertClearedFreeList();
 };
 
@@ -42,27 +58,28 @@ private:
 #include "util/DynamicNodeOperationsUtil.h"
 
 template <unsigned int DIM, unsigned int WIDTH>
-EntryBufferPool<DIM, WIDTH>::EntryBufferPool() :
-	headIndex_(0), nInitialized_(0), nFree_(capacity_),
-	singleOperationMutex_(), pool_() {
-#ifndef NDEBUG
-	// Validate that all buffers are cleared
-	for (unsigned i = 0; i < capacity_; ++i) {
-		pool_[i].assertCleared();
+EntryBufferPool<DIM, WIDTH>::EntryBufferPool(size_t maxCapacity) :
+	maxCapacity_(maxCapacity), nBuffers_(0), chunks_(), freeList_(NULL), returned_(NULL) {
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+EntryBufferPool<DIM, WIDTH>::~EntryBufferPool() {
+	for (auto chunk : chunks_) {
+		delete[] chunk.first;
 	}
-#endif
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+size_t EntryBufferPool<DIM, WIDTH>::getNBuffers() const {
+	return nBuffers_;
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
 bool EntryBufferPool<DIM, WIDTH>::assertClearedFreeList() {
 	// Validate that free list is cleared
-	size_t currentIndex = headIndex_;
-	while (currentIndex != (-1u) && currentIndex < nInitialized_) {
-		const size_t nextIndex = pool_[currentIndex].nextIndex_;
-		pool_[currentIndex].nextIndex_ = 0;
-		pool_[currentIndex].assertCleared();
-		pool_[currentIndex].nextIndex_ = nextIndex;
-		currentIndex = nextIndex;
+	for (EntryBuffer<DIM, WIDTH>* buffer = freeList_; buffer; buffer = buffer->nextFree_) {
+		assert (!buffer->inUse);
+		buffer->assertCleared();
 	}
 	return true;
 }
@@ -83,95 +100,99 @@ template <unsigned int DIM, unsigned int WIDTH>
 void EntryBufferPool<DIM, WIDTH>::doFullDeallocatePart(size_t part, size_t total) {
 	assert (part < total);
 
-	const size_t chunkSize = 1 + nInitialized_ / total;
+	const size_t chunkSize = 1 + nBuffers_ / total;
 	const size_t start = chunkSize * part;
-	const size_t end = min(nInitialized_, chunkSize * (1 + part));
-
-	// go through the pool backwards and deallocate all buffers where the
-	// assigned node can be locked
-	for (unsigned i = start; i < end; ++i) {
-		if (pool_[i].inUse) {
-			DynamicNodeOperationsUtil<DIM, WIDTH>::flushSubtree(&(pool_[i]), false);
-			assert (pool_[i].assertCleared());
-			pool_[i].inUse = false;
-		} else {
-			pool_[i].nextIndex_ = 0; // TODO only needed for consistency in assertCleared()
-			assert (pool_[i].assertCleared());
+	const size_t end = min(nBuffers_, chunkSize * (1 + part));
+
+	// flush all buffers of the part that are still in use
+	size_t chunkStart = 0;
+	for (auto chunk : chunks_) {
+		const size_t from = max(start, chunkStart);
+		const size_t to = min(end, chunkStart + chunk.second);
+		for (size_t i = from; i < to; ++i) {
+			EntryBuffer<DIM, WIDTH>* buffer = chunk.first + (i - chunkStart);
+			if (buffer->inUse) {
+				DynamicNodeOperationsUtil<DIM, WIDTH>::flushSubtree(buffer, false);
+				buffer->inUse = false;
+			}
+
+			assert (buffer->assertCleared());
 		}
+
+		chunkStart += chunk.second;
 	}
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
 void EntryBufferPool<DIM, WIDTH>::finishFullDeallocate() {
-#ifndef NDEBUG
-	// Validate that all buffers are now empty
-	for (unsigned i = 0; i < nInitialized_; ++i) {
-		pool_[i].assertCleared();
+	// all buffers are free again
+	freeList_ = NULL;
+	returned_ = NULL;
+	for (auto chunk : chunks_) {
+		for (size_t i = 0; i < chunk.second; ++i) {
+			assert (!chunk.first[i].inUse && chunk.first[i].assertCleared());
+			chunk.first[i].nextFree_ = freeList_;
+			freeList_ = chunk.first + i;
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void EntryBufferPool<DIM, WIDTH>::grow() {
+	const size_t initialChunkBuffers = INITIAL_CHUNK_BUFFERS;
+	const size_t maxChunkBuffers = MAX_CHUNK_BUFFERS;
+	size_t nNew = min(maxChunkBuffers, max(initialChunkBuffers, nBuffers_));
+	if (maxCapacity_ > 0) {
+		nNew = min(nNew, maxCapacity_ - nBuffers_);
+		if (nNew == 0) {
+			return;
+		}
 	}
-#endif
 
-	nFree_ = capacity_;
-	headIndex_ = 0;
-	nInitialized_ = 0;
+	EntryBuffer<DIM, WIDTH>* chunk = new EntryBuffer<DIM, WIDTH>[nNew];
+	chunks_.emplace_back(chunk, nNew);
+	nBuffers_ += nNew;
+	for (size_t i = nNew; i > 0; --i) {
+		chunk[i - 1].setPool(this);
+		chunk[i - 1].nextFree_ = freeList_;
+		freeList_ = chunk + (i - 1);
+	}
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
 EntryBuffer<DIM, WIDTH>* EntryBufferPool<DIM, WIDTH>::allocate() {
-	unique_lock<mutex> lk(singleOperationMutex_);
-//	assert (assertClearedFreeList());
-
-	// no need to sync the following because only one thread can allocate!
-	if (nInitialized_ < capacity_) {
-		// not all fields were initialized so add the next entry to the free list
-		assert (pool_[nInitialized_].assertCleared());
-		pool_[nInitialized_].nextIndex_ = nInitialized_ + 1;
-		pool_[nInitialized_].setPool(this);
-		++nInitialized_;
+	if (!freeList_) {
+		// take over all buffers that were deallocated in the mean time
+		freeList_ = returned_.exchange(NULL, memory_order_acquire);
 	}
 
-	EntryBuffer<DIM,WIDTH>* alloc = NULL;
-	if (nFree_ > 0) {
-		--nFree_;
-		alloc = &pool_[headIndex_];
-		if (nFree_ > 0) {
-			headIndex_ = pool_[headIndex_].nextIndex_;
-		} else {
-			headIndex_ = -1u;
+	if (!freeList_) {
+		grow();
+		if (!freeList_) {
+			return NULL;
 		}
-
-		alloc->nextIndex_ = 0;
-		assert (alloc->assertCleared());
-		assert (!alloc->inUse);
-		alloc->inUse = true;
 	}
 
+	EntryBuffer<DIM,WIDTH>* alloc = freeList_;
+	freeList_ = alloc->nextFree_;
+	alloc->nextFree_ = NULL;
+	assert (alloc->assertCleared());
+	assert (!alloc->inUse);
+	alloc->inUse = true;
 	return alloc;
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
 void EntryBufferPool<DIM, WIDTH>::deallocate(EntryBuffer<DIM, WIDTH>* buffer) {
-
-	const size_t diff = (size_t)buffer - (size_t)pool_;
-	const size_t slotSize = sizeof (EntryBuffer<DIM, WIDTH>);
-	assert (diff % slotSize == 0);
-	const size_t index = diff / slotSize;
-	assert ((size_t)buffer >= (size_t)pool_ && index < capacity_);
+	assert (buffer->getPool() == this);
 	assert (buffer->assertCleared());
-
-	unique_lock<mutex> lk(singleOperationMutex_);
-//	assert (assertClearedFreeList());
 	assert (buffer->inUse);
 	buffer->inUse = false;
 
-	if (headIndex_ != (-1u)) {
-		buffer->nextIndex_ = headIndex_;
-	} else {
-		buffer->nextIndex_ = -1u;
-	}
-
-	headIndex_ = index;
-	++nFree_;
+	EntryBuffer<DIM, WIDTH>* head = returned_.load(memory_order_relaxed);
+	do {
+		buffer->nextFree_ = head;
+	} while (!returned_.compare_exchange_weak(head, buffer, memory_order_release, memory_order_relaxed));
 }
 
 #endif /* SRC_UTIL_ENTRYBUFFERPOOL_H_ */
-
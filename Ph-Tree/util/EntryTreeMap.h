@@ -19,7 +19,7 @@ public:
 	bool compareForStart(const Entry<DIM, WIDTH>& entry);
 	void put(size_t startIndex, Node<DIM>* containedInNode);
 
-	const Entry<DIM, WIDTH>* createEntry(const std::vector<unsigned long> &values, int id);
+	const Entry<DIM, WIDTH>* createEntry(const unsigned long* values, int id);
 
 private:
 
@@ -50,7 +50,7 @@ EntryTreeMap<DIM, WIDTH>::~EntryTreeMap() {
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
-const Entry<DIM, WIDTH>* EntryTreeMap<DIM, WIDTH>::createEntry(const std::vector<unsigned long> &values, int id) {
+const Entry<DIM, WIDTH>* EntryTreeMap<DIM, WIDTH>::createEntry(const unsigned long* values, int id) {
 	currentEntryIsFirst_ = !currentEntryIsFirst_;
 	if (currentEntryIsFirst_) {
 		entry1_.reinit(values, id);
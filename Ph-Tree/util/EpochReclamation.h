@@ -0,0 +1,356 @@
+#ifndef SRC_UTIL_EPOCHRECLAMATION_H_
+#define SRC_UTIL_EPOCHRECLAMATION_H_
+
+#include <atomic>
+#include <vector>
+
+template <unsigned int DIM>
+class Node;
+class TSuffixStorage;
+
+// Epoch based reclamation of the nodes and suffix storages that are replaced during a parallel
+// insertion. Threads register with a Scope and mark their accesses to the tree with a Guard.
+// A retired object is tagged with the global epoch and deleted by the retiring thread once the
+// global epoch advanced twice, as every thread that could still reference it left its guard in
+// the mean time. The epoch only advances if all guarded threads saw the current one, but no
+// thread ever waits for another one and there is no limit on the number of retired objects.
+// Optimistic readers additionally use a ReadGuard which can be excluded while a flush phase
+// changes nodes without locking them.
+template <unsigned int DIM>
+class EpochReclamation {
+private:
+	struct Participant;
+
+public:
+	EpochReclamation();
+	~EpochReclamation();
+
+	// registers the calling thread while the scope exists
+	class Scope {
+	public:
+		explicit Scope(EpochReclamation<DIM>& reclamation);
+		~Scope();
+
+	private:
+		Participant* previous_;
+	};
+
+	// the registered calling thread accesses the tree while the guard exists (guards can be nested)
+	class Guard {
+	public:
+		Guard();
+		~Guard();
+	};
+
+	// registers and guards an optimistic reader while readers are not excluded
+	class ReadGuard {
+	public:
+		explicit ReadGuard(EpochReclamation<DIM>& reclamation);
+		~ReadGuard();
+
+	private:
+		EpochReclamation<DIM>& reclamation_;
+		Participant* previous_;
+	};
+
+	// retires the object if the calling thread is registered, otherwise deletes it right away
+	static void retire(Node<DIM>* node);
+	static void retire(const TSuffixStorage* storage);
+	// briefly leaves the guard of the calling thread so the epoch can advance and older objects
+	// can be deleted (the thread must not keep any references to nodes across this call)
+	static void quiesce();
+
+	// waits until no reader is active and lets new readers wait until readmitReaders()
+	void excludeReaders();
+	void readmitReaders();
+
+	unsigned long getEpoch() const;
+	// number of retired objects that were deleted so far
+	unsigned long getNReclaimed() const;
+
+private:
+	// objects retired in epoch e are kept in the slot e % N_SLOTS
+	static const unsigned int N_SLOTS = 3;
+
+	struct Participant {
+		EpochReclamation<DIM>* owner;
+		Participant* next;
+		std::atomic<bool> inUse;
+		std::atomic<bool> active;
+		std::atomic<unsigned long> epoch;
+		unsigned int nGuards;
+		unsigned long slotEpochs[N_SLOTS];
+		std::vector<Node<DIM>*> retiredNodes[N_SLOTS];
+		std::vector<const TSuffixStorage*> retiredStorages[N_SLOTS];
+	};
+
+	static thread_local Participant* current_;
+
+	std::atomic<unsigned long> epoch_;
+	std::atomic<unsigned long> nReclaimed_;
+	// all participants ever created, unused ones are taken over by the next registering thread
+	std::atomic<Participant*> participants_;
+	// new readers wait while readers are excluded so the excluding thread cannot starve
+	std::atomic<bool> readersExcluded_;
+	std::atomic<size_t> nActiveReaders_;
+
+	Participant* join();
+	static void leave(Participant* participant);
+	static void enter(Participant* participant);
+	static void exit(Participant* participant);
+	// advances the global epoch if every guarded participant is in the current one
+	void tryAdvance();
+	// deletes the objects of all slots that were retired at least two epochs ago
+	void reclaim(Participant* participant, bool all);
+	// returns the slot for objects retired now (deletes its old objects first)
+	unsigned int retireSlot(Participant* participant);
+	void deleteSlot(Participant* participant, unsigned int slot);
+};
+
+#include <assert.h>
+#include <thread>
+#include "nodes/Node.h"
+#include "nodes/TSuffixStorage.h"
+
+template <unsigned int DIM>
+thread_local typename EpochReclamation<DIM>::Participant* EpochReclamation<DIM>::current_ = NULL;
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::EpochReclamation() : epoch_(0), nReclaimed_(0), participants_(NULL),
+		readersExcluded_(false), nActiveReaders_(0) {
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::~EpochReclamation() {
+	Participant* participant = participants_;
+	while (participant) {
+		assert (!participant->inUse && !participant->active);
+		reclaim(participant, true);
+		Participant* next = participant->next;
+		delete participant;
+		participant = next;
+	}
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::Scope::Scope(EpochReclamation<DIM>& reclamation) : previous_(current_) {
+	current_ = reclamation.join();
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::Scope::~Scope() {
+	leave(current_);
+	current_ = previous_;
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::Guard::Guard() {
+	assert (current_);
+	enter(current_);
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::Guard::~Guard() {
+	exit(current_);
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::ReadGuard::ReadGuard(EpochReclamation<DIM>& reclamation)
+		: reclamation_(reclamation), previous_(current_) {
+	while (true) {
+		while (reclamation_.readersExcluded_) {
+			std::this_thread::yield();
+		}
+
+		++reclamation_.nActiveReaders_;
+		if (!reclamation_.readersExcluded_) {
+			break;
+		}
+
+		// readers were excluded in the mean time so wait until they are readmitted
+		--reclamation_.nActiveReaders_;
+	}
+
+	current_ = reclamation_.join();
+	enter(current_);
+}
+
+template <unsigned int DIM>
+EpochReclamation<DIM>::ReadGuard::~ReadGuard() {
+	exit(current_);
+	leave(current_);
+	current_ = previous_;
+	--reclamation_.nActiveReaders_;
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::retire(Node<DIM>* node) {
+	assert (node && !node->removed);
+	node->removed = true;
+	Participant* participant = current_;
+	if (!participant) {
+		delete node;
+		return;
+	}
+
+	assert (participant->nGuards > 0);
+	const unsigned int slot = participant->owner->retireSlot(participant);
+	participant->retiredNodes[slot].push_back(node);
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::retire(const TSuffixStorage* storage) {
+	assert (storage);
+	Participant* participant = current_;
+	if (!participant) {
+		delete storage;
+		return;
+	}
+
+	assert (participant->nGuards > 0);
+	const unsigned int slot = participant->owner->retireSlot(participant);
+	participant->retiredStorages[slot].push_back(storage);
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::quiesce() {
+	Participant* participant = current_;
+	assert (participant && participant->nGuards == 1);
+	exit(participant);
+	enter(participant);
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::excludeReaders() {
+	assert (!readersExcluded_);
+	readersExcluded_ = true;
+	while (nActiveReaders_ > 0) {
+		std::this_thread::yield();
+	}
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::readmitReaders() {
+	assert (readersExcluded_);
+	readersExcluded_ = false;
+}
+
+template <unsigned int DIM>
+unsigned long EpochReclamation<DIM>::getEpoch() const {
+	return epoch_;
+}
+
+template <unsigned int DIM>
+unsigned long EpochReclamation<DIM>::getNReclaimed() const {
+	return nReclaimed_;
+}
+
+template <unsigned int DIM>
+typename EpochReclamation<DIM>::Participant* EpochReclamation<DIM>::join() {
+	for (Participant* participant = participants_; participant; participant = participant->next) {
+		bool unused = false;
+		if (!participant->inUse && participant->inUse.compare_exchange_strong(unused, true)) {
+			return participant;
+		}
+	}
+
+	Participant* participant = new Participant();
+	participant->owner = this;
+	participant->inUse = true;
+	participant->active = false;
+	participant->epoch = 0;
+	participant->nGuards = 0;
+	for (unsigned int slot = 0; slot < N_SLOTS; ++slot) {
+		participant->slotEpochs[slot] = 0;
+	}
+
+	participant->next = participants_;
+	while (!participants_.compare_exchange_weak(participant->next, participant)) {}
+	return participant;
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::leave(Participant* participant) {
+	assert (participant && participant->nGuards == 0);
+	// the retired objects stay with the participant until it is used again
+	participant->inUse = false;
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::enter(Participant* participant) {
+	if (participant->nGuards++ > 0) {
+		return;
+	}
+
+	EpochReclamation<DIM>* owner = participant->owner;
+	participant->active = true;
+	// the participant needs to be visible as active before it reads any node
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	participant->epoch = owner->epoch_.load();
+
+	owner->tryAdvance();
+	owner->reclaim(participant, false);
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::exit(Participant* participant) {
+	assert (participant->nGuards > 0);
+	if (--participant->nGuards == 0) {
+		participant->active.store(false, std::memory_order_release);
+	}
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::tryAdvance() {
+	unsigned long epoch = epoch_.load();
+	for (Participant* participant = participants_; participant; participant = participant->next) {
+		if (participant->active && participant->epoch != epoch) {
+			return;
+		}
+	}
+
+	epoch_.compare_exchange_strong(epoch, epoch + 1);
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::reclaim(Participant* participant, bool all) {
+	const unsigned long epoch = epoch_.load();
+	for (unsigned int slot = 0; slot < N_SLOTS; ++slot) {
+		if (all || participant->slotEpochs[slot] + 2 <= epoch) {
+			deleteSlot(participant, slot);
+		}
+	}
+}
+
+template <unsigned int DIM>
+unsigned int EpochReclamation<DIM>::retireSlot(Participant* participant) {
+	// the epoch is read after the object was unlinked so only threads in this or an earlier epoch can see it
+	const unsigned long epoch = epoch_.load();
+	const unsigned int slot = epoch % N_SLOTS;
+	if (participant->slotEpochs[slot] != epoch) {
+		// the slot still holds objects from at least three epochs ago
+		assert (participant->slotEpochs[slot] + N_SLOTS <= epoch
+				|| (participant->retiredNodes[slot].empty() && participant->retiredStorages[slot].empty()));
+		deleteSlot(participant, slot);
+		participant->slotEpochs[slot] = epoch;
+	}
+
+	return slot;
+}
+
+template <unsigned int DIM>
+void EpochReclamation<DIM>::deleteSlot(Participant* participant, unsigned int slot) {
+	nReclaimed_ += participant->retiredNodes[slot].size() + participant->retiredStorages[slot].size();
+	for (Node<DIM>* node : participant->retiredNodes[slot]) {
+		delete node;
+	}
+
+	for (const TSuffixStorage* storage : participant->retiredStorages[slot]) {
+		delete storage;
+	}
+
+	participant->retiredNodes[slot].clear();
+	participant->retiredStorages[slot].clear();
+}
+
+#endif /* SRC_UTIL_EPOCHRECLAMATION_H_ */
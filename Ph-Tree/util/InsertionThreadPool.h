@@ -10,8 +10,9 @@
 #include <atomic>
 #include <boost/thread/barrier.hpp>
 #include <boost/thread/shared_mutex.hpp>
-#include "util/DeletedNodes.h"
 #include "util/EntryTreeMap.h"
+#include "util/EpochReclamation.h"
+#include "util/PointSpan.h"
 
 template <unsigned int DIM, unsigned int WIDTH>
 class PHTree;
@@ -36,9 +37,9 @@ template <unsigned int DIM, unsigned int WIDTH>
 class InsertionThreadPool {
 public:
 
-	InsertionThreadPool(size_t furtherThreads,
-			const std::vector<std::vector<unsigned long>>& values,
-			const std::vector<int>* ids, PHTree<DIM, WIDTH>* tree);
+	// inserts the i-th point with ids[i] or with the ID i if there are no IDs
+	InsertionThreadPool(size_t furtherThreads, const PointSpan<DIM>& values,
+			const int* ids, PHTree<DIM, WIDTH>* tree);
 	~InsertionThreadPool();
 	void joinPool();
 
@@ -51,6 +52,8 @@ public:
 private:
 
 	static const size_t INITIAL_JITTER_NANOS_FACTOR = 500;
+	// entries after which a thread drops its cached nodes so retired nodes can be reclaimed
+	static const size_t QUIESCE_INTERVAL = 64;
 
 	bool syncPhaseRequired_;
 	std::atomic<unsigned int> i_;
@@ -59,13 +62,15 @@ private:
 	boost::shared_mutex createBarriersMutex_;
 	boost::barrier* poolFlushBarrier_;
 	std::vector<std::thread> threads_;
-	std::vector<DeletedNodes<DIM>> deletedNodes_;
 	std::vector<EntryTreeMap<DIM,WIDTH>> entryMaps_;
 	std::vector<std::vector<double>> nanosPerEntryPerThread_;
-	const std::vector<std::vector<unsigned long>>& values_;
-	const std::vector<int>* ids_;
+	const PointSpan<DIM> values_;
+	const int* ids_;
 	PHTree<DIM, WIDTH>* tree_;
-	EntryBufferPool<DIM, WIDTH>* pool_;
+	// every thread allocates buffers from its own pool
+	std::vector<EntryBufferPool<DIM, WIDTH>*> pools_;
+	// every thread allocates nodes from its own arena which is freed with the tree
+	std::vector<NodeArena*> arenas_;
 
 	void processNext(size_t threadIndex);
 	inline double insertBySelectedStrategy(size_t entryIndex, size_t threadIndex);
@@ -83,6 +88,7 @@ private:
 #include "util/DynamicNodeOperationsUtil.h"
 #include "util/NodeTypeUtil.h"
 #include "util/EntryBufferPool.h"
+#include "util/NodeArena.h"
 
 using namespace std;
 
@@ -95,22 +101,31 @@ unsigned long InsertionThreadPool<DIM, WIDTH>::nFlushPhases = 0;
 
 template <unsigned int DIM, unsigned int WIDTH>
 InsertionThreadPool<DIM, WIDTH>::InsertionThreadPool(size_t furtherThreads,
-		const vector<vector<unsigned long>>& values,
-		const vector<int>* ids, PHTree<DIM, WIDTH>* tree)
+		const PointSpan<DIM>& values, const int* ids, PHTree<DIM, WIDTH>* tree)
 		: syncPhaseRequired_(false), i_(0), nThreads_(furtherThreads + 1), createBarriersMutex_(),
-		  poolFlushBarrier_(NULL), nanosPerEntryPerThread_(furtherThreads + 1), deletedNodes_(furtherThreads + 1),
+		  poolFlushBarrier_(NULL), nanosPerEntryPerThread_(furtherThreads + 1),
 		  entryMaps_(furtherThreads + 1), values_(values),
-		  ids_(ids), tree_(tree), pool_(NULL) {
+		  ids_(ids), tree_(tree), pools_(), arenas_() {
 	assert (values.size() > 0);
+	tree->reclamation_.excludeReaders();
 	// create the biggest possible root node so there is no need to synchronize access on the root
 	Node<DIM>* oldRoot = tree->root_;
 	assert (oldRoot->getNumberOfContents() == 0);
 	Node<DIM>* newRoot = NodeTypeUtil<DIM>::copyIntoLargerNode(1uL << DIM, oldRoot);
-	tree->root_ = newRoot;
+	__atomic_store_n(&tree->root_, newRoot, __ATOMIC_RELEASE);
 	delete oldRoot;
+	tree->reclamation_.readmitReaders();
 
 	poolFlushBarrier_ = new boost::barrier(nThreads_);
-	pool_ = new EntryBufferPool<DIM,WIDTH>(); // TODO only create if needed
+	pools_.reserve(nThreads_);
+	for (unsigned tCount = 0; tCount < nThreads_; ++tCount) {
+		pools_.push_back(new EntryBufferPool<DIM,WIDTH>()); // TODO only create if needed
+	}
+
+	arenas_.reserve(nThreads_);
+	for (unsigned tCount = 0; tCount < nThreads_; ++tCount) {
+		arenas_.push_back(tree->arena_.createWorkerArena());
+	}
 
 	DynamicNodeOperationsUtil<DIM,WIDTH>::nThreads = nThreads_;
 	nRemainingThreads_ = nThreads_;
@@ -128,7 +143,7 @@ InsertionThreadPool<DIM, WIDTH>::~InsertionThreadPool() {
 
 	assert (nRemainingThreads_ == 0);
 	delete poolFlushBarrier_;
-	delete pool_;
+	tree_->reclamation_.excludeReaders();
 
 	// TODO remove:
 	/*string path = "./plot/data/timeseries-" + to_string(nThreads_) + ".dat";
@@ -148,8 +163,13 @@ InsertionThreadPool<DIM, WIDTH>::~InsertionThreadPool() {
 	assert (rootContents > 0);
 	Node<DIM>* oldRoot = tree_->root_;
 	Node<DIM>* newRoot = NodeTypeUtil<DIM>::copyIntoLargerNode(rootContents, oldRoot);
-	tree_->root_ = newRoot;
+	__atomic_store_n(&tree_->root_, newRoot, __ATOMIC_RELEASE);
 	delete oldRoot;
+
+	for (auto pool : pools_) {
+		delete pool;
+	}
+	tree_->reclamation_.readmitReaders();
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -163,15 +183,17 @@ void InsertionThreadPool<DIM, WIDTH>::handlePoolFlushSync(size_t threadIndex, bo
 	// gather all threads
 	const bool responsibleForState = poolFlushBarrier_->wait();
 	if (responsibleForState) {
-		pool_->prepareFullDeallocate();
+		// the flush changes nodes without locking them
+		tree_->reclamation_.excludeReaders();
 	}
 
-	// wait until the pool is prepared for the flush
+	// wait until readers are excluded
 	poolFlushBarrier_->wait();
 
-	pool_->doFullDeallocatePart(threadIndex, nThreads_);
-	deletedNodes_[threadIndex].deleteAll();
+	// no other thread changes the pool of this thread in the mean time
+	pools_[threadIndex]->fullDeallocate();
 	entryMaps_[threadIndex].clearMap();
+	EpochReclamation<DIM>::quiesce();
 
 	if (responsibleForState) {
 		++nFlushPhases;
@@ -180,14 +202,11 @@ void InsertionThreadPool<DIM, WIDTH>::handlePoolFlushSync(size_t threadIndex, bo
 
 	if (lastFlush) { --nRemainingThreads_; }
 
-	// wait until every thread finished flushing its part
+	// wait until every thread finished flushing its pool
 	poolFlushBarrier_->wait();
-	if (responsibleForState) { // TODO maybe possible to skip this step
-		pool_->finishFullDeallocate();
+	if (responsibleForState) {
+		tree_->reclamation_.readmitReaders();
 	}
-
-	// wait until the pool is ready to restart
-	poolFlushBarrier_->wait();
 }
 
 template <unsigned int DIM, unsigned int WIDTH>
@@ -213,20 +232,23 @@ double InsertionThreadPool<DIM, WIDTH>::insertBySelectedStrategy(size_t entryInd
 	struct timespec start, finish;
 	clock_gettime(CLOCK_MONOTONIC, &start);
 
-	const int id = (ids_)? (*ids_)[entryIndex] : entryIndex;
+	const int id = (ids_)? ids_[entryIndex] : entryIndex;
 	const Entry<DIM, WIDTH>* entry = entryMaps_[threadIndex].createEntry(values_[entryIndex], id);
 	switch (approach_) {
 	case optimistic_locking:
 		DynamicNodeOperationsUtil<DIM, WIDTH>::parallelInsert(*entry, *tree_);
 		break;
 	case buffered_bulk:
+		if (entryIndex % QUIESCE_INTERVAL == 0) {
+			entryMaps_[threadIndex].clearMap();
+			EpochReclamation<DIM>::quiesce();
+		}
+
 		bool success = false;
 		while (!success) {
-			if (deletedNodes_[threadIndex].full()) {syncPhaseRequired_ = true; }
 			if (syncPhaseRequired_) { handlePoolFlushSync(threadIndex, false); }
 			success = DynamicNodeOperationsUtil<DIM, WIDTH>::parallelBulkInsert(
-					*entry, *tree_, *pool_,
-					deletedNodes_[threadIndex],
+					*entry, *tree_, *pools_[threadIndex],
 					entryMaps_[threadIndex]);
 			if (!success) { syncPhaseRequired_ = true; }
 		}
@@ -240,7 +262,11 @@ double InsertionThreadPool<DIM, WIDTH>::insertBySelectedStrategy(size_t entryInd
 
 template <unsigned int DIM, unsigned int WIDTH>
 void InsertionThreadPool<DIM, WIDTH>::processNext(size_t threadIndex) {
-
+	// the nodes created by this thread belong to the tree
+	NodeArena::Scope arenaScope(arenas_[threadIndex]);
+	// nodes replaced by this thread are retired until no other thread can reference them
+	typename EpochReclamation<DIM>::Scope reclamationScope(tree_->reclamation_);
+	typename EpochReclamation<DIM>::Guard reclamationGuard;
 
 	const size_t size = values_.size();
 	switch (order_) {
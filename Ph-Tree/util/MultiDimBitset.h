@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <iostream>
+#include "libmorton/include/morton_BMI.h"
 
 template <unsigned int DIM>
 class MultiDimBitset {
@@ -11,6 +12,9 @@ public:
 
 	template <unsigned int WIDTH>
 	static void toBitset(const std::vector<unsigned long> &values, unsigned long* const outStartBlock);
+	// converts the DIM values starting at the given pointer
+	template <unsigned int WIDTH>
+	static void toBitset(const unsigned long* values, unsigned long* const outStartBlock);
 
 	static std::pair<bool, size_t> compare(const unsigned long* const startBlock, unsigned int nBits,
 			size_t fromIndex, size_t toIndex, const unsigned long* const otherStartBlock, unsigned int otherNBits);
@@ -52,6 +56,9 @@ public:
 			unsigned int lsbStartBitIndex);
 
 	static std::ostream& output(std::ostream &os, const unsigned long* const startBlock, unsigned int nBits);
+
+	// mask of the given number of lowest bits of a block (all bits if there are more)
+	static inline unsigned long lowerBitsMask(size_t nBits);
 private:
 	static inline std::pair<bool, size_t> compareAlignedBlocks(const unsigned long b1, const unsigned long b2);
 
@@ -66,18 +73,46 @@ private:
 	static const unsigned int dimBlockOffset = (bitsPerBlock % DIM == 0)? 0
 			: DIM - (bitsPerBlock - (((bitsPerBlock / DIM) * DIM) % bitsPerBlock));
 	static unsigned long initDimBlock();
-};
 
-template <unsigned int DIM>
-unsigned long MultiDimBitset<DIM>::dimBlock = initDimBlock();
+	// the bits of dimension d stored in block b are the value shifted by shift[b][d] and
+	// deposited at mask[b][d] (for the maximum width of 64 bits which needs DIM blocks)
+	struct DepositMasks {
+		unsigned int shift[DIM][DIM];
+		unsigned long mask[DIM][DIM];
+	};
+
+	static DepositMasks depositMasks;
+	static DepositMasks initDepositMasks();
+	// PDEP/PEXT interleave any number of dimensions if the CPU supports them
+	static const bool useBMI2;
+
+	template <unsigned int WIDTH>
+	M_BMI2_TARGET static void depositBMI2(const unsigned long* values, unsigned long* const outStartBlock);
+	M_BMI2_TARGET static void extractBMI2(const unsigned long* const fromStartBlock, size_t nBits, unsigned long* const outValues);
+	template <unsigned int WIDTH>
+	static void deposit(const unsigned long* values, unsigned long* const outStartBlock);
+	static void extract(const unsigned long* const fromStartBlock, size_t nBits, unsigned long* const outValues);
+};
 
 #include <string.h>
 #include <float.h>
 #include <math.h>
 #include "libmorton/include/morton.h"
 
+template <unsigned int DIM>
+unsigned long MultiDimBitset<DIM>::dimBlock = initDimBlock();
+template <unsigned int DIM>
+typename MultiDimBitset<DIM>::DepositMasks MultiDimBitset<DIM>::depositMasks = initDepositMasks();
+template <unsigned int DIM>
+const bool MultiDimBitset<DIM>::useBMI2 = m_bmi2_supported();
+
 using namespace std;
 
+template <unsigned int DIM>
+unsigned long MultiDimBitset<DIM>::lowerBitsMask(size_t nBits) {
+	return (nBits >= bitsPerBlock)? -1uL : (1uL << nBits) - 1uL;
+}
+
 template <unsigned int DIM>
 unsigned long MultiDimBitset<DIM>::initDimBlock() {
 	assert (dimBlockOffset < DIM);
@@ -92,9 +127,98 @@ unsigned long MultiDimBitset<DIM>::initDimBlock() {
 	return dimBlock;
 }
 
+template <unsigned int DIM>
+typename MultiDimBitset<DIM>::DepositMasks MultiDimBitset<DIM>::initDepositMasks() {
+	DepositMasks masks;
+	for (unsigned int b = 0; b < DIM; ++b) {
+		for (unsigned int d = 0; d < DIM; ++d) {
+			// bit i of dimension d is stored at DIM * i + d
+			unsigned int i = (b * bitsPerBlock > d)? (b * bitsPerBlock - d + DIM - 1) / DIM : 0;
+			masks.shift[b][d] = i;
+			masks.mask[b][d] = 0;
+			for (; i < bitsPerBlock && DIM * i + d < (b + 1) * bitsPerBlock; ++i) {
+				masks.mask[b][d] |= 1uL << (DIM * i + d - b * bitsPerBlock);
+			}
+		}
+	}
+
+	return masks;
+}
+
+template <unsigned int DIM>
+template <unsigned int WIDTH>
+void MultiDimBitset<DIM>::depositBMI2(const unsigned long* values, unsigned long* const outStartBlock) {
+#if M_BMI2_AVAILABLE
+	const unsigned int nBlocks = 1 + (DIM * WIDTH - 1) / bitsPerBlock;
+	for (unsigned int b = 0; b < nBlocks; ++b) {
+		unsigned long block = 0;
+		for (unsigned int d = 0; d < DIM; ++d) {
+			block |= m_pdep_64(values[d] >> depositMasks.shift[b][d], depositMasks.mask[b][d]);
+		}
+
+		outStartBlock[b] = block;
+	}
+#else
+	deposit<WIDTH>(values, outStartBlock);
+#endif
+}
+
+template <unsigned int DIM>
+template <unsigned int WIDTH>
+void MultiDimBitset<DIM>::deposit(const unsigned long* values, unsigned long* const outStartBlock) {
+	const unsigned int nBlocks = 1 + (DIM * WIDTH - 1) / bitsPerBlock;
+	for (unsigned int b = 0; b < nBlocks; ++b) {
+		unsigned long block = 0;
+		for (unsigned int d = 0; d < DIM; ++d) {
+			block |= m_pdep_64_for(values[d] >> depositMasks.shift[b][d], depositMasks.mask[b][d]);
+		}
+
+		outStartBlock[b] = block;
+	}
+}
+
+template <unsigned int DIM>
+void MultiDimBitset<DIM>::extractBMI2(const unsigned long* const fromStartBlock, size_t nBits, unsigned long* const outValues) {
+#if M_BMI2_AVAILABLE
+	const size_t nBlocks = 1 + (nBits - 1) / bitsPerBlock;
+	for (size_t b = 0; b < nBlocks; ++b) {
+		// ignore the bits after the last value bit
+		const size_t remainingBits = nBits - b * bitsPerBlock;
+		const unsigned long block = (remainingBits >= bitsPerBlock)? fromStartBlock[b]
+				: fromStartBlock[b] & ((1uL << remainingBits) - 1uL);
+		for (unsigned int d = 0; d < DIM; ++d) {
+			outValues[d] |= m_pext_64(block, depositMasks.mask[b][d]) << depositMasks.shift[b][d];
+		}
+	}
+#else
+	extract(fromStartBlock, nBits, outValues);
+#endif
+}
+
+template <unsigned int DIM>
+void MultiDimBitset<DIM>::extract(const unsigned long* const fromStartBlock, size_t nBits, unsigned long* const outValues) {
+	const size_t nBlocks = 1 + (nBits - 1) / bitsPerBlock;
+	for (size_t b = 0; b < nBlocks; ++b) {
+		// ignore the bits after the last value bit
+		const size_t remainingBits = nBits - b * bitsPerBlock;
+		const unsigned long block = (remainingBits >= bitsPerBlock)? fromStartBlock[b]
+				: fromStartBlock[b] & ((1uL << remainingBits) - 1uL);
+		for (unsigned int d = 0; d < DIM; ++d) {
+			outValues[d] |= m_pext_64_for(block, depositMasks.mask[b][d]) << depositMasks.shift[b][d];
+		}
+	}
+}
+
 template <unsigned int DIM>
 template <unsigned int WIDTH>
 void MultiDimBitset<DIM>::toBitset(const std::vector<unsigned long> &values, unsigned long* outStartBlock) {
+	assert (values.size() == DIM);
+	toBitset<WIDTH>(values.data(), outStartBlock);
+}
+
+template <unsigned int DIM>
+template <unsigned int WIDTH>
+void MultiDimBitset<DIM>::toBitset(const unsigned long* values, unsigned long* outStartBlock) {
 	//     example 2 Dim, 8 Bit: (    10   ,     5    )
 	//    binary representation: (0000 1010, 0000 0101)
 	//  				  index:    12    8    4    0
@@ -103,7 +227,6 @@ void MultiDimBitset<DIM>::toBitset(const std::vector<unsigned long> &values, uns
 	// second dimension (mask) : (1010 1010 1010 1010)
 
 	assert (sizeof (unsigned long) * 8 >= WIDTH);
-	assert (values.size() == DIM);
 	assert (outStartBlock[0] == 0);
 
 	if (DIM == 2) {
@@ -116,6 +239,9 @@ void MultiDimBitset<DIM>::toBitset(const std::vector<unsigned long> &values, uns
 			*outStartBlock = morton2D_64_encode(v1, v2);
 			*(outStartBlock + 1) = morton2D_64_encode(v1 >> 32, v2 >> 32);
 		}
+	} else if (useBMI2) {
+		// the lookup tables are only faster for two dimensions
+		depositBMI2<WIDTH>(values, outStartBlock);
 	} else if (DIM == 3) {
 		//       [       first    block       ][ second block ...
 		// want: (a1 b1 c1) (a2 b2 c2) ... (ai, bi, ci)
@@ -196,41 +322,28 @@ void MultiDimBitset<DIM>::toBitset(const std::vector<unsigned long> &values, uns
 			*(outStartBlock + 5) = inter6;
 		}
 	} else {
-		// TODO if BMI2 is available the operation PEXT should be used!
-		for (size_t d = 0; d < DIM; ++d) {
-			assert (WIDTH == 64 || values[d] <= (1uL << WIDTH) - 1uL);
-			const unsigned long value = values[d];
-			for (size_t i = 0; i < WIDTH; ++i) {
-				// extract j-th least significant bit from int
-				// TODO use CPU instruction for interleaving
-				const unsigned long bit = (value >> i) & 1;
-				const auto block = (DIM * i + d) / bitsPerBlock;
-				const auto index = (DIM * i + d) % bitsPerBlock;
-				*(outStartBlock + block) |= bit << index;
-			}
-		}
+		// deposits the bits of all dimensions blockwise without BMI2
+		deposit<WIDTH>(values, outStartBlock);
 	}
 
-	assert(toLongs(outStartBlock, DIM * WIDTH) == values);
+	assert(toLongs(outStartBlock, DIM * WIDTH) == vector<unsigned long>(values, values + DIM));
 }
 
 template <unsigned int DIM>
 vector<unsigned long> MultiDimBitset<DIM>::toLongs(const unsigned long* fromStartBlock, size_t nBits) {
+	assert (nBits % DIM == 0 && nBits <= DIM * bitsPerBlock);
+	vector<unsigned long> numericalValues(DIM, 0);
+	if (nBits == 0) {
+		return numericalValues;
+	}
 
-		vector<unsigned long> numericalValues(DIM, 0);
-		const size_t bitLength = nBits / DIM;
-		// TODO change loop order?
-		for (size_t i = 0; i < bitLength; ++i) {
-			for (size_t d = 0; d < DIM; ++d) {
-				const size_t blockIndex = (DIM * i + d) / bitsPerBlock;
-				const size_t bitIndex = (DIM * i + d) % bitsPerBlock;
-				const size_t block = fromStartBlock[blockIndex];
-				const size_t bit = (block >> bitIndex) & 1;
-				numericalValues[d] += bit << i;
-			}
-		}
+	if (useBMI2) {
+		extractBMI2(fromStartBlock, nBits, numericalValues.data());
+	} else {
+		extract(fromStartBlock, nBits, numericalValues.data());
+	}
 
-		return numericalValues;
+	return numericalValues;
 }
 
 template <unsigned int DIM>
@@ -0,0 +1,249 @@
+#ifndef SRC_UTIL_NODEARENA_H_
+#define SRC_UTIL_NODEARENA_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+// Per tree memory for nodes and suffix storages. Allocations are served from slabs that only hold
+// slots of one size class and freed slots are kept in a free list of their size class. The memory
+// is only returned when the arena is destroyed so destroying a tree does not need to visit its nodes.
+// Nodes and suffix storages are allocated from the arena of the calling thread (see Scope) and
+// fall back to the heap if there is none. Define HUGE_PAGES to back the arena with transparent
+// huge pages.
+class NodeArena {
+public:
+	NodeArena();
+	~NodeArena();
+
+	// all allocations of the current thread use the given arena while the scope exists
+	class Scope {
+	public:
+		explicit Scope(NodeArena* arena);
+		~Scope();
+
+	private:
+		NodeArena* previous_;
+	};
+
+	// used by the class specific new and delete operators of nodes and suffix storages
+	static void* allocateOwned(size_t bytes);
+	static void deallocateOwned(void* pointer, size_t bytes);
+
+	// creates an arena that is freed with this one so a thread can allocate nodes without contention
+	NodeArena* createWorkerArena();
+
+	size_t getReservedBytes();
+
+private:
+	struct SizeClass {
+		void* freeList_;
+		unsigned int nSlabs_;
+	};
+
+	// every owned allocation starts with a pointer to its arena (NULL for heap allocations)
+	static const size_t HEADER_BYTES = 16;
+	static const size_t SLOT_ALIGNMENT = 16;
+	#ifdef HUGE_PAGES
+	static const size_t CHUNK_BYTES = 2uL << 20;
+	#else
+	static const size_t CHUNK_BYTES = 256uL << 10;
+	#endif
+	static const size_t MAX_SLAB_BYTES = 64uL << 10;
+	// slots up to this size have one size class per alignment step, larger slots are rounded up
+	// to one of four size classes between two powers of two
+	static const size_t MAX_SMALL_SLOT_BYTES = 4uL << 10;
+	static const size_t N_SMALL_SIZE_CLASSES = MAX_SMALL_SLOT_BYTES / SLOT_ALIGNMENT;
+	static const size_t N_SIZE_CLASSES = N_SMALL_SIZE_CLASSES + 4 * (64 - 12);
+
+	std::mutex mutex_;
+	SizeClass sizeClasses_[N_SIZE_CLASSES];
+	// <start, bytes> of all chunks requested from the system
+	std::vector<std::pair<char*, size_t>> chunks_;
+	char* chunkNext_;
+	char* chunkEnd_;
+	size_t reservedBytes_;
+	std::vector<NodeArena*> workerArenas_;
+
+	void* allocate(size_t sizeClass);
+	void deallocate(void* slot, size_t sizeClass);
+	char* allocateSlab(size_t slabBytes);
+	char* allocateChunk(size_t chunkBytes);
+	void freeChunk(char* chunk, size_t chunkBytes);
+	static NodeArena*& current();
+	static size_t toSizeClass(size_t bytes);
+	static size_t toSlotBytes(size_t sizeClass);
+};
+
+#include <assert.h>
+#include <new>
+#ifdef HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+inline NodeArena::NodeArena() : mutex_(), sizeClasses_(), chunks_(), chunkNext_(NULL), chunkEnd_(NULL), reservedBytes_(0), workerArenas_() {
+}
+
+inline NodeArena::~NodeArena() {
+	for (NodeArena* workerArena : workerArenas_) {
+		delete workerArena;
+	}
+
+	for (auto chunk : chunks_) {
+		freeChunk(chunk.first, chunk.second);
+	}
+}
+
+inline NodeArena::Scope::Scope(NodeArena* arena) : previous_(NodeArena::current()) {
+	NodeArena::current() = arena;
+}
+
+inline NodeArena::Scope::~Scope() {
+	NodeArena::current() = previous_;
+}
+
+inline NodeArena*& NodeArena::current() {
+	// function local so the header can be included by several translation units
+	static thread_local NodeArena* current = NULL;
+	return current;
+}
+
+inline size_t NodeArena::toSizeClass(size_t bytes) {
+	const size_t minSlotBytes = (bytes + HEADER_BYTES + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+	if (minSlotBytes <= MAX_SMALL_SLOT_BYTES) {
+		return minSlotBytes / SLOT_ALIGNMENT - 1;
+	}
+
+	// 2^exponent < minSlotBytes <= 2^(exponent + 1)
+	const unsigned int exponent = 63 - __builtin_clzl(minSlotBytes - 1);
+	const size_t quarter = (minSlotBytes - 1 - (1uL << exponent)) >> (exponent - 2);
+	return N_SMALL_SIZE_CLASSES + 4 * (exponent - 12) + quarter;
+}
+
+inline size_t NodeArena::toSlotBytes(size_t sizeClass) {
+	if (sizeClass < N_SMALL_SIZE_CLASSES) {
+		return (sizeClass + 1) * SLOT_ALIGNMENT;
+	}
+
+	const unsigned int exponent = 12 + (sizeClass - N_SMALL_SIZE_CLASSES) / 4;
+	const size_t quarter = (sizeClass - N_SMALL_SIZE_CLASSES) % 4;
+	return (1uL << exponent) + ((quarter + 1) << (exponent - 2));
+}
+
+inline void* NodeArena::allocateOwned(size_t bytes) {
+	NodeArena* arena = current();
+	const size_t sizeClass = toSizeClass(bytes);
+	char* slot = static_cast<char*>((arena)? arena->allocate(sizeClass) : ::operator new(toSlotBytes(sizeClass)));
+	*reinterpret_cast<NodeArena**>(slot) = arena;
+	return slot + HEADER_BYTES;
+}
+
+inline void NodeArena::deallocateOwned(void* pointer, size_t bytes) {
+	if (!pointer) {
+		return;
+	}
+
+	char* slot = static_cast<char*>(pointer) - HEADER_BYTES;
+	NodeArena* arena = *reinterpret_cast<NodeArena**>(slot);
+	if (arena) {
+		arena->deallocate(slot, toSizeClass(bytes));
+	} else {
+		::operator delete(slot);
+	}
+}
+
+inline NodeArena* NodeArena::createWorkerArena() {
+	std::unique_lock<std::mutex> lk(mutex_);
+	workerArenas_.push_back(new NodeArena());
+	return workerArenas_.back();
+}
+
+inline size_t NodeArena::getReservedBytes() {
+	std::unique_lock<std::mutex> lk(mutex_);
+	size_t reservedBytes = reservedBytes_;
+	for (NodeArena* workerArena : workerArenas_) {
+		reservedBytes += workerArena->getReservedBytes();
+	}
+
+	return reservedBytes;
+}
+
+inline void* NodeArena::allocate(size_t sizeClassIndex) {
+	assert (sizeClassIndex < N_SIZE_CLASSES);
+	std::unique_lock<std::mutex> lk(mutex_);
+	SizeClass& sizeClass = sizeClasses_[sizeClassIndex];
+	if (!sizeClass.freeList_) {
+		const size_t slotBytes = toSlotBytes(sizeClassIndex);
+		// the slabs of a size class double until they reach the maximum slab size
+		const size_t maxSlots = (slotBytes < MAX_SLAB_BYTES)? MAX_SLAB_BYTES / slotBytes : 1;
+		const size_t nSlots = (sizeClass.nSlabs_ < 16 && (1uL << sizeClass.nSlabs_) < maxSlots)?
+				(1uL << sizeClass.nSlabs_) : maxSlots;
+		char* slab = allocateSlab(nSlots * slotBytes);
+		++sizeClass.nSlabs_;
+		// link the slots of the new slab in ascending order
+		for (size_t slot = nSlots; slot > 0; --slot) {
+			char* slotStart = slab + (slot - 1) * slotBytes;
+			*reinterpret_cast<void**>(slotStart) = sizeClass.freeList_;
+			sizeClass.freeList_ = slotStart;
+		}
+	}
+
+	void* slot = sizeClass.freeList_;
+	sizeClass.freeList_ = *reinterpret_cast<void**>(slot);
+	return slot;
+}
+
+inline void NodeArena::deallocate(void* slot, size_t sizeClassIndex) {
+	assert (sizeClassIndex < N_SIZE_CLASSES);
+	std::unique_lock<std::mutex> lk(mutex_);
+	SizeClass& sizeClass = sizeClasses_[sizeClassIndex];
+	*reinterpret_cast<void**>(slot) = sizeClass.freeList_;
+	sizeClass.freeList_ = slot;
+}
+
+inline char* NodeArena::allocateSlab(size_t slabBytes) {
+	if (slabBytes > CHUNK_BYTES / 4) {
+		// large slabs get their own chunk so the remaining space of the current chunk is not lost
+		return allocateChunk(slabBytes);
+	}
+
+	if (size_t(chunkEnd_ - chunkNext_) < slabBytes) {
+		chunkNext_ = allocateChunk(CHUNK_BYTES);
+		chunkEnd_ = chunkNext_ + CHUNK_BYTES;
+	}
+
+	char* slab = chunkNext_;
+	chunkNext_ += slabBytes;
+	return slab;
+}
+
+inline char* NodeArena::allocateChunk(size_t chunkBytes) {
+	#ifdef HUGE_PAGES
+		const size_t hugePageBytes = 2uL << 20;
+		chunkBytes = (chunkBytes + hugePageBytes - 1) & ~(hugePageBytes - 1);
+		void* mapped = mmap(NULL, chunkBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapped == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+
+		madvise(mapped, chunkBytes, MADV_HUGEPAGE);
+		char* chunk = static_cast<char*>(mapped);
+	#else
+		char* chunk = static_cast<char*>(::operator new(chunkBytes));
+	#endif
+
+	chunks_.emplace_back(chunk, chunkBytes);
+	reservedBytes_ += chunkBytes;
+	return chunk;
+}
+
+inline void NodeArena::freeChunk(char* chunk, size_t chunkBytes) {
+	#ifdef HUGE_PAGES
+		munmap(chunk, chunkBytes);
+	#else
+		::operator delete(chunk);
+	#endif
+}
+
+#endif /* SRC_UTIL_NODEARENA_H_ */
@@ -0,0 +1,187 @@
+#ifndef SRC_UTIL_NODETYPEPOLICY_H_
+#define SRC_UTIL_NODETYPEPOLICY_H_
+
+#include <cstddef>
+
+// the node types NodeTypeUtil can build ordered by their capacity
+enum NodeSizeClass {
+	lhc_2_contents,
+	lhc_10_percent,
+	lhc_20_percent,
+	lhc_35_percent,
+	lhc_50_percent,
+	lhc_75_percent,
+	ahc_all_contents
+};
+
+// Decides which node type is built for a given number of contents. NodeTypeUtil only builds
+// size classes that can hold the requested contents so a policy may return a smaller class
+// if it does not care (it is replaced by the next class that fits).
+template <unsigned int DIM>
+class NodeTypePolicy {
+public:
+	virtual ~NodeTypePolicy() {}
+	virtual NodeSizeClass selectSizeClass(size_t nContents) const = 0;
+
+	static size_t getCapacity(NodeSizeClass sizeClass);
+	// bytes of a node of the class without prefix blocks and suffix storage
+	static size_t getByteSize(NodeSizeClass sizeClass);
+
+protected:
+	// the LHC class for the fill ratio of the contents or the AHC from 75% on
+	static NodeSizeClass fillRatioSizeClass(size_t nContents);
+};
+
+// The fixed thresholds: the smallest LHC class up to a fill ratio of 75%, then the AHC.
+template <unsigned int DIM>
+class FillRatioNodeTypePolicy : public NodeTypePolicy<DIM> {
+public:
+	NodeSizeClass selectSizeClass(size_t nContents) const override;
+};
+
+// Weighs the memory footprint of a node against the time for looking up one address and for
+// iterating all of its contents. The weights convert bytes and nanoseconds into one cost so
+// that a memory bound deployment can raise the byte weight and a latency bound deployment
+// the other two. The time estimates are calibrated by PlotUtil::plotNodeTypeCost() and
+// only decide when to switch to the AHC as the LHC classes are the ones of the fixed thresholds.
+template <unsigned int DIM>
+class CostModelNodeTypePolicy : public NodeTypePolicy<DIM> {
+public:
+	// by default a lookup weighs more than an iteration as every point operation looks up
+	// an address in each node on its path while range queries iterate few nodes completely
+	explicit CostModelNodeTypePolicy(double byteWeight = 1.0, double lookupWeight = 4.0,
+			double iterationWeight = 0.25);
+	NodeSizeClass selectSizeClass(size_t nContents) const override;
+
+	double getCost(NodeSizeClass sizeClass, size_t nContents) const;
+	// the lowest number of contents from which the AHC is built
+	size_t getAhcThreshold() const;
+
+private:
+	// nanoseconds fitted to the measurements for 2 to 12 dimensions
+	static constexpr double lhcLookupNs = 5.0;
+	static constexpr double lhcLookupPerLevelNs = 7.0;
+	static constexpr double ahcLookupNs = 8.0;
+	static constexpr double lhcRowNs = 2.5;
+	// the references of an AHC are spread over more cache lines
+	static constexpr double ahcRowNs = 4.5;
+	static constexpr double ahcBlockNs = 1.0;
+
+	const double byteWeight_;
+	const double lookupWeight_;
+	const double iterationWeight_;
+	size_t ahcThreshold_;
+};
+
+#include <assert.h>
+#include <cmath>
+#include <stdexcept>
+#include "nodes/LHC.h"
+#include "nodes/AHC.h"
+
+using namespace std;
+
+template <unsigned int DIM>
+size_t NodeTypePolicy<DIM>::getCapacity(NodeSizeClass sizeClass) {
+	switch (sizeClass) {
+	case lhc_2_contents: return 2;
+	case lhc_10_percent: return 1 + 10 * (1 << DIM) / 100;
+	case lhc_20_percent: return 1 + 20 * (1 << DIM) / 100;
+	case lhc_35_percent: return 1 + 35 * (1 << DIM) / 100;
+	case lhc_50_percent: return 1 + 50 * (1 << DIM) / 100;
+	case lhc_75_percent: return 1 + 75 * (1 << DIM) / 100;
+	case ahc_all_contents: return 1uL << DIM;
+	default: throw runtime_error("Unknown node size class.");
+	}
+}
+
+template <unsigned int DIM>
+size_t NodeTypePolicy<DIM>::getByteSize(NodeSizeClass sizeClass) {
+	switch (sizeClass) {
+	case lhc_2_contents: return sizeof (LHC<DIM, 0, 2>);
+	case lhc_10_percent: return sizeof (LHC<DIM, 0, 1 + 10 * (1 << DIM) / 100>);
+	case lhc_20_percent: return sizeof (LHC<DIM, 0, 1 + 20 * (1 << DIM) / 100>);
+	case lhc_35_percent: return sizeof (LHC<DIM, 0, 1 + 35 * (1 << DIM) / 100>);
+	case lhc_50_percent: return sizeof (LHC<DIM, 0, 1 + 50 * (1 << DIM) / 100>);
+	case lhc_75_percent: return sizeof (LHC<DIM, 0, 1 + 75 * (1 << DIM) / 100>);
+	case ahc_all_contents: return sizeof (AHC<DIM, 0>);
+	default: throw runtime_error("Unknown node size class.");
+	}
+}
+
+template <unsigned int DIM>
+NodeSizeClass NodeTypePolicy<DIM>::fillRatioSizeClass(size_t nContents) {
+	assert (nContents > 0);
+	const float insertToRatio = float(nContents) / (1u << DIM);
+	if (insertToRatio >= 0.75) {
+		return ahc_all_contents;
+	} else if (nContents < 3) {
+		return lhc_2_contents;
+	} else if (insertToRatio < 0.1) {
+		return lhc_10_percent;
+	} else if (insertToRatio < 0.2) {
+		return lhc_20_percent;
+	} else if (insertToRatio < 0.35) {
+		return lhc_35_percent;
+	} else if (insertToRatio < 0.5) {
+		return lhc_50_percent;
+	} else {
+		return lhc_75_percent;
+	}
+}
+
+template <unsigned int DIM>
+NodeSizeClass FillRatioNodeTypePolicy<DIM>::selectSizeClass(size_t nContents) const {
+	return NodeTypePolicy<DIM>::fillRatioSizeClass(nContents);
+}
+
+template <unsigned int DIM>
+CostModelNodeTypePolicy<DIM>::CostModelNodeTypePolicy(double byteWeight, double lookupWeight,
+		double iterationWeight) : byteWeight_(byteWeight), lookupWeight_(lookupWeight),
+		iterationWeight_(iterationWeight), ahcThreshold_(1uL << DIM) {
+	assert (byteWeight >= 0 && lookupWeight >= 0 && iterationWeight >= 0);
+	// the AHC is used from the lowest number of contents on that it is cheaper for all
+	// larger numbers so that the capacity grows with the contents
+	for (size_t n = 1uL << DIM; n > 0; --n) {
+		const NodeSizeClass lhcClass = NodeTypePolicy<DIM>::fillRatioSizeClass(n);
+		if (lhcClass == ahc_all_contents || getCost(ahc_all_contents, n) <= getCost(lhcClass, n)) {
+			ahcThreshold_ = n;
+		} else {
+			break;
+		}
+	}
+}
+
+template <unsigned int DIM>
+NodeSizeClass CostModelNodeTypePolicy<DIM>::selectSizeClass(size_t nContents) const {
+	if (nContents >= ahcThreshold_) {
+		return ahc_all_contents;
+	}
+
+	return NodeTypePolicy<DIM>::fillRatioSizeClass(nContents);
+}
+
+template <unsigned int DIM>
+double CostModelNodeTypePolicy<DIM>::getCost(NodeSizeClass sizeClass, size_t nContents) const {
+	assert (nContents > 0 && nContents <= NodeTypePolicy<DIM>::getCapacity(sizeClass));
+	const size_t bitsPerBlock = 8 * sizeof (unsigned long);
+	double lookupNs;
+	double iterationNs;
+	if (sizeClass == ahc_all_contents) {
+		lookupNs = ahcLookupNs;
+		iterationNs = ahcRowNs * nContents + ahcBlockNs * (1 + ((1uL << DIM) - 1) / bitsPerBlock);
+	} else {
+		lookupNs = lhcLookupNs + lhcLookupPerLevelNs * log2(double(nContents));
+		iterationNs = lhcRowNs * nContents;
+	}
+
+	return byteWeight_ * NodeTypePolicy<DIM>::getByteSize(sizeClass)
+			+ lookupWeight_ * lookupNs + iterationWeight_ * iterationNs;
+}
+
+template <unsigned int DIM>
+size_t CostModelNodeTypePolicy<DIM>::getAhcThreshold() const {
+	return ahcThreshold_;
+}
+
+#endif /* SRC_UTIL_NODETYPEPOLICY_H_ */
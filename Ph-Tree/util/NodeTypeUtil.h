@@ -2,10 +2,13 @@
 #define SRC_UTIL_NODETYPEUTIL_H_
 
 #include <cstdint>
+#include <atomic>
 #include "nodes/LHC.h"
 #include "nodes/AHC.h"
 #include "nodes/SuffixStorage.h"
 #include "util/TEntryBuffer.h"
+#include "util/EpochReclamation.h"
+#include "util/NodeTypePolicy.h"
 
 template <unsigned int DIM>
 class Node;
@@ -18,10 +21,39 @@ public:
 		assert (suffixBits < DIM * WIDTH && (suffixBits % DIM == 0));
 		assert (nSuffixes <= nDirectInserts);
 		Node<DIM>* node = buildNode(prefixBits, nDirectInserts);
-		if (nSuffixes > 0 && suffixBits > 0 && !node->canStoreSuffixInternally(suffixBits)) {
-			const unsigned int suffixBlocks = 1 + (suffixBits - 1) / (8 * sizeof (unsigned long));
-			TSuffixStorage* storage = createSuffixStorage<WIDTH>(nSuffixes * suffixBlocks);
-			node->setSuffixStorage(storage);
+		addSuffixStorage<WIDTH>(nSuffixes, suffixBits, node);
+		return node;
+	}
+
+	// builds the smallest node that holds the given number of contents (instead of leaving room for further inserts)
+	template <unsigned int WIDTH>
+	static Node<DIM>* buildTightNodeWithSuffixes(size_t prefixBits, size_t nContents, size_t nSuffixes, unsigned int suffixBits) {
+		assert (suffixBits < DIM * WIDTH && (suffixBits % DIM == 0));
+		assert (nSuffixes <= nContents);
+		Node<DIM>* node = buildNode(prefixBits, determineTightNInserts(nContents));
+		assert (node->getMaximumNumberOfContents() >= nContents);
+		addSuffixStorage<WIDTH>(nSuffixes, suffixBits, node);
+		return node;
+	}
+
+	// builds the node type that holds at most the given number of contents (as returned by
+	// getMaximumNumberOfContents) with a suffix storage of at least the given number of blocks
+	template <unsigned int WIDTH>
+	static Node<DIM>* buildNodeWithCapacity(size_t prefixBits, size_t capacity, unsigned int suffixBlocks) {
+		// independent of the policy as the node could have been built with another one
+		NodeSizeClass sizeClass = lhc_2_contents;
+		while (NodeTypePolicy<DIM>::getCapacity(sizeClass) != capacity) {
+			if (sizeClass == ahc_all_contents) {
+				throw runtime_error("There is no node type with the given capacity.");
+			}
+
+			sizeClass = NodeSizeClass(sizeClass + 1);
+		}
+
+		Node<DIM>* node = buildNodeOfSizeClass(prefixBits, sizeClass);
+		assert (node->getMaximumNumberOfContents() == capacity);
+		if (suffixBlocks > 0) {
+			node->setSuffixStorage(createSuffixStorage<WIDTH>(suffixBlocks));
 		}
 
 		return node;
@@ -38,7 +70,8 @@ public:
 		assert (!oldStorage || suffixes->getNMaxStorageBlocks() > oldStorage->getNMaxStorageBlocks());
 		if (oldStorage) {
 			suffixes->copyFrom(*oldStorage);
-			delete oldStorage;
+			// concurrent insertions could still read the old storage
+			EpochReclamation<DIM>::retire(oldStorage);
 		}
 
 		node->setSuffixStorage(suffixes);
@@ -62,7 +95,7 @@ public:
 				}
 
 				node->setSuffixStorage(shrinkedStorage);
-				delete oldStorage;
+				EpochReclamation<DIM>::retire(oldStorage);
 			}
 		}
 	}
@@ -76,7 +109,7 @@ public:
 	}
 
 	static Node<DIM>* copyIntoLargerNode(size_t newNContents, const Node<DIM>* nodeToCopy) {
-		// TODO make more efficient by not using iterators and a bulk insert
+		// TODO make more efficient by using a bulk insert
 		const size_t prefixLength = nodeToCopy->getPrefixLength();
 		Node<DIM>* copy = buildNode(prefixLength * DIM, newNContents);
 		if (prefixLength > 0) {
@@ -88,7 +121,77 @@ public:
 		return copy;
 	}
 
+	static Node<DIM>* copyIntoSmallerNode(size_t newNContents, const Node<DIM>* nodeToCopy) {
+		assert (newNContents >= nodeToCopy->getNumberOfContents());
+		assert (determineNodeCapacity(newNContents) < nodeToCopy->getMaximumNumberOfContents());
+		// the suffix storage is shared with the new node
+		return copyIntoLargerNode(newNContents, nodeToCopy);
+	}
+
+	// returns the maximum number of contents of the node buildNode() creates for the given number of inserts
+	static size_t determineNodeCapacity(size_t nDirectInserts) {
+		return NodeTypePolicy<DIM>::getCapacity(determineSizeClass(nDirectInserts));
+	}
+
+	// replaces the policy that selects the node types of new nodes (NULL restores the default)
+	// which is only safe while no tree of this dimensionality is modified; the policy is not
+	// owned and the capacity it selects must not decrease for growing numbers of contents
+	static void setPolicy(const NodeTypePolicy<DIM>* policy) {
+		policy_ = policy;
+	}
+
+	static const NodeTypePolicy<DIM>& getPolicy() {
+		const NodeTypePolicy<DIM>* policy = policy_;
+		return (policy)? *policy : getDefaultPolicy();
+	}
+
+	static const NodeTypePolicy<DIM>& getDefaultPolicy() {
+		static const CostModelNodeTypePolicy<DIM> defaultPolicy;
+		return defaultPolicy;
+	}
+
 private:
+	static std::atomic<const NodeTypePolicy<DIM>*> policy_;
+
+	// the size class the policy selects or the next larger one that can hold the contents
+	inline static NodeSizeClass determineSizeClass(size_t nContents) {
+		assert (nContents > 0 && nContents <= (1uL << DIM));
+		NodeSizeClass sizeClass = getPolicy().selectSizeClass(nContents);
+		while (NodeTypePolicy<DIM>::getCapacity(sizeClass) < nContents) {
+			assert (sizeClass != ahc_all_contents);
+			sizeClass = NodeSizeClass(sizeClass + 1);
+		}
+
+		return sizeClass;
+	}
+
+	template <unsigned int WIDTH>
+	inline static void addSuffixStorage(size_t nSuffixes, unsigned int suffixBits, Node<DIM>* node) {
+		if (nSuffixes > 0 && suffixBits > 0 && !node->canStoreSuffixInternally(suffixBits)) {
+			const unsigned int suffixBlocks = 1 + (suffixBits - 1) / (8 * sizeof (unsigned long));
+			TSuffixStorage* storage = createSuffixStorage<WIDTH>(nSuffixes * suffixBlocks);
+			node->setSuffixStorage(storage);
+		}
+	}
+
+	// returns the lowest number of inserts for which buildNode() creates a node with room for the
+	// given number of contents, i.e. the smallest node type that can hold all of them
+	inline static size_t determineTightNInserts(size_t nContents) {
+		assert (nContents > 0 && nContents <= (1uL << DIM));
+		size_t l = 1;
+		size_t r = nContents;
+		while (l < r) {
+			const size_t middle = (l + r) / 2;
+			if (determineNodeCapacity(middle) >= nContents) {
+				r = middle;
+			} else {
+				l = middle + 1;
+			}
+		}
+
+		assert (determineNodeCapacity(l) >= nContents);
+		return l;
+	}
 
 	template <unsigned int WIDTH>
 	inline static bool canShrinkSuffixStorage(unsigned int newRequiredSuffixBlocks, unsigned int oldSuffixBlocks, bool* empty) {
@@ -189,13 +292,9 @@ private:
 		assert (!to.getSuffixStorage());
 		to.copySuffixStorageFrom(from);
 
-		// TODO make more efficient by not using iterators and a bulk insert
+		// TODO make more efficient by using a bulk insert
 		// copy node contents
-		NodeIterator<DIM>* it = from.begin();
-		it->disableResolvingSuffixIndex();
-		NodeIterator<DIM>* endIt = from.end();
-		for (; (*it) != *endIt; ++(*it)) {
-			NodeAddressContent<DIM> content = *(*it);
+		auto insertContent = [&to] (const NodeAddressContent<DIM>& content) {
 			if (content.hasSubnode) {
 				to.insertAtAddress(content.address, content.subnode);
 			} else if (content.hasSpecialPointer) {
@@ -207,68 +306,51 @@ private:
 			} else {
 				to.insertAtAddress(content.address, content.suffixStartBlockIndex, content.id);
 			}
-		}
+		};
 
-		delete it;
-		delete endIt;
+		from.forEachContent(insertContent, false);
 	}
 
 	template <unsigned int PREF_BLOCKS>
-	inline static Node<DIM>* determineNodeType(size_t prefixBits, size_t nDirectInserts) {
-		assert (nDirectInserts > 0);
+	inline static Node<DIM>* determineNodeType(size_t prefixBits, NodeSizeClass sizeClass) {
 		const size_t prefixLength = prefixBits / DIM;
-		// TODO use threshold depending on which node is smaller
-		const double switchTypeAtLoadRatio = 0.75;
-		if (float(nDirectInserts) / (1uL << DIM) < switchTypeAtLoadRatio) {
-			return determineLhcSize<PREF_BLOCKS>(prefixLength, nDirectInserts);
-		} else {
-			return new AHC<DIM, PREF_BLOCKS>(prefixLength);
+		switch (sizeClass) {
+		case lhc_2_contents: return new LHC<DIM, PREF_BLOCKS, 2>(prefixLength);
+		case lhc_10_percent: return new LHC<DIM, PREF_BLOCKS, 1 + 10 * (1 << DIM) / 100>(prefixLength);
+		case lhc_20_percent: return new LHC<DIM, PREF_BLOCKS, 1 + 20 * (1 << DIM) / 100>(prefixLength);
+		case lhc_35_percent: return new LHC<DIM, PREF_BLOCKS, 1 + 35 * (1 << DIM) / 100>(prefixLength);
+		case lhc_50_percent: return new LHC<DIM, PREF_BLOCKS, 1 + 50 * (1 << DIM) / 100>(prefixLength);
+		case lhc_75_percent: return new LHC<DIM, PREF_BLOCKS, 1 + 75 * (1 << DIM) / 100>(prefixLength);
+		case ahc_all_contents: return new AHC<DIM, PREF_BLOCKS>(prefixLength);
+		default: throw runtime_error("Unknown node size class.");
 		}
 	}
 
 	inline static Node<DIM>* buildNode(size_t prefixBits, size_t nDirectInserts) {
+		return buildNodeOfSizeClass(prefixBits, determineSizeClass(nDirectInserts));
+	}
+
+	inline static Node<DIM>* buildNodeOfSizeClass(size_t prefixBits, NodeSizeClass sizeClass) {
 			const size_t prefixBlocks = (prefixBits > 0)? 1 + ((prefixBits - 1) / (8 * sizeof (unsigned long))) : 0;
 			switch (prefixBlocks) {
-			case 0: return determineNodeType<0>(prefixBits, nDirectInserts);
-			case 1: return determineNodeType<1>(prefixBits, nDirectInserts);
-			case 2: return determineNodeType<2>(prefixBits, nDirectInserts);
-			case 3: return determineNodeType<3>(prefixBits, nDirectInserts);
-			case 4: return determineNodeType<4>(prefixBits, nDirectInserts);
-			case 5: return determineNodeType<5>(prefixBits, nDirectInserts);
-			case 6: return determineNodeType<6>(prefixBits, nDirectInserts);
-			case 7: return determineNodeType<7>(prefixBits, nDirectInserts);
-			case 8: return determineNodeType<8>(prefixBits, nDirectInserts);
-			case 9: return determineNodeType<9>(prefixBits, nDirectInserts);
-			case 10: return determineNodeType<10>(prefixBits, nDirectInserts);
+			case 0: return determineNodeType<0>(prefixBits, sizeClass);
+			case 1: return determineNodeType<1>(prefixBits, sizeClass);
+			case 2: return determineNodeType<2>(prefixBits, sizeClass);
+			case 3: return determineNodeType<3>(prefixBits, sizeClass);
+			case 4: return determineNodeType<4>(prefixBits, sizeClass);
+			case 5: return determineNodeType<5>(prefixBits, sizeClass);
+			case 6: return determineNodeType<6>(prefixBits, sizeClass);
+			case 7: return determineNodeType<7>(prefixBits, sizeClass);
+			case 8: return determineNodeType<8>(prefixBits, sizeClass);
+			case 9: return determineNodeType<9>(prefixBits, sizeClass);
+			case 10: return determineNodeType<10>(prefixBits, sizeClass);
 			default: throw runtime_error("Only supports up to 10 prefix blocks right now.");
 			}
 		}
-
-	template<unsigned int PREF_BLOCKS>
-	inline static Node<DIM>* determineLhcSize(size_t prefixLength,
-			size_t nDirectInserts) {
-
-		assert(nDirectInserts > 0);
-		const float insertToRatio = float(nDirectInserts) / (1u << DIM);
-		assert(0 < insertToRatio && insertToRatio < 1);
-
-		if (nDirectInserts < 3) {
-			return new LHC<DIM, PREF_BLOCKS, 2>(prefixLength);
-		} else if (insertToRatio < 0.1) {
-			return new LHC<DIM, PREF_BLOCKS, 1 + 10 * (1 << DIM) / 100>(prefixLength);
-		} else if (insertToRatio < 0.2) {
-			return new LHC<DIM, PREF_BLOCKS, 1 + 20 * (1 << DIM) / 100>(prefixLength);
-		} else if (insertToRatio < 0.35) {
-			return new LHC<DIM, PREF_BLOCKS, 1 + 35 * (1 << DIM) / 100>(prefixLength);
-		} else if (insertToRatio < 0.5) {
-			return new LHC<DIM, PREF_BLOCKS, 1 + 50 * (1 << DIM) / 100>(prefixLength);
-		} else if (insertToRatio < 0.75) {
-			return new LHC<DIM, PREF_BLOCKS, 1 + 75 * (1 << DIM) / 100>(prefixLength);
-		} else {
-			return new LHC<DIM, PREF_BLOCKS, (1 << DIM)>(prefixLength);
-		}
-	}
 };
 
+template <unsigned int DIM>
+std::atomic<const NodeTypePolicy<DIM>*> NodeTypeUtil<DIM>::policy_(NULL);
+
 #endif /* SRC_UTIL_NODETYPEUTIL_H_ */
 
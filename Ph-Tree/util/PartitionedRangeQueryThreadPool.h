@@ -0,0 +1,152 @@
+#ifndef SRC_UTIL_PARTITIONEDRANGEQUERYTHREADPOOL_H_
+#define SRC_UTIL_PARTITIONEDRANGEQUERYTHREADPOOL_H_
+
+#include <thread>
+#include <vector>
+#include <atomic>
+
+template <unsigned int DIM>
+class Node;
+
+// Processes a single range query with several threads. The tree is split from the root
+// downwards into disjoint subtrees (i.e. HC address subranges) until there are enough
+// partitions for all threads. The threads then take the partitions from a shared cursor.
+// Partition 0 holds the entries found while splitting, partition i > 0 holds the
+// entries of the (i-1)-th subtree in ascending HC address order.
+template <unsigned int DIM, unsigned int WIDTH>
+class PartitionedRangeQueryThreadPool {
+public:
+
+	PartitionedRangeQueryThreadPool(size_t nAdditionalThreads, const Node<DIM>* root,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			std::vector<std::vector<int>>& outPartitions);
+	~PartitionedRangeQueryThreadPool();
+	void joinPool();
+
+private:
+	// enough partitions to balance subtrees of different sizes between the threads
+	static const size_t partitionsPerThread = 8;
+
+	struct Subtree {
+		const Node<DIM>* node;
+		size_t index;
+		bool fullyContained;
+		unsigned long values[DIM];
+	};
+
+	size_t nThreads_;
+	std::vector<std::thread> threads_;
+	unsigned long lowerLeft_[DIM];
+	unsigned long upperRight_[DIM];
+	std::vector<Subtree> subtrees_;
+	std::vector<std::vector<int>>& partitions_;
+	std::atomic<size_t> nextSubtree_;
+
+	void split(const Node<DIM>* root);
+	void processNext();
+};
+
+#include <assert.h>
+#include "util/SpatialSelectionOperationsUtil.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+PartitionedRangeQueryThreadPool<DIM, WIDTH>::PartitionedRangeQueryThreadPool(size_t nAdditionalThreads,
+		const Node<DIM>* root, const unsigned long* lowerLeft, const unsigned long* upperRight,
+		vector<vector<int>>& outPartitions) : nThreads_(nAdditionalThreads + 1), threads_(),
+		subtrees_(), partitions_(outPartitions), nextSubtree_(0) {
+
+	for (unsigned int d = 0; d < DIM; ++d) {
+		assert (lowerLeft[d] <= upperRight[d]);
+		lowerLeft_[d] = lowerLeft[d];
+		upperRight_[d] = upperRight[d];
+	}
+
+	partitions_.clear();
+	partitions_.resize(1);
+	split(root);
+	partitions_.resize(1 + subtrees_.size());
+
+	threads_.reserve(nAdditionalThreads);
+	for (unsigned tCount = 0; tCount < nAdditionalThreads; ++tCount) {
+		threads_.emplace_back(&PartitionedRangeQueryThreadPool<DIM,WIDTH>::processNext, this);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+PartitionedRangeQueryThreadPool<DIM, WIDTH>::~PartitionedRangeQueryThreadPool() {
+	for (auto &t : threads_) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PartitionedRangeQueryThreadPool<DIM, WIDTH>::joinPool() {
+	processNext();
+	for (auto &t : threads_) {
+		t.join();
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PartitionedRangeQueryThreadPool<DIM, WIDTH>::split(const Node<DIM>* root) {
+	Subtree rootSubtree;
+	rootSubtree.node = root;
+	rootSubtree.index = 0;
+	rootSubtree.fullyContained = false;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		rootSubtree.values[d] = 0;
+	}
+
+	// replace all subtrees by their intersecting subnodes level by level
+	// which keeps the subtrees in ascending HC address order
+	subtrees_.push_back(rootSubtree);
+	vector<Subtree> nextSubtrees;
+	vector<int>& splitIds = partitions_[0];
+	auto addId = [&splitIds] (int id) { splitIds.push_back(id); };
+	auto addSubtree = [&nextSubtrees] (const Node<DIM>* subnode, size_t index,
+			const unsigned long* values, bool fullyContained) {
+		Subtree subtree;
+		subtree.node = subnode;
+		subtree.index = index;
+		subtree.fullyContained = fullyContained;
+		for (unsigned int d = 0; d < DIM; ++d) {
+			subtree.values[d] = values[d];
+		}
+
+		nextSubtrees.push_back(subtree);
+	};
+
+	const size_t minPartitions = (nThreads_ == 1)? 1 : nThreads_ * partitionsPerThread;
+	while (!subtrees_.empty() && subtrees_.size() < minPartitions) {
+		nextSubtrees.clear();
+		for (const Subtree& subtree : subtrees_) {
+			SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInNode(subtree.node, subtree.index,
+					subtree.values, subtree.fullyContained, lowerLeft_, upperRight_, addId, addSubtree);
+		}
+
+		subtrees_.swap(nextSubtrees);
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void PartitionedRangeQueryThreadPool<DIM, WIDTH>::processNext() {
+	vector<int> ids;
+	auto addId = [&ids] (int id) { ids.push_back(id); };
+
+	size_t i = nextSubtree_.fetch_add(1, memory_order_relaxed);
+	while (i < subtrees_.size()) {
+		const Subtree& subtree = subtrees_[i];
+		SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(subtree.node, subtree.index,
+				subtree.values, subtree.fullyContained, lowerLeft_, upperRight_, addId);
+		// only swap the finished partition in to not share the vectors between threads while filling them
+		partitions_[i + 1].swap(ids);
+		ids.clear();
+		i = nextSubtree_.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+#endif /* SRC_UTIL_PARTITIONEDRANGEQUERYTHREADPOOL_H_ */
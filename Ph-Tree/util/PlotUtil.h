@@ -14,6 +14,8 @@
 #define AXONS_DENDRITES_PLOT_NAME 			"phtree_axons_dendrites"
 #define INSERT_ORDER_NAME		 			"phtree_insert_order"
 #define PARALLEL_INSERT_NAME				"phtree_parallel_insert"
+#define LHC_ADDRESS_SEARCH_NAME				"phtree_lhc_address_search"
+#define NODE_TYPE_COST_NAME					"phtree_node_type_cost"
 
 #define PLOT_DATA_PATH 			"./plot/data/"
 #define PLOT_DATA_EXTENSION 	".dat"
@@ -34,6 +36,9 @@
 #define N_RANDOM_ENTRIES_AVERAGE_INSERT	500000
 #define N_RANDOM_ENTRIES_INSERT_SERIES 	1000
 #define N_RANDOM_ENTRIES_RANGE_QUERY 	1000000
+#define N_LHC_ADDRESS_SEARCHES			10000000
+#define N_NODE_TYPE_OPERATIONS			4000000
+#define NODE_TYPE_COST_DIMS				{2, 4, 6, 8, 10, 12};
 
 template <unsigned int DIM, unsigned int WIDTH>
 class Entry;
@@ -79,6 +84,12 @@ public:
 	template <unsigned int DIM, unsigned int WIDTH>
 	static void plotCompareToRTreeBulk(std::string entryFile, bool isFloat);
 
+	template <unsigned int DIM>
+	static void plotLhcAddressSearch();
+
+	// measures bytes, lookup and iteration time of the LHC and AHC per dimensionality and fill ratio
+	static void plotNodeTypeCost();
+
 private:
 	static void plot(std::string gnuplotFileName);
 	static void clearPlotFile(std::string dataFileName);
@@ -88,6 +99,8 @@ private:
 	template <unsigned int DIM, unsigned int WIDTH>
 	static double writeInsertPerformanceOrder(vector<vector<unsigned long>>* entries,
 			ofstream* plotFile, size_t runNumber, std::string lable, bool bulk, bool parallel, size_t nThreads);
+	template <unsigned int DIM>
+	static void writeNodeTypeCostOfDimension(std::ofstream* plotFile);
 	template <unsigned int DIM, unsigned int WIDTH>
 	static void writeAverageInsertTimeOfDimension(size_t runNumber, std::vector<std::vector<unsigned long>>* entries, bool bulk);
 };
@@ -113,9 +126,13 @@ private:
 #include "util/RangeQueryUtil.h"
 #include "util/RandUtil.h"
 #include "util/DynamicNodeOperationsUtil.h"
+#include "util/AddressSearchUtil.h"
+#include "util/NodeTypeUtil.h"
 #include "util/InsertionThreadPool.h"
 #include "util/compare/ParallelRangeQueryScan.h"
 #include "util/compare/RTreeBulkWrapper.h"
+#include "nodes/NodeAddressContent.h"
+#include "nodes/NodeRawContents.h"
 
 using namespace std;
 
@@ -345,6 +362,7 @@ double PlotUtil::writeInsertPerformanceOrder(vector<vector<unsigned long>>* entr
 	if (parallel) {
 		if (bulk) {
 			cout << "\t#flush phases = " << InsertionThreadPool<DIM, WIDTH>::nFlushPhases << endl;
+			cout << "\t#flushes (parallel) = " << DynamicNodeOperationsUtil<DIM, WIDTH>::nFlushCountParallel << endl;
 		}
 		const unsigned long nRestartReadRecurse = DynamicNodeOperationsUtil<DIM, WIDTH>::nRestartReadRecurse;
 		const unsigned long nRestartWriteSplitPrefix = DynamicNodeOperationsUtil<DIM, WIDTH>::nRestartWriteSplitPrefix;
@@ -518,6 +536,164 @@ void PlotUtil::plotCompareToRTreeBulk(std::string entryFile, bool isFloat) {
 	cout << double(phTreeMillis) / 1000 << "s" << endl;
 }
 
+template <unsigned int DIM>
+void PlotUtil::plotLhcAddressSearch() {
+	cout << "measuring the HC address search in LHC nodes with " << DIM << " dimensions" << endl;
+	ofstream* plotFile = openPlotFile(LHC_ADDRESS_SEARCH_NAME, true);
+	const size_t bitsPerBlock = 8 * sizeof (unsigned long);
+	const size_t nQueries = 1 << 16;
+	const vector<unsigned long> queries = RandUtil::generateRandValues(nQueries, 0, (1uL << DIM) - 1);
+
+	for (size_t m = 2; m <= (1uL << DIM); m *= 2) {
+		// pack m random ascending addresses like the LHC does
+		vector<unsigned long> allAddresses(1uL << DIM);
+		for (size_t address = 0; address < allAddresses.size(); ++address) {
+			allAddresses[address] = address;
+		}
+
+		random_shuffle(allAddresses.begin(), allAddresses.end());
+		vector<unsigned long> rows(allAddresses.begin(), allAddresses.begin() + m);
+		sort(rows.begin(), rows.end());
+		const unsigned int nBlocks = 1 + (m * DIM - 1) / bitsPerBlock;
+		vector<unsigned long> blocks(nBlocks, 0);
+		for (size_t row = 0; row < m; ++row) {
+			const size_t firstBit = row * DIM;
+			blocks[firstBit / bitsPerBlock] |= rows[row] << (firstBit % bitsPerBlock);
+			if (firstBit % bitsPerBlock + DIM > bitsPerBlock) {
+				blocks[firstBit / bitsPerBlock + 1] |= rows[row] >> (bitsPerBlock - firstBit % bitsPerBlock);
+			}
+		}
+
+		size_t binaryChecksum = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (size_t i = 0; i < N_LHC_ADDRESS_SEARCHES; ++i) {
+			binaryChecksum += AddressSearchUtil<DIM>::binarySearch(blocks.data(), nBlocks, m, queries[i % nQueries]);
+		}
+
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		const double binaryNs = double(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) / N_LHC_ADDRESS_SEARCHES;
+
+		size_t branchlessChecksum = 0;
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < N_LHC_ADDRESS_SEARCHES; ++i) {
+			branchlessChecksum += AddressSearchUtil<DIM>::branchlessSearch(blocks.data(), nBlocks, m, queries[i % nQueries]);
+		}
+
+		end = chrono::steady_clock::now();
+		const double branchlessNs = double(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) / N_LHC_ADDRESS_SEARCHES;
+		// both searches return the first row with an address >= the query
+		assert (binaryChecksum == branchlessChecksum);
+
+		cout << "N = " << m << ": binary search " << binaryNs << "ns, branchless search "
+				<< branchlessNs << "ns (checksums: " << binaryChecksum << ", " << branchlessChecksum << ")" << endl;
+		(*plotFile) << m << "\t" << binaryNs << "\t" << branchlessNs << endl;
+	}
+
+	plotFile->close();
+	delete plotFile;
+}
+
+void PlotUtil::plotNodeTypeCost() {
+	const size_t dims[] = NODE_TYPE_COST_DIMS
+	ofstream* plotFile = openPlotFile(NODE_TYPE_COST_NAME, true);
+	for (size_t dim : dims) {
+		// resolve dynamic dimensions
+		switch (dim) {
+		case 2: writeNodeTypeCostOfDimension<2>(plotFile); break;
+		case 4: writeNodeTypeCostOfDimension<4>(plotFile); break;
+		case 6: writeNodeTypeCostOfDimension<6>(plotFile); break;
+		case 8: writeNodeTypeCostOfDimension<8>(plotFile); break;
+		case 10: writeNodeTypeCostOfDimension<10>(plotFile); break;
+		case 12: writeNodeTypeCostOfDimension<12>(plotFile); break;
+		default: throw runtime_error("unsupported dimensionality");
+		}
+	}
+
+	plotFile->close();
+	delete plotFile;
+}
+
+template <unsigned int DIM>
+void PlotUtil::writeNodeTypeCostOfDimension(ofstream* plotFile) {
+	cout << "measuring the cost of LHC and AHC nodes with " << DIM << " dimensions" << endl;
+	const size_t nAddresses = 1uL << DIM;
+	// enough nodes per type that they do not all fit into the L1 cache
+	const size_t nNodes = 1 + (1uL << 16) / nAddresses;
+	const size_t nQueries = 1 << 16;
+	const vector<unsigned long> queries = RandUtil::generateRandValues(nQueries, 0, nAddresses - 1);
+	const vector<unsigned long> nodeIndices = RandUtil::generateRandValues(nQueries, 0, nNodes - 1);
+	const NodeTypePolicy<DIM>& policy = NodeTypeUtil<DIM>::getDefaultPolicy();
+	const FillRatioNodeTypePolicy<DIM> fillRatioPolicy;
+
+	for (unsigned int percent = 5; percent < 100; percent += 5) {
+		const size_t nContents = max(size_t(1), percent * nAddresses / 100);
+		// the LHC class the fixed thresholds select (none from 75% on)
+		const NodeSizeClass lhcClass = fillRatioPolicy.selectSizeClass(nContents);
+		const bool hasLhc = lhcClass != ahc_all_contents;
+		const NodeSizeClass sizeClasses[] = {lhcClass, ahc_all_contents};
+		double lookupNs[2] = {0.0, 0.0};
+		double iterationNs[2] = {0.0, 0.0};
+		size_t bytes[2] = {0, 0};
+
+		for (unsigned int type = (hasLhc)? 0 : 1; type < 2; ++type) {
+			vector<Node<DIM>*> nodes(nNodes);
+			for (size_t i = 0; i < nNodes; ++i) {
+				nodes[i] = NodeTypeUtil<DIM>::template buildNodeWithCapacity<64>(0,
+						NodeTypePolicy<DIM>::getCapacity(sizeClasses[type]), 0);
+				vector<unsigned long> allAddresses(nAddresses);
+				for (size_t address = 0; address < nAddresses; ++address) {
+					allAddresses[address] = address;
+				}
+
+				random_shuffle(allAddresses.begin(), allAddresses.end());
+				for (size_t c = 0; c < nContents; ++c) {
+					nodes[i]->insertAtAddress(allAddresses[c], 0uL, int(c));
+				}
+			}
+
+			size_t checksum = 0;
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (size_t i = 0; i < N_NODE_TYPE_OPERATIONS; ++i) {
+				NodeAddressContent<DIM> content;
+				nodes[nodeIndices[i % nQueries]]->lookup(queries[i % nQueries], content, false);
+				checksum += content.exists;
+			}
+
+			chrono::steady_clock::time_point end = chrono::steady_clock::now();
+			lookupNs[type] = double(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) / N_NODE_TYPE_OPERATIONS;
+
+			const size_t nIterations = max(size_t(1), N_NODE_TYPE_OPERATIONS / nContents);
+			start = chrono::steady_clock::now();
+			for (size_t i = 0; i < nIterations; ++i) {
+				NodeRawContents<DIM> contents;
+				nodes[nodeIndices[i % nQueries]]->getRawContents(contents);
+				for (unsigned int row = contents.nextRow(0); row < contents.nRows; row = contents.nextRow(row + 1)) {
+					checksum += contents.getAddress(row) + contents.references[row];
+				}
+			}
+
+			end = chrono::steady_clock::now();
+			iterationNs[type] = double(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) / nIterations;
+			bytes[type] = NodeTypePolicy<DIM>::getByteSize(sizeClasses[type]);
+
+			for (size_t i = 0; i < nNodes; ++i) {
+				delete nodes[i];
+			}
+
+			cout << "DIM = " << DIM << ", " << percent << "% filled, " << ((type == 0)? "LHC" : "AHC")
+					<< ": " << bytes[type] << " bytes, lookup " << lookupNs[type] << "ns, iteration "
+					<< iterationNs[type] << "ns (checksum: " << checksum << ")" << endl;
+		}
+
+		const bool selectsAhc = policy.selectSizeClass(nContents) == ahc_all_contents;
+		(*plotFile) << DIM << "\t" << percent << "\t" << bytes[0] << "\t" << bytes[1]
+				<< "\t" << lookupNs[0] << "\t" << lookupNs[1] << "\t" << iterationNs[0]
+				<< "\t" << iterationNs[1] << "\t" << selectsAhc << endl;
+	}
+
+	(*plotFile) << endl;
+}
+
 template <unsigned int DIM, unsigned int WIDTH>
 void PlotUtil::plotAxonsAndDendrites(vector<string> axonsFiles, vector<string> dendritesFiles, bool parallel) {
 	assert (axonsFiles.size() == dendritesFiles.size());
@@ -596,7 +772,9 @@ void PlotUtil::plotAxonsAndDendrites(vector<string> axonsFiles, vector<string> d
 		CALLGRIND_START_INSTRUMENTATION;
 		startRanges = chrono::steady_clock::now();
 		if (parallel) {
-			phtree->parallelIntersectionQuery(*axonsRectValues);
+			ResultStorage results;
+			phtree->parallelIntersectionQuery(*axonsRectValues, results);
+			nIntersectingDendrites = results.getTotalNResults();
 		} else {
 			for (unsigned iAxon = 0; iAxon < nAxons; ++iAxon) {
 				const unsigned int startInitTime = clock();
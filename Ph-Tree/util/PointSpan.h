@@ -0,0 +1,55 @@
+#ifndef SRC_UTIL_POINTSPAN_H_
+#define SRC_UTIL_POINTSPAN_H_
+
+#include <vector>
+#include <cstddef>
+
+// Read-only view on the values of several points that are either stored in one vector per point
+// or in a single flat buffer holding the DIM values of one point after another. The view does not
+// copy the values so the buffer must outlive it.
+template <unsigned int DIM>
+class PointSpan {
+public:
+	PointSpan(const std::vector<std::vector<unsigned long>>& values);
+	PointSpan(const unsigned long* values, size_t nPoints);
+
+	size_t size() const;
+	// the DIM values of the point
+	const unsigned long* operator[](size_t index) const;
+
+private:
+	const std::vector<std::vector<unsigned long>>* nestedValues_;
+	const unsigned long* flatValues_;
+	size_t nPoints_;
+};
+
+#include <assert.h>
+
+template <unsigned int DIM>
+PointSpan<DIM>::PointSpan(const std::vector<std::vector<unsigned long>>& values)
+	: nestedValues_(&values), flatValues_(NULL), nPoints_(values.size()) {
+}
+
+template <unsigned int DIM>
+PointSpan<DIM>::PointSpan(const unsigned long* values, size_t nPoints)
+	: nestedValues_(NULL), flatValues_(values), nPoints_(nPoints) {
+	assert (values || nPoints == 0);
+}
+
+template <unsigned int DIM>
+size_t PointSpan<DIM>::size() const {
+	return nPoints_;
+}
+
+template <unsigned int DIM>
+const unsigned long* PointSpan<DIM>::operator[](size_t index) const {
+	assert (index < nPoints_);
+	if (flatValues_) {
+		return flatValues_ + DIM * index;
+	}
+
+	assert ((*nestedValues_)[index].size() == DIM);
+	return (*nestedValues_)[index].data();
+}
+
+#endif /* SRC_UTIL_POINTSPAN_H_ */
@@ -7,114 +7,161 @@
 #include <functional>
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include "Entry.h"
-#include "util/ResultStorage.h"
+#include "util/PointSpan.h"
 
 template <unsigned int DIM, unsigned int WIDTH>
 class PHTree;
 
-template <unsigned int DIM, unsigned int WIDTH>
-class ResultStorage;
-
 enum QueryType {
 	intersection_query,
 	inclusion_query
 };
 
-template <unsigned int DIM, unsigned int WIDTH>
+struct RangeQueryThreadStatistics {
+	size_t nQueries;
+	// time spent processing queries
+	unsigned long busyMicros;
+	// time spent waiting for the thread to start and for the other threads to finish
+	unsigned long idleMicros;
+};
+
+// the sink is called as sink(threadIndex, queryIndex, id) for every result
+// the threads repeatedly take the next batch of queries from a shared cursor
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
 class RangeQueryThreadPool {
 public:
 
-	RangeQueryThreadPool(size_t nAdditionalThreads,
-			const std::vector<std::vector<unsigned long>>& ranges,
-			const PHTree<DIM, WIDTH>* tree, QueryType type);
+	RangeQueryThreadPool(size_t nAdditionalThreads, const PointSpan<DIM>& ranges,
+			const PHTree<DIM, WIDTH>* tree, QueryType type, SINK& sink);
 	~RangeQueryThreadPool();
+	// processes queries with the calling thread and returns once all queries are done
 	void joinPool();
+	// only valid after the pool was joined
+	void getThreadStatistics(std::vector<RangeQueryThreadStatistics>& outStatistics) const;
 
 private:
+	// a few queries per batch keep the cursor contention low while
+	// queries with high selectivity cannot delay a large chunk of other queries
+	static const size_t queriesPerBatch = 4;
+
+	struct ThreadState {
+		size_t nQueries;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point end;
+		// keeps the states of different threads in different cache lines
+		char padding_[64];
+	};
+
 	QueryType type_;
 	size_t nThreads_;
 	std::vector<std::thread> threads_;
-	std::vector<ResultStorage<DIM, WIDTH>> startStorage_;
-	const std::vector<std::vector<unsigned long>>& ranges_;
+	const PointSpan<DIM> ranges_;
 	const PHTree<DIM, WIDTH>* tree_;
+	SINK& sink_;
+	std::atomic<size_t> nextQuery_;
+	std::vector<ThreadState> threadStates_;
+	std::chrono::steady_clock::time_point poolStart_;
+	std::chrono::steady_clock::time_point poolEnd_;
 
 	void processNext(size_t threadIndex);
-	RangeQueryIterator<DIM, WIDTH>* getIteratorByType(size_t index);
-	void clearResults();
+	void getRangeByType(size_t index, unsigned long* outLowerLeft, unsigned long* outUpperRight) const;
 };
 
 
 using namespace std;
 
+#include <assert.h>
 #include <stdexcept>
 #include "PHTree.h"
+#include "util/SpatialSelectionOperationsUtil.h"
 
-template <unsigned int DIM, unsigned int WIDTH>
-RangeQueryThreadPool<DIM, WIDTH>::RangeQueryThreadPool(size_t nAdditionalThreads,
-			const std::vector<std::vector<unsigned long>>& ranges,
-			const PHTree<DIM, WIDTH>* tree, QueryType type) :
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+RangeQueryThreadPool<DIM, WIDTH, SINK>::RangeQueryThreadPool(size_t nAdditionalThreads,
+			const PointSpan<DIM>& ranges,
+			const PHTree<DIM, WIDTH>* tree, QueryType type, SINK& sink) :
 			type_(type), nThreads_(nAdditionalThreads + 1),
-			threads_(), startStorage_(nAdditionalThreads + 1), ranges_(ranges), tree_(tree) {
+			threads_(), ranges_(ranges), tree_(tree), sink_(sink), nextQuery_(0),
+			threadStates_(nAdditionalThreads + 1), poolStart_(chrono::steady_clock::now()), poolEnd_(poolStart_) {
 	threads_.reserve(nAdditionalThreads);
 	for (unsigned tCount = 0; tCount < nAdditionalThreads; ++tCount) {
-		threads_.emplace_back(&RangeQueryThreadPool<DIM,WIDTH>::processNext, this, tCount);
+		threads_.emplace_back(&RangeQueryThreadPool<DIM,WIDTH,SINK>::processNext, this, tCount);
 	}
 }
 
-template <unsigned int DIM, unsigned int WIDTH>
-RangeQueryThreadPool<DIM, WIDTH>::~RangeQueryThreadPool() {
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+RangeQueryThreadPool<DIM, WIDTH, SINK>::~RangeQueryThreadPool() {
 	for (auto &t : threads_) {
-		t.join();
+		if (t.joinable()) {
+			t.join();
+		}
 	}
-
-	clearResults();
 }
 
-template <unsigned int DIM, unsigned int WIDTH>
-void RangeQueryThreadPool<DIM, WIDTH>::joinPool() {
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+void RangeQueryThreadPool<DIM, WIDTH, SINK>::joinPool() {
 	processNext(nThreads_ - 1);
-}
+	for (auto &t : threads_) {
+		t.join();
+	}
 
+	poolEnd_ = chrono::steady_clock::now();
+}
 
-template <unsigned int DIM, unsigned int WIDTH>
-RangeQueryIterator<DIM, WIDTH>* RangeQueryThreadPool<DIM, WIDTH>::getIteratorByType(size_t index) {
-	switch (type_) {
-	case intersection_query: return tree_->intersectionQuery(ranges_[index]);
-	case inclusion_query: return tree_->inclusionQuery(ranges_[index]);
-	default: throw runtime_error("unknown query type");
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+void RangeQueryThreadPool<DIM, WIDTH, SINK>::getThreadStatistics(
+		vector<RangeQueryThreadStatistics>& outStatistics) const {
+	outStatistics.clear();
+	const unsigned long poolMicros = chrono::duration_cast<chrono::microseconds>(poolEnd_ - poolStart_).count();
+	for (const ThreadState& state : threadStates_) {
+		const unsigned long busyMicros = chrono::duration_cast<chrono::microseconds>(state.end - state.start).count();
+		assert (busyMicros <= poolMicros);
+		outStatistics.push_back(RangeQueryThreadStatistics {state.nQueries, busyMicros, poolMicros - busyMicros});
 	}
 }
 
 
-template <unsigned int DIM, unsigned int WIDTH>
-void RangeQueryThreadPool<DIM, WIDTH>::clearResults() {
-	for (auto &start : startStorage_) {
-		ResultStorage<DIM, WIDTH>* storage = start.nextStorage_;
-		while (storage != NULL) {
-			ResultStorage<DIM, WIDTH>* nextStorage = storage->nextStorage_;
-			delete storage;
-			storage = nextStorage;
-		}
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+void RangeQueryThreadPool<DIM, WIDTH, SINK>::getRangeByType(size_t index,
+		unsigned long* outLowerLeft, unsigned long* outUpperRight) const {
+	const unsigned long* values = ranges_[index];
+	assert (DIM % 2 == 0);
+	switch (type_) {
+	case intersection_query:
+		PHTree<DIM, WIDTH>::toIntersectionRange(values, values + DIM / 2, outLowerLeft, outUpperRight);
+		break;
+	case inclusion_query:
+		PHTree<DIM, WIDTH>::toInclusionRange(values, values + DIM / 2, outLowerLeft, outUpperRight);
+		break;
+	default: throw runtime_error("unknown query type");
 	}
 }
 
-template <unsigned int DIM, unsigned int WIDTH>
-void RangeQueryThreadPool<DIM, WIDTH>::processNext(size_t threadIndex) {
-	const size_t chunkSize = 1 + ranges_.size() / nThreads_;
-	const size_t start = chunkSize * threadIndex;
-	const size_t end = min(chunkSize * (threadIndex + 1), ranges_.size());
-	ResultStorage<DIM, WIDTH>* storage = &startStorage_[threadIndex];
-
-	for (size_t i = start; i < end; ++i) {
-		RangeQueryIterator<DIM, WIDTH>* it = getIteratorByType(i);
-		while (it->hasNext()) {
-			const Entry<DIM, WIDTH> entry = it->next();
-			storage = storage->add(entry);
+template <unsigned int DIM, unsigned int WIDTH, typename SINK>
+void RangeQueryThreadPool<DIM, WIDTH, SINK>::processNext(size_t threadIndex) {
+	ThreadState& state = threadStates_[threadIndex];
+	state.nQueries = 0;
+	state.start = chrono::steady_clock::now();
+	const size_t nQueries = ranges_.size();
+	unsigned long lowerLeft[DIM];
+	unsigned long upperRight[DIM];
+
+	size_t start = nextQuery_.fetch_add(queriesPerBatch, memory_order_relaxed);
+	while (start < nQueries) {
+		const size_t end = min(start + queriesPerBatch, nQueries);
+		for (size_t i = start; i < end; ++i) {
+			getRangeByType(i, lowerLeft, upperRight);
+			auto forwardToSink = [this, threadIndex, i] (int id) { sink_(threadIndex, i, id); };
+			SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(tree_->root_,
+					lowerLeft, upperRight, forwardToSink);
 		}
 
-		delete it;
+		state.nQueries += end - start;
+		start = nextQuery_.fetch_add(queriesPerBatch, memory_order_relaxed);
 	}
+
+	state.end = chrono::steady_clock::now();
 }
 
 #endif /* SRC_UTIL_RANGEQUERYTHREADPOOL_H_ */
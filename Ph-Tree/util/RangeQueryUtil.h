@@ -86,8 +86,7 @@ public:
 
 			bool foundEqualEntry = false;
 			while (it->hasNext() && !foundEqualEntry) {
-				Entry<DIM, WIDTH> entryInRange = it->next();
-				foundEqualEntry = id == entryInRange.id_;
+				foundEqualEntry = id == it->nextId();
 			}
 
 			return foundEqualEntry;
@@ -105,7 +104,7 @@ public:
 			const PHTree<DIM, WIDTH>& tree) {
 		unsigned int nEntriesInRange = 0;
 		while (it->hasNext()) {
-			Entry<DIM, WIDTH> entryInRange = it->next();
+			it->nextId();
 			++nEntriesInRange;
 		}
 
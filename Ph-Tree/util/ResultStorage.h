@@ -1,43 +1,108 @@
 #ifndef SRC_UTIL_RESULTSTORAGE_H_
 #define SRC_UTIL_RESULTSTORAGE_H_
 
+#include <vector>
+#include <utility>
 
-template <unsigned int DIM, unsigned int WIDTH>
+// Collects the IDs found by parallel range queries without merging the results of the threads:
+// every thread appends to its own growing buffer and the results of one query form a single
+// span in the buffer of the thread that processed the query.
 class ResultStorage {
 public:
-	static const size_t CAPACITY = 1000;
-	size_t nextIndex_;
-	ResultStorage<DIM, WIDTH>* nextStorage_;
-	Entry<DIM, WIDTH> entries_[CAPACITY];
-
 	ResultStorage();
 	~ResultStorage();
-	ResultStorage<DIM, WIDTH>* add(const Entry<DIM,WIDTH>& entry);
-	void recursiveDelete();
+
+	// drops all previous results and prepares the storage for the given number of queries and threads
+	void reset(size_t nQueries, size_t nThreads);
+	// called by the thread with the given index for every result of the query
+	inline void operator()(size_t threadIndex, size_t queryIndex, int id);
+	// needs to be called after all threads finished to make the per query results available
+	void finish();
+
+	size_t getNQueries() const;
+	size_t getNResults(size_t queryIndex) const;
+	size_t getTotalNResults() const;
+	// the results of a query are the IDs in [getResults(i), getResults(i) + getNResults(i))
+	const int* getResults(size_t queryIndex) const;
+
+private:
+	struct ThreadResults {
+		std::vector<int> ids_;
+		// <query index, start offset in ids_> in processing order
+		std::vector<std::pair<size_t, size_t>> queryStarts_;
+		// keeps the buffers of different threads in different cache lines
+		char padding_[64];
+	};
+
+	struct QueryResults {
+		const int* startId_;
+		size_t nResults_;
+	};
+
+	std::vector<ThreadResults> threadResults_;
+	std::vector<QueryResults> queryResults_;
 };
 
+#include <assert.h>
 
+inline ResultStorage::ResultStorage() : threadResults_(), queryResults_() {
+}
 
-template <unsigned int DIM, unsigned int WIDTH>
-ResultStorage<DIM, WIDTH>::ResultStorage() : nextIndex_(0), nextStorage_(NULL) {
+inline ResultStorage::~ResultStorage() {
 }
 
-template <unsigned int DIM, unsigned int WIDTH>
-ResultStorage<DIM, WIDTH>::~ResultStorage() {
+inline void ResultStorage::reset(size_t nQueries, size_t nThreads) {
+	assert (nThreads > 0);
+	threadResults_.clear();
+	threadResults_.resize(nThreads);
+	queryResults_.assign(nQueries, QueryResults {NULL, 0});
 }
 
-template <unsigned int DIM, unsigned int WIDTH>
-ResultStorage<DIM, WIDTH>* ResultStorage<DIM, WIDTH>::add(
-		const Entry<DIM, WIDTH>& entry) {
-	entries_[nextIndex_++] = entry;
-	if (nextIndex_ == CAPACITY) {
-		nextStorage_ = new ResultStorage<DIM, WIDTH>();
-		return nextStorage_;
-	} else {
-		return this;
+inline void ResultStorage::operator()(size_t threadIndex, size_t queryIndex, int id) {
+	assert (threadIndex < threadResults_.size() && queryIndex < queryResults_.size());
+	ThreadResults& results = threadResults_[threadIndex];
+	if (results.queryStarts_.empty() || results.queryStarts_.back().first != queryIndex) {
+		results.queryStarts_.push_back(std::pair<size_t, size_t>(queryIndex, results.ids_.size()));
 	}
+
+	results.ids_.push_back(id);
 }
 
+inline void ResultStorage::finish() {
+	for (const ThreadResults& results : threadResults_) {
+		const size_t nQueries = results.queryStarts_.size();
+		for (size_t i = 0; i < nQueries; ++i) {
+			const size_t queryIndex = results.queryStarts_[i].first;
+			const size_t start = results.queryStarts_[i].second;
+			const size_t end = (i + 1 < nQueries)? results.queryStarts_[i + 1].second : results.ids_.size();
+			assert (queryResults_[queryIndex].nResults_ == 0);
+			queryResults_[queryIndex].startId_ = results.ids_.data() + start;
+			queryResults_[queryIndex].nResults_ = end - start;
+		}
+	}
+}
 
-#endif /* SRC_UTIL_RESULTSTORAGE_H_ */
+inline size_t ResultStorage::getNQueries() const {
+	return queryResults_.size();
+}
+
+inline size_t ResultStorage::getNResults(size_t queryIndex) const {
+	assert (queryIndex < queryResults_.size());
+	return queryResults_[queryIndex].nResults_;
+}
+
+inline size_t ResultStorage::getTotalNResults() const {
+	size_t nResults = 0;
+	for (const ThreadResults& results : threadResults_) {
+		nResults += results.ids_.size();
+	}
 
+	return nResults;
+}
+
+inline const int* ResultStorage::getResults(size_t queryIndex) const {
+	assert (queryIndex < queryResults_.size());
+	return queryResults_[queryIndex].startId_;
+}
+
+#endif /* SRC_UTIL_RESULTSTORAGE_H_ */
@@ -0,0 +1,316 @@
+#ifndef SRC_UTIL_SELECTIVITYESTIMATOR_H_
+#define SRC_UTIL_SELECTIVITYESTIMATOR_H_
+
+#include <vector>
+#include <cstddef>
+
+template <unsigned int DIM, unsigned int WIDTH>
+class Entry;
+
+// Summary of a tree for estimating how many entries a window query returns. The entries below
+// every HC address prefix are counted for a few levels, i.e. the cells of a grid that is refined
+// by one bit per dimension and level. The grid starts below the prefix all entries share so that
+// it covers the data and not the whole value range. An estimation takes the count of every cell
+// fully contained in the window and refines the partially intersected cell with the most entries
+// until a fixed number of cells was visited. The entries of the remaining partially intersected
+// cells are assumed to be uniformly distributed.
+template <unsigned int DIM, unsigned int WIDTH>
+class SelectivityEstimator {
+public:
+	SelectivityEstimator();
+
+	void add(const Entry<DIM, WIDTH>& entry);
+	// the entry must have been added before
+	void remove(const Entry<DIM, WIDTH>& entry);
+	void clear();
+	size_t getNumberOfEntries() const;
+	// number of levels with counters (none if a single level has too many cells)
+	unsigned int getNumberOfLevels() const;
+	// estimated number of entries in the range between the per dimension values (both inclusive)
+	double estimate(const unsigned long* lowerLeft, const unsigned long* upperRight) const;
+
+private:
+	// all levels together have at most 2^maxCellBits counters
+	static const unsigned int maxCellBits = 14;
+	// bounds the time of an estimation
+	static const size_t maxVisitedCells = 64;
+	static const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+	static const unsigned int nBlocks = 1 + (DIM * WIDTH - 1) / bitsPerBlock;
+
+	size_t nEntries_;
+	unsigned int nLevels_;
+	// number of HC addresses above the grid that all entries share
+	unsigned int startDepth_;
+	// an added entry that starts with the shared HC addresses
+	Entry<DIM, WIDTH> prefixEntry_;
+	// the values of the shared HC addresses followed by zeros
+	unsigned long startLower_[DIM];
+	// the counters of level l (cells of l+1 HC addresses below the shared ones) start at levelOffsets_[l]
+	std::vector<size_t> levelOffsets_;
+	std::vector<unsigned int> counts_;
+
+	// a cell that partially intersects the window
+	struct PartialCell {
+		double count;
+		double intersectedFraction;
+		unsigned int depth;
+		size_t cell;
+		// the values of the HC addresses above the depth followed by zeros
+		unsigned long lower[DIM];
+
+		bool operator<(const PartialCell& other) const {
+			return count < other.count;
+		}
+	};
+
+	// moves the grid up to the given depth as a new entry differs from the shared HC addresses there
+	void moveStartUp(unsigned int newStartDepth);
+	void updateStartLower();
+	// returns the count if the cell is contained in the window and adds it to the partial cells otherwise
+	inline double classifyCell(double count, unsigned int depth, size_t cell, const unsigned long* cellLower,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			PartialCell* partialCells, size_t& nPartialCells) const;
+	// returns the index of the first HC address in which the entries differ (WIDTH if equal)
+	static inline unsigned int firstDifferentDepth(const Entry<DIM, WIDTH>& entry1, const Entry<DIM, WIDTH>& entry2);
+};
+
+#include <assert.h>
+#include <algorithm>
+#include "Entry.h"
+#include "util/MultiDimBitset.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+SelectivityEstimator<DIM, WIDTH>::SelectivityEstimator() : nEntries_(0), nLevels_(0), startDepth_(0),
+		prefixEntry_(), startLower_(), levelOffsets_(), counts_() {
+	size_t nCells = 0;
+	while (nLevels_ < WIDTH && DIM * (nLevels_ + 1) <= maxCellBits
+			&& nCells + (1uL << (DIM * (nLevels_ + 1))) <= (1uL << maxCellBits)) {
+		levelOffsets_.push_back(nCells);
+		nCells += 1uL << (DIM * (nLevels_ + 1));
+		++nLevels_;
+	}
+
+	counts_.resize(nCells, 0);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SelectivityEstimator<DIM, WIDTH>::add(const Entry<DIM, WIDTH>& entry) {
+	if (nEntries_ == 0) {
+		// the grid ends at the lowest level
+		startDepth_ = WIDTH - nLevels_;
+		prefixEntry_ = entry;
+		updateStartLower();
+	} else {
+		const unsigned int depth = firstDifferentDepth(entry, prefixEntry_);
+		if (depth < startDepth_) {
+			moveStartUp(depth);
+		}
+	}
+
+	size_t cell = 0;
+	for (unsigned int level = 0; level < nLevels_; ++level) {
+		cell = (cell << DIM) | MultiDimBitset<DIM>::interleaveBits(entry.values_, startDepth_ + level, DIM * WIDTH);
+		++counts_[levelOffsets_[level] + cell];
+	}
+
+	++nEntries_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SelectivityEstimator<DIM, WIDTH>::remove(const Entry<DIM, WIDTH>& entry) {
+	assert (nEntries_ > 0 && firstDifferentDepth(entry, prefixEntry_) >= startDepth_);
+	if (nEntries_ == 1) {
+		clear();
+		return;
+	}
+
+	size_t cell = 0;
+	for (unsigned int level = 0; level < nLevels_; ++level) {
+		cell = (cell << DIM) | MultiDimBitset<DIM>::interleaveBits(entry.values_, startDepth_ + level, DIM * WIDTH);
+		assert (counts_[levelOffsets_[level] + cell] > 0);
+		--counts_[levelOffsets_[level] + cell];
+	}
+
+	// the grid stays at its depth even if the remaining entries share more HC addresses
+	--nEntries_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SelectivityEstimator<DIM, WIDTH>::clear() {
+	counts_.assign(counts_.size(), 0);
+	nEntries_ = 0;
+	startDepth_ = 0;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+size_t SelectivityEstimator<DIM, WIDTH>::getNumberOfEntries() const {
+	return nEntries_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+unsigned int SelectivityEstimator<DIM, WIDTH>::getNumberOfLevels() const {
+	return nLevels_;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SelectivityEstimator<DIM, WIDTH>::moveStartUp(unsigned int newStartDepth) {
+	assert (newStartDepth < startDepth_);
+	const unsigned int shift = startDepth_ - newStartDepth;
+	// all previous entries are in the cells of the shared HC addresses on the new upper levels
+	// and the counters of the previous levels move down by the shift (the lowest ones are lost)
+	vector<unsigned int> counts(counts_.size(), 0);
+	size_t sharedCell = 0;
+	for (unsigned int level = 0; level < nLevels_; ++level) {
+		if (level < shift) {
+			sharedCell = (sharedCell << DIM) | MultiDimBitset<DIM>::interleaveBits(
+					prefixEntry_.values_, newStartDepth + level, DIM * WIDTH);
+			counts[levelOffsets_[level] + sharedCell] = nEntries_;
+		} else {
+			const unsigned int previousLevel = level - shift;
+			const size_t nPreviousCells = 1uL << (DIM * (previousLevel + 1));
+			const size_t firstCell = sharedCell << (DIM * (previousLevel + 1));
+			for (size_t cell = 0; cell < nPreviousCells; ++cell) {
+				counts[levelOffsets_[level] + firstCell + cell] = counts_[levelOffsets_[previousLevel] + cell];
+			}
+		}
+	}
+
+	counts_.swap(counts);
+	startDepth_ = newStartDepth;
+	updateStartLower();
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SelectivityEstimator<DIM, WIDTH>::updateStartLower() {
+	for (unsigned int d = 0; d < DIM; ++d) {
+		startLower_[d] = 0;
+	}
+
+	for (unsigned int depth = 0; depth < startDepth_; ++depth) {
+		const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(prefixEntry_.values_, depth, DIM * WIDTH);
+		for (unsigned int d = 0; d < DIM; ++d) {
+			startLower_[d] |= ((hcAddress >> d) & 1uL) << (WIDTH - depth - 1);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+double SelectivityEstimator<DIM, WIDTH>::estimate(const unsigned long* lowerLeft,
+		const unsigned long* upperRight) const {
+	for (unsigned int d = 0; d < DIM; ++d) {
+		if (lowerLeft[d] > upperRight[d]) {
+			return 0.0;
+		}
+	}
+
+	// max heap of the partial cells by their count (every visited cell is added at most once)
+	PartialCell partialCells[1 + maxVisitedCells];
+	size_t nPartialCells = 0;
+	size_t remainingCells = maxVisitedCells;
+	double estimated = classifyCell(nEntries_, startDepth_, 0, startLower_, lowerLeft, upperRight,
+			partialCells, nPartialCells);
+	while (nPartialCells > 0) {
+		pop_heap(partialCells, partialCells + nPartialCells);
+		const PartialCell partial = partialCells[--nPartialCells];
+		const unsigned int level = partial.depth - startDepth_;
+		if (level == nLevels_) {
+			estimated += partial.count * partial.intersectedFraction;
+			continue;
+		}
+
+		// same masks as for the range query: the lower mask has the bits that need to be set in
+		// the HC address of an intersecting child and the upper mask the bits that may be set
+		const size_t hcBit = WIDTH - partial.depth - 1;
+		unsigned long lowerMask = 0;
+		unsigned long upperMask = 0;
+		for (unsigned int d = 0; d < DIM; ++d) {
+			const unsigned long upperHalfStart = partial.lower[d] | (1uL << hcBit);
+			lowerMask |= (unsigned long)(lowerLeft[d] >= upperHalfStart) << d;
+			upperMask |= (unsigned long)(upperRight[d] >= upperHalfStart) << d;
+		}
+
+		const size_t nChildren = 1uL << __builtin_popcountl(lowerMask ^ upperMask);
+		if (nChildren > remainingCells) {
+			estimated += partial.count * partial.intersectedFraction;
+			continue;
+		}
+
+		remainingCells -= nChildren;
+		for (unsigned long hcAddress = lowerMask; ; hcAddress = (((hcAddress | ~upperMask) + 1) & upperMask) | lowerMask) {
+			const size_t childCell = (partial.cell << DIM) | hcAddress;
+			unsigned long childLower[DIM];
+			for (unsigned int d = 0; d < DIM; ++d) {
+				childLower[d] = partial.lower[d] | (((hcAddress >> d) & 1uL) << hcBit);
+			}
+
+			const double childCount = counts_[levelOffsets_[level] + childCell];
+			estimated += classifyCell(childCount, partial.depth + 1, childCell, childLower, lowerLeft, upperRight,
+					partialCells, nPartialCells);
+			if (hcAddress == upperMask) {
+				break;
+			}
+		}
+	}
+
+	return estimated;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+double SelectivityEstimator<DIM, WIDTH>::classifyCell(double count, unsigned int depth, size_t cell,
+		const unsigned long* cellLower, const unsigned long* lowerLeft, const unsigned long* upperRight,
+		PartialCell* partialCells, size_t& nPartialCells) const {
+	if (count == 0.0) {
+		return 0.0;
+	}
+
+	const unsigned long freeBitsMask = MultiDimBitset<DIM>::lowerBitsMask(WIDTH - depth);
+	bool contained = true;
+	double intersectedFraction = 1.0;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		const unsigned long cellUpper = cellLower[d] | freeBitsMask;
+		const unsigned long from = (lowerLeft[d] > cellLower[d])? lowerLeft[d] : cellLower[d];
+		const unsigned long to = (upperRight[d] < cellUpper)? upperRight[d] : cellUpper;
+		if (from > to) {
+			return 0.0;
+		}
+
+		contained &= from == cellLower[d] && to == cellUpper;
+		intersectedFraction *= (double(to - from) + 1.0) / (double(freeBitsMask) + 1.0);
+	}
+
+	if (contained) {
+		return count;
+	}
+
+	assert (nPartialCells <= maxVisitedCells);
+	PartialCell& partial = partialCells[nPartialCells++];
+	partial.count = count;
+	partial.intersectedFraction = intersectedFraction;
+	partial.depth = depth;
+	partial.cell = cell;
+	for (unsigned int d = 0; d < DIM; ++d) {
+		partial.lower[d] = cellLower[d];
+	}
+
+	push_heap(partialCells, partialCells + nPartialCells);
+	return 0.0;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+unsigned int SelectivityEstimator<DIM, WIDTH>::firstDifferentDepth(const Entry<DIM, WIDTH>& entry1,
+		const Entry<DIM, WIDTH>& entry2) {
+	// the first HC address is stored in the highest bits
+	for (unsigned int block = nBlocks; block-- > 0;) {
+		const unsigned long difference = entry1.values_[block] ^ entry2.values_[block];
+		if (difference != 0) {
+			const size_t highestBit = block * bitsPerBlock + bitsPerBlock - 1 - __builtin_clzl(difference);
+			return (DIM * WIDTH - 1 - highestBit) / DIM;
+		}
+	}
+
+	return WIDTH;
+}
+
+#endif /* SRC_UTIL_SELECTIVITYESTIMATOR_H_ */
@@ -0,0 +1,198 @@
+#ifndef SRC_UTIL_SNAPSHOTUTIL_H_
+#define SRC_UTIL_SNAPSHOTUTIL_H_
+
+#include <iostream>
+
+template <unsigned int DIM>
+class Node;
+
+// Writes a tree to a binary stream and rebuilds it from there without inserting the entries again.
+// The nodes are written depth-first with their capacity (which determines the node type), prefix,
+// suffix storage blocks and the (address, reference) pair of every content. The references of
+// suffixes are independent of the memory layout so they are written as they are and the subnode
+// of a content follows directly after it. Values are written in the native byte order.
+template <unsigned int DIM, unsigned int WIDTH>
+class SnapshotUtil {
+public:
+	static void write(const Node<DIM>* root, std::ostream& os);
+	// builds the nodes in the current arena of the thread and returns the root
+	static Node<DIM>* read(std::istream& is);
+
+private:
+	// identifies the format and the tree dimensions
+	static const unsigned long magic = 0x3130544850uL; // "PHT01"
+	static const unsigned int bitsPerBlock = sizeof (unsigned long) * 8;
+
+	struct NodeHeader {
+		unsigned int capacity;
+		unsigned int prefixLength;
+		unsigned int nContents;
+		unsigned int suffixBlocks;
+	};
+
+	struct ContentRecord {
+		unsigned long hcAddress;
+		unsigned long reference;
+	};
+
+	static void writeNode(const Node<DIM>* node, size_t index, std::ostream& os);
+	static Node<DIM>* readNode(size_t index, std::istream& is);
+	template <typename T>
+	static inline void writeValues(const T* values, size_t n, std::ostream& os);
+	template <typename T>
+	static inline void readValues(T* outValues, size_t n, std::istream& is);
+};
+
+#include <assert.h>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "nodes/Node.h"
+#include "nodes/TSuffixStorage.h"
+#include "util/NodeTypeUtil.h"
+
+using namespace std;
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename T>
+void SnapshotUtil<DIM, WIDTH>::writeValues(const T* values, size_t n, ostream& os) {
+	os.write(reinterpret_cast<const char*>(values), n * sizeof (T));
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename T>
+void SnapshotUtil<DIM, WIDTH>::readValues(T* outValues, size_t n, istream& is) {
+	if (!is.read(reinterpret_cast<char*>(outValues), n * sizeof (T))) {
+		throw runtime_error("The snapshot ended unexpectedly.");
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SnapshotUtil<DIM, WIDTH>::write(const Node<DIM>* root, ostream& os) {
+	const unsigned long header[] = {magic, DIM, WIDTH};
+	writeValues(header, 3, os);
+	writeNode(root, 0, os);
+	if (!os) {
+		throw runtime_error("Could not write the snapshot.");
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Node<DIM>* SnapshotUtil<DIM, WIDTH>::read(istream& is) {
+	unsigned long header[3];
+	readValues(header, 3, is);
+	if (header[0] != magic) {
+		throw runtime_error("The stream does not contain a snapshot.");
+	} else if (header[1] != DIM || header[2] != WIDTH) {
+		throw runtime_error("The snapshot was written by a tree of a different dimensionality or bit width.");
+	}
+
+	return readNode(0, is);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SnapshotUtil<DIM, WIDTH>::writeNode(const Node<DIM>* node, size_t index, ostream& os) {
+	NodeRawContents<DIM> contents;
+	node->getRawContents(contents);
+	const TSuffixStorage* storage = node->getSuffixStorage();
+
+	NodeHeader header;
+	header.capacity = node->getMaximumNumberOfContents();
+	header.prefixLength = contents.prefixLength;
+	header.nContents = node->getNumberOfContents();
+	header.suffixBlocks = (storage)? storage->getNCurrentStorageBlocks() : 0;
+	writeValues(&header, 1, os);
+
+	const size_t prefixBits = DIM * contents.prefixLength;
+	if (prefixBits > 0) {
+		writeValues(contents.prefix, 1 + (prefixBits - 1) / bitsPerBlock, os);
+	}
+
+	if (header.suffixBlocks > 0) {
+		writeValues(storage->getStartBlock(), header.suffixBlocks, os);
+	}
+
+	const size_t subnodeIndex = index + contents.prefixLength + 1;
+	for (unsigned int row = contents.nextRow(0); row < contents.nRows; row = contents.nextRow(row + 1)) {
+		ContentRecord record;
+		record.hcAddress = contents.getAddress(row);
+		record.reference = contents.references[row];
+		const bool isSuffix = record.reference & 1;
+		const bool isPointer = (record.reference >> 1) & 1;
+		if (!isPointer && !isSuffix) {
+			throw runtime_error("Cannot write a snapshot during a parallel insertion.");
+		} else if (isPointer && !isSuffix) {
+			// only the flag of the subnode is kept as it is written next
+			record.reference = 2uL;
+			writeValues(&record, 1, os);
+			writeNode(reinterpret_cast<const Node<DIM>*>(contents.references[row] & ~(3uL)), subnodeIndex, os);
+		} else {
+			writeValues(&record, 1, os);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+Node<DIM>* SnapshotUtil<DIM, WIDTH>::readNode(size_t index, istream& is) {
+	NodeHeader header;
+	readValues(&header, 1, is);
+	if (header.capacity == 0 || header.capacity > (1uL << DIM) || header.nContents > header.capacity
+			|| index + header.prefixLength >= WIDTH) {
+		throw runtime_error("The snapshot contains an invalid node.");
+	}
+
+	const size_t currentIndex = index + header.prefixLength;
+	const size_t suffixBits = DIM * (WIDTH - currentIndex - 1);
+	const unsigned int blocksPerSuffix = (suffixBits > 0)? 1 + (suffixBits - 1) / bitsPerBlock : 0;
+	if (header.suffixBlocks > 0 && (suffixBits == 0 || header.suffixBlocks % blocksPerSuffix != 0
+			|| header.suffixBlocks / blocksPerSuffix > header.nContents)) {
+		throw runtime_error("The snapshot contains an invalid suffix storage.");
+	}
+
+	const size_t prefixBits = DIM * header.prefixLength;
+	Node<DIM>* node = NodeTypeUtil<DIM>::template buildNodeWithCapacity<WIDTH>(
+			prefixBits, header.capacity, header.suffixBlocks);
+	if (prefixBits > 0) {
+		readValues(node->getPrefixStartBlock(), 1 + (prefixBits - 1) / bitsPerBlock, is);
+	}
+
+	if (header.suffixBlocks > 0) {
+		// the suffix storage is filled without gaps so reserving the same number of
+		// suffixes again restores the indices the references point to
+		TSuffixStorage* storage = node->getChangeableSuffixStorage();
+		for (unsigned int i = 0; i < header.suffixBlocks / blocksPerSuffix; ++i) {
+			storage->reserveBits(suffixBits);
+		}
+
+		assert (storage->getNCurrentStorageBlocks() == header.suffixBlocks);
+		readValues(storage->getPointerFromIndex(0), header.suffixBlocks, is);
+	}
+
+	const unsigned long suffixAndIdMask = (-1uL) >> 32;
+	for (unsigned int i = 0; i < header.nContents; ++i) {
+		ContentRecord record;
+		readValues(&record, 1, is);
+		const bool isSuffix = record.reference & 1;
+		const bool isPointer = (record.reference >> 1) & 1;
+		const int id = record.reference >> 32;
+		const unsigned long suffixPart = (record.reference & suffixAndIdMask) >> 2;
+		if (record.hcAddress >= (1uL << DIM) || (!isPointer && !isSuffix)) {
+			throw runtime_error("The snapshot contains an invalid content.");
+		} else if (isPointer && !isSuffix) {
+			node->insertAtAddress(record.hcAddress, readNode(currentIndex + 1, is));
+		} else if (isSuffix && !isPointer) {
+			node->insertAtAddress(record.hcAddress, suffixPart, id);
+		} else {
+			if (suffixPart + blocksPerSuffix > header.suffixBlocks) {
+				throw runtime_error("The snapshot contains an invalid suffix index.");
+			}
+
+			node->insertAtAddress(record.hcAddress, (unsigned int) suffixPart, id);
+		}
+	}
+
+	assert (node->getNumberOfContents() == header.nContents);
+	return node;
+}
+
+#endif /* SRC_UTIL_SNAPSHOTUTIL_H_ */
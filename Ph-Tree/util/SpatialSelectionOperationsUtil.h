@@ -2,11 +2,18 @@
 #define SRC_UTIL_SPATIALSELECTIONOPERATIONSUTIL_H_
 
 #include <vector>
+#include <atomic>
+#include <cstdint>
+#include "nodes/NodeRawContents.h"
+#include "nodes/NodeAddressContent.h"
+#include "util/DistanceUtil.h"
 
 template <unsigned int DIM>
 class Node;
 template <unsigned int DIM, unsigned int WIDTH>
 class Entry;
+template <unsigned int DIM, unsigned int WIDTH>
+class EntryBuffer;
 
 template <unsigned int DIM, unsigned int WIDTH>
 class SpatialSelectionOperationsUtil {
@@ -14,14 +21,166 @@ public:
 	static std::pair<bool, int> lookup(const Entry<DIM, WIDTH>& e,
 			const Node<DIM>* rootNode,
 			std::vector<std::pair<unsigned long, const Node<DIM>*>>* visitedNodes);
+
+	// looks up all entries but advances a group of lookups in lockstep by one node per round and
+	// prefetches the next node (or suffix) of a lookup before the other lookups of the group are
+	// advanced so the cache misses of different lookups overlap
+	static void lookupBatch(const Entry<DIM, WIDTH>* entries, size_t nEntries,
+			const Node<DIM>* rootNode, std::pair<bool, int>* outResults);
+
+	// calls callback(id) for every entry within the given per dimension values [lowerLeft, upperRight]
+	// by walking the raw node contents so the callback can be inlined into the traversal
+	template <typename CALLBACK>
+	static void forEachInRange(const Node<DIM>* rootNode,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			CALLBACK& callback);
+
+	// same as above but only for the subtree of the given node which starts at the given index
+	// and has the given values for all bits above (fully contained if the whole subtree is in the range)
+	template <typename CALLBACK>
+	static void forEachInRange(const Node<DIM>* node, size_t index,
+			const unsigned long* parentValues, bool fullyContained,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			CALLBACK& callback);
+
+	// only visits the given node: calls callback(id) for every suffix in the range and
+	// subnodeCallback(subnode, index, values, fullyContained) for every subnode intersecting the range
+	template <typename CALLBACK, typename SUBNODE_CALLBACK>
+	static void forEachInNode(const Node<DIM>* node, size_t index,
+			const unsigned long* parentValues, bool fullyContained,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback);
+
+	// same as above but on the raw contents of a node (entries of buffers
+	// that are only present during a parallel insertion are visited as well)
+	template <typename CALLBACK, typename SUBNODE_CALLBACK>
+	static void forEachInContents(NodeRawContents<DIM>& contents, size_t index,
+			const unsigned long* parentValues, bool fullyContained,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback);
+
+	// calls callback(id) for every entry within the given distance of the center and only visits
+	// nodes and HC addresses whose boxes (known bits including the node prefix) intersect the ball
+	template <typename CALLBACK>
+	static void forEachInDistance(const Node<DIM>* rootNode, const unsigned long* center,
+			double maxDistance, DistanceMetric metric, CALLBACK& callback);
+
+	// Optimistic readers that can run concurrently with a buffered parallel insertion. Nodes are
+	// not locked but every read is validated against the version of the node and the whole
+	// operation restarts if a writer changed the node in the mean time. The caller has to keep
+	// an EpochReclamation<DIM>::ReadGuard of the tree while calling them.
+	static std::pair<bool, int> optimisticLookup(const Entry<DIM, WIDTH>& e, const Node<DIM>* rootNode);
+	static void optimisticRangeQueryIds(const Node<DIM>* rootNode,
+			const unsigned long* lowerLeft, const unsigned long* upperRight,
+			std::vector<int>& outIds);
+
+	static std::atomic<unsigned long> nRestartOptimisticRead;
+
+	// sets the bits of the interleaved bitset to the per dimension values starting with the given bit
+	static void addDeinterleavedBits(const unsigned long* fromStartBlock, size_t nBits,
+			size_t lsbOffset, unsigned long* outValues);
+
+private:
+	// enough lookups to overlap the memory latency without evicting the prefetched lines again
+	static const size_t lookupsPerRound = 16;
+
+	// a lookup of a batch that is advanced by one node per round
+	struct BatchLookup {
+		size_t entryIndex;
+		const Node<DIM>* node;
+		size_t index;
+		// the suffix in the content still needs to be compared
+		bool comparingSuffix;
+		NodeAddressContent<DIM> content;
+	};
+
+	// copies of the arrays of a node so that they cannot change after the version was validated
+	struct NodeSnapshot {
+		std::vector<std::uintptr_t> references;
+		std::vector<unsigned long> rowBlocks;
+		std::vector<unsigned long> prefix;
+	};
+
+	// a node that still needs to be visited by an optimistic range query
+	struct PendingNode {
+		const Node<DIM>* node;
+		size_t index;
+		bool fullyContained;
+		unsigned long values[DIM];
+	};
+
+	// Selections decide which boxes (nodes) and points (entries) are visited by forEachSelectedInContents.
+	// Only HC addresses that intersect the bounding box [lowerLeft, upperRight] of a selection are visited.
+	// selects the entries within the box [lowerLeft, upperRight]
+	struct BoxSelection {
+		const unsigned long* lowerLeft;
+		const unsigned long* upperRight;
+
+		inline bool intersects(const unsigned long* lower, const unsigned long* upper) const {
+			bool intersecting = true;
+			for (unsigned int d = 0; d < DIM; ++d) {
+				intersecting = intersecting && lower[d] <= upperRight[d] && lowerLeft[d] <= upper[d];
+			}
+			return intersecting;
+		}
+
+		inline bool contains(const unsigned long* lower, const unsigned long* upper) const {
+			bool contained = true;
+			for (unsigned int d = 0; d < DIM; ++d) {
+				contained = contained && lowerLeft[d] <= lower[d] && upper[d] <= upperRight[d];
+			}
+			return contained;
+		}
+	};
+
+	// selects the entries within the distance of the center where maxComparable is the distance in the
+	// form of DistanceUtil and [lowerLeft, upperRight] is the bounding box of the ball
+	struct DistanceSelection {
+		const unsigned long* lowerLeft;
+		const unsigned long* upperRight;
+		const unsigned long* center;
+		double maxComparable;
+		DistanceMetric metric;
+
+		inline bool intersects(const unsigned long* lower, const unsigned long* upper) const {
+			return DistanceUtil<DIM>::minDistance(metric, center, lower, upper) <= maxComparable;
+		}
+
+		inline bool contains(const unsigned long* lower, const unsigned long* upper) const {
+			return DistanceUtil<DIM>::maxDistance(metric, center, lower, upper) <= maxComparable;
+		}
+	};
+
+	// forEachInContents for any selection
+	template <typename SELECTION, typename CALLBACK, typename SUBNODE_CALLBACK>
+	static void forEachSelectedInContents(NodeRawContents<DIM>& contents, size_t index,
+			const unsigned long* parentValues, bool fullyContained, const SELECTION& selection,
+			CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback);
+	// visits the subtree of the node for forEachInDistance
+	template <typename CALLBACK>
+	static void forEachInDistance(const Node<DIM>* node, size_t index,
+			const unsigned long* parentValues, bool fullyContained,
+			const DistanceSelection& selection, CALLBACK& callback);
+	// visits the next node (or suffix) of the lookup and returns true once the result is known
+	static inline bool advanceLookup(const Entry<DIM, WIDTH>& e, BatchLookup& lookup, std::pair<bool, int>& outResult);
+	// gets the version of a node that is neither changed at the moment nor removed
+	static inline bool readVersion(const Node<DIM>* node, unsigned int* outVersion);
+	// checks that the node did not change since the version was read
+	static inline bool validateVersion(const Node<DIM>* node, unsigned int version);
+	// points the contents to copies of the arrays of the node which are valid if the version is
+	static bool snapshotContents(const Node<DIM>* node, NodeSnapshot& snapshot, NodeRawContents<DIM>& outContents);
 };
 
 #include <assert.h>
 #include "nodes/Node.h"
-#include "nodes/NodeAddressContent.h"
+#include "nodes/TSuffixStorage.h"
+#include "util/MultiDimBitset.h"
 
 using namespace std;
 
+template <unsigned int DIM, unsigned int WIDTH>
+atomic<unsigned long> SpatialSelectionOperationsUtil<DIM, WIDTH>::nRestartOptimisticRead(0);
+
 template <unsigned int DIM, unsigned int WIDTH>
 pair<bool, int> SpatialSelectionOperationsUtil<DIM, WIDTH>::lookup(
 		const Entry<DIM, WIDTH>& e,
@@ -99,4 +258,513 @@ pair<bool, int> SpatialSelectionOperationsUtil<DIM, WIDTH>::lookup(
 	}
 }
 
+template <unsigned int DIM, unsigned int WIDTH>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::lookupBatch(const Entry<DIM, WIDTH>* entries, size_t nEntries,
+		const Node<DIM>* rootNode, pair<bool, int>* outResults) {
+
+	BatchLookup lookups[lookupsPerRound];
+	size_t nActive = 0;
+	size_t nextEntry = 0;
+	for (; nActive < lookupsPerRound && nextEntry < nEntries; ++nActive, ++nextEntry) {
+		lookups[nActive].entryIndex = nextEntry;
+		lookups[nActive].node = rootNode;
+		lookups[nActive].index = 0;
+		lookups[nActive].comparingSuffix = false;
+	}
+
+	while (nActive > 0) {
+		for (size_t i = 0; i < nActive;) {
+			BatchLookup& lookup = lookups[i];
+			if (!advanceLookup(entries[lookup.entryIndex], lookup, outResults[lookup.entryIndex])) {
+				++i;
+			} else if (nextEntry < nEntries) {
+				// the root is cached anyway so there is no need to prefetch it
+				lookup.entryIndex = nextEntry++;
+				lookup.node = rootNode;
+				lookup.index = 0;
+				lookup.comparingSuffix = false;
+				++i;
+			} else {
+				lookup = lookups[--nActive];
+			}
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool SpatialSelectionOperationsUtil<DIM, WIDTH>::advanceLookup(const Entry<DIM, WIDTH>& e,
+		BatchLookup& lookup, pair<bool, int>& outResult) {
+
+	if (lookup.comparingSuffix) {
+		const size_t suffixBits = DIM * (WIDTH - lookup.index - 1);
+		const pair<bool, size_t> suffixComp = MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+				lookup.index + 1, WIDTH, lookup.content.getSuffixStartBlock(), suffixBits);
+		outResult = pair<bool, int>(suffixComp.first, (suffixComp.first)? lookup.content.id : 0);
+		return true;
+	}
+
+	const Node<DIM>* node = lookup.node;
+	const size_t prefixLength = node->getPrefixLength();
+	if (prefixLength > 0) {
+		const pair<bool, size_t> prefixComp = MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+				lookup.index, lookup.index + prefixLength,
+				node->getFixPrefixStartBlock(), prefixLength * DIM);
+		if (!prefixComp.first) {
+			outResult = pair<bool, int>(false, 0);
+			return true;
+		}
+	}
+
+	const size_t index = lookup.index + prefixLength;
+	const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(e.values_, index, DIM * WIDTH);
+	NodeAddressContent<DIM>& content = lookup.content;
+	node->lookup(hcAddress, content, true);
+	assert (!content.exists || !content.hasSpecialPointer);
+	if (!content.exists) {
+		outResult = pair<bool, int>(false, 0);
+		return true;
+	}
+
+	if (content.hasSubnode) {
+		assert (content.subnode);
+		// the node is needed in the next round: the header and the start of the contents
+		__builtin_prefetch(content.subnode);
+		__builtin_prefetch(reinterpret_cast<const char*>(content.subnode) + 64);
+		lookup.node = content.subnode;
+		lookup.index = index + 1;
+		return false;
+	}
+
+	if (index + 1 == WIDTH) {
+		outResult = pair<bool, int>(true, content.id);
+		return true;
+	}
+
+	// compare the suffix in the next round
+	if (!content.directlyStoredSuffix) {
+		__builtin_prefetch(content.suffixStartBlock);
+	}
+
+	lookup.index = index;
+	lookup.comparingSuffix = true;
+	return false;
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(const Node<DIM>* rootNode,
+		const unsigned long* lowerLeft, const unsigned long* upperRight,
+		CALLBACK& callback) {
+
+	for (unsigned int d = 0; d < DIM; ++d) {
+		assert (lowerLeft[d] <= upperRight[d]);
+	}
+
+	const unsigned long rootValues[DIM] = {};
+	forEachInRange(rootNode, 0, rootValues, false, lowerLeft, upperRight, callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInRange(const Node<DIM>* node, size_t index,
+		const unsigned long* parentValues, bool fullyContained,
+		const unsigned long* lowerLeft, const unsigned long* upperRight,
+		CALLBACK& callback) {
+	auto recurse = [lowerLeft, upperRight, &callback] (const Node<DIM>* subnode, size_t subnodeIndex,
+			const unsigned long* subnodeValues, bool subnodeFullyContained) {
+		forEachInRange(subnode, subnodeIndex, subnodeValues, subnodeFullyContained,
+				lowerLeft, upperRight, callback);
+	};
+
+	forEachInNode(node, index, parentValues, fullyContained, lowerLeft, upperRight, callback, recurse);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK, typename SUBNODE_CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInNode(const Node<DIM>* node, size_t index,
+		const unsigned long* parentValues, bool fullyContained,
+		const unsigned long* lowerLeft, const unsigned long* upperRight,
+		CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback) {
+
+	NodeRawContents<DIM> contents;
+	node->getRawContents(contents);
+	forEachInContents(contents, index, parentValues, fullyContained, lowerLeft, upperRight,
+			callback, subnodeCallback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK, typename SUBNODE_CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInContents(NodeRawContents<DIM>& contents,
+		size_t index, const unsigned long* parentValues, bool fullyContained,
+		const unsigned long* lowerLeft, const unsigned long* upperRight,
+		CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback) {
+	const BoxSelection selection = {lowerLeft, upperRight};
+	forEachSelectedInContents(contents, index, parentValues, fullyContained, selection,
+			callback, subnodeCallback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename SELECTION, typename CALLBACK, typename SUBNODE_CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachSelectedInContents(NodeRawContents<DIM>& contents,
+		size_t index, const unsigned long* parentValues, bool fullyContained, const SELECTION& selection,
+		CALLBACK& callback, SUBNODE_CALLBACK& subnodeCallback) {
+
+	// values of all bits above the HC address of this node
+	unsigned long values[DIM];
+	for (unsigned int d = 0; d < DIM; ++d) {
+		values[d] = parentValues[d];
+	}
+
+	const size_t prefixLength = contents.prefixLength;
+	index += prefixLength;
+	assert (index < WIDTH);
+	if (prefixLength > 0) {
+		addDeinterleavedBits(contents.prefix, DIM * prefixLength, WIDTH - index, values);
+	}
+
+	// the bit of the HC address and the mask of all bits below
+	const size_t hcBit = WIDTH - index - 1;
+	const unsigned long hcBitValue = 1uL << hcBit;
+	const unsigned long suffixMask = MultiDimBitset<DIM>::lowerBitsMask(hcBit);
+	unsigned long lowerMask = 0;
+	unsigned long upperMask = (1uL << DIM) - 1uL;
+
+	if (!fullyContained) {
+		unsigned long nodeMax[DIM];
+		for (unsigned int d = 0; d < DIM; ++d) {
+			nodeMax[d] = values[d] | hcBitValue | suffixMask;
+		}
+
+		if (!selection.intersects(values, nodeMax)) {
+			// the node (including its prefix) is outside of the selection
+			return;
+		}
+
+		fullyContained = selection.contains(values, nodeMax);
+		if (!fullyContained) {
+			upperMask = 0;
+			for (unsigned int d = 0; d < DIM; ++d) {
+				// the lower half has to be skipped if it is completely below the range
+				lowerMask |= (unsigned long)((values[d] | suffixMask) < selection.lowerLeft[d]) << d;
+				// the upper half can only be used if it is not completely above the range
+				upperMask |= (unsigned long)((values[d] | hcBitValue) <= selection.upperRight[d]) << d;
+			}
+		}
+	}
+
+	const size_t suffixBits = DIM * hcBit;
+	const unsigned long flagMask = ~(3uL);
+	const unsigned long suffixAndIdMask = (-1uL) >> 32;
+	// AHC rows that are empty or outside of the range are skipped by nextRow
+	contents.restrictRows(lowerMask, upperMask);
+	for (unsigned int row = contents.nextRow(contents.lowerBound(lowerMask));
+			row < contents.nRows; row = contents.nextRow(row + 1)) {
+		const unsigned long hcAddress = contents.getAddress(row);
+		if (hcAddress > upperMask) {
+			break;
+		}
+
+		const uintptr_t reference = contents.references[row];
+		assert (reference != 0);
+		// skip LHC addresses outside of the range
+		if ((hcAddress & lowerMask) != lowerMask || (hcAddress & ~upperMask) != 0) {
+			continue;
+		}
+
+		const bool isSuffix = reference & 1;
+		const bool isPointer = (reference >> 1) & 1;
+
+		if (!isPointer && !isSuffix) {
+			// the entries of a buffer that was not flushed yet always need to be checked
+			const EntryBuffer<DIM, WIDTH>* buffer = reinterpret_cast<const EntryBuffer<DIM, WIDTH>*>(reference);
+			auto checkEntry = [&values, hcAddress, hcBit, suffixBits, &selection, &callback]
+								(const unsigned long* suffixStartBlock, int id) {
+				unsigned long entryValues[DIM];
+				for (unsigned int d = 0; d < DIM; ++d) {
+					entryValues[d] = values[d] | (((hcAddress >> d) & 1uL) << hcBit);
+				}
+
+				if (suffixBits > 0) {
+					addDeinterleavedBits(suffixStartBlock, suffixBits, 0, entryValues);
+				}
+
+				if (selection.contains(entryValues, entryValues)) {
+					callback(id);
+				}
+			};
+
+			buffer->forEachCompletedEntry(checkEntry);
+		} else if (isPointer && !isSuffix) {
+			unsigned long subValues[DIM];
+			for (unsigned int d = 0; d < DIM; ++d) {
+				subValues[d] = values[d] | (((hcAddress >> d) & 1uL) << hcBit);
+			}
+
+			const Node<DIM>* subnode = reinterpret_cast<const Node<DIM>*>(reference & flagMask);
+			subnodeCallback(subnode, index + 1, subValues, fullyContained);
+		} else {
+			const int id = reference >> 32;
+			if (!fullyContained) {
+				unsigned long entryValues[DIM];
+				for (unsigned int d = 0; d < DIM; ++d) {
+					entryValues[d] = values[d] | (((hcAddress >> d) & 1uL) << hcBit);
+				}
+
+				if (suffixBits > 0) {
+					const unsigned long suffixPart = (reference & suffixAndIdMask) >> 2;
+					if (isPointer) {
+						assert (contents.suffixBlocks);
+						addDeinterleavedBits(contents.suffixBlocks + suffixPart, suffixBits, 0, entryValues);
+					} else {
+						addDeinterleavedBits(&suffixPart, suffixBits, 0, entryValues);
+					}
+				}
+
+				if (!selection.contains(entryValues, entryValues)) {
+					continue;
+				}
+			}
+
+			callback(id);
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInDistance(const Node<DIM>* rootNode,
+		const unsigned long* center, double maxDistance, DistanceMetric metric, CALLBACK& callback) {
+	assert (maxDistance >= 0.0);
+	const double maxComparable = DistanceUtil<DIM>::toComparable(metric, maxDistance);
+	// no value of the ball is farther away than the distance in any single dimension
+	const unsigned long maxValue = MultiDimBitset<DIM>::lowerBitsMask(WIDTH);
+	const double maxExtent = floor(DistanceUtil<DIM>::fromComparable(metric, maxComparable));
+	const unsigned long extent = (maxExtent < double(maxValue))? (unsigned long) maxExtent : maxValue;
+	unsigned long lowerLeft[DIM];
+	unsigned long upperRight[DIM];
+	for (unsigned int d = 0; d < DIM; ++d) {
+		lowerLeft[d] = (center[d] > extent)? center[d] - extent : 0;
+		upperRight[d] = (maxValue - center[d] > extent)? center[d] + extent : maxValue;
+	}
+
+	const unsigned long rootValues[DIM] = {};
+	const DistanceSelection selection = {lowerLeft, upperRight, center, maxComparable, metric};
+	forEachInDistance(rootNode, 0, rootValues, false, selection, callback);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+template <typename CALLBACK>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::forEachInDistance(const Node<DIM>* node, size_t index,
+		const unsigned long* parentValues, bool fullyContained,
+		const DistanceSelection& selection, CALLBACK& callback) {
+	auto recurse = [&selection, &callback] (const Node<DIM>* subnode, size_t subnodeIndex,
+			const unsigned long* subnodeValues, bool subnodeFullyContained) {
+		forEachInDistance(subnode, subnodeIndex, subnodeValues, subnodeFullyContained, selection, callback);
+	};
+
+	NodeRawContents<DIM> contents;
+	node->getRawContents(contents);
+	forEachSelectedInContents(contents, index, parentValues, fullyContained, selection, callback, recurse);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::addDeinterleavedBits(const unsigned long* fromStartBlock,
+		size_t nBits, size_t lsbOffset, unsigned long* outValues) {
+	const size_t bitsPerBlock = sizeof (unsigned long) * 8;
+	const size_t nBlocks = 1 + (nBits - 1) / bitsPerBlock;
+	for (size_t b = 0; b < nBlocks; ++b) {
+		unsigned long block = fromStartBlock[b];
+		if (b == nBlocks - 1) {
+			block &= MultiDimBitset<DIM>::lowerBitsMask(nBits - b * bitsPerBlock);
+		}
+
+		// only visit the set bits
+		while (block != 0) {
+			const size_t bitIndex = b * bitsPerBlock + __builtin_ctzl(block);
+			outValues[bitIndex % DIM] |= 1uL << (lsbOffset + bitIndex / DIM);
+			block &= block - 1;
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+pair<bool, int> SpatialSelectionOperationsUtil<DIM, WIDTH>::optimisticLookup(
+		const Entry<DIM, WIDTH>& e, const Node<DIM>* rootNode) {
+
+	NodeAddressContent<DIM> content;
+	while (true) {
+		const Node<DIM>* currentNode = rootNode;
+		size_t index = 0;
+		unsigned int version;
+		while (readVersion(currentNode, &version)) {
+			const size_t prefixLength = currentNode->getPrefixLength();
+			if (index + prefixLength >= WIDTH) {
+				// only possible if the node was changed while reading it
+				break;
+			}
+
+			bool prefixMatches = true;
+			if (prefixLength > 0) {
+				prefixMatches = MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+						index, index + prefixLength,
+						currentNode->getFixPrefixStartBlock(), prefixLength * DIM).first;
+			}
+
+			index += prefixLength;
+			const unsigned long hcAddress = MultiDimBitset<DIM>::interleaveBits(e.values_, index, DIM * WIDTH);
+			currentNode->lookup(hcAddress, content, false);
+			const TSuffixStorage* suffixes = currentNode->getSuffixStorage();
+			if (!validateVersion(currentNode, version)) {
+				break;
+			}
+
+			if (!prefixMatches || !content.exists) {
+				return pair<bool, int>(false, 0);
+			}
+
+			if (content.hasSubnode) {
+				++index;
+				currentNode = content.subnode;
+				continue;
+			}
+
+			const size_t suffixBits = DIM * (WIDTH - index - 1);
+			if (content.hasSpecialPointer) {
+				pair<bool, int> result(false, 0);
+				auto compareEntry = [&e, index, suffixBits, &result] (const unsigned long* suffixStartBlock, int id) {
+					if (suffixBits == 0 || MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+							index + 1, WIDTH, suffixStartBlock, suffixBits).first) {
+						result = pair<bool, int>(true, id);
+					}
+				};
+
+				reinterpret_cast<const EntryBuffer<DIM, WIDTH>*>(content.specialPointer)->forEachCompletedEntry(compareEntry);
+				// the buffer could have been flushed and reused in the mean time
+				if (!validateVersion(currentNode, version)) {
+					break;
+				}
+
+				return result;
+			}
+
+			if (suffixBits > 0) {
+				// suffixes are only appended during a parallel insertion so the validated index stays valid
+				const unsigned long* suffixStartBlock = (content.directlyStoredSuffix)?
+						&content.suffix : suffixes->getStartBlock() + content.suffixStartBlockIndex;
+				if (!MultiDimBitset<DIM>::compare(e.values_, DIM * WIDTH,
+						index + 1, WIDTH, suffixStartBlock, suffixBits).first) {
+					return pair<bool, int>(false, 0);
+				}
+			}
+
+			return pair<bool, int>(true, content.id);
+		}
+
+		++nRestartOptimisticRead;
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+void SpatialSelectionOperationsUtil<DIM, WIDTH>::optimisticRangeQueryIds(const Node<DIM>* rootNode,
+		const unsigned long* lowerLeft, const unsigned long* upperRight,
+		vector<int>& outIds) {
+
+	for (unsigned int d = 0; d < DIM; ++d) {
+		assert (lowerLeft[d] <= upperRight[d]);
+	}
+
+	const size_t startSize = outIds.size();
+	NodeSnapshot snapshot;
+	NodeRawContents<DIM> contents;
+	vector<PendingNode> pending;
+	auto collectId = [&outIds] (int id) {
+		outIds.push_back(id);
+	};
+	auto collectSubnode = [&pending] (const Node<DIM>* subnode, size_t subnodeIndex,
+			const unsigned long* subnodeValues, bool subnodeFullyContained) {
+		pending.push_back(PendingNode {subnode, subnodeIndex, subnodeFullyContained, {}});
+		for (unsigned int d = 0; d < DIM; ++d) {
+			pending.back().values[d] = subnodeValues[d];
+		}
+	};
+
+	bool restart = true;
+	while (restart) {
+		// results of a failed attempt are dropped
+		restart = false;
+		outIds.resize(startSize);
+		pending.clear();
+		pending.push_back(PendingNode {rootNode, 0, false, {}});
+
+		while (!restart && !pending.empty()) {
+			const PendingNode next = pending.back();
+			pending.pop_back();
+			unsigned int version;
+			restart = !readVersion(next.node, &version)
+					|| !snapshotContents(next.node, snapshot, contents)
+					|| !validateVersion(next.node, version);
+			if (!restart) {
+				forEachInContents(contents, next.index, next.values, next.fullyContained,
+						lowerLeft, upperRight, collectId, collectSubnode);
+				// buffers of the node could have been flushed while reading them
+				restart = !validateVersion(next.node, version);
+			}
+
+			if (restart) {
+				++nRestartOptimisticRead;
+			}
+		}
+	}
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool SpatialSelectionOperationsUtil<DIM, WIDTH>::readVersion(const Node<DIM>* node, unsigned int* outVersion) {
+	*outVersion = node->updateCounter.load(memory_order_acquire);
+	return (*outVersion % 2 == 0) && !__atomic_load_n(&node->removed, __ATOMIC_ACQUIRE);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool SpatialSelectionOperationsUtil<DIM, WIDTH>::validateVersion(const Node<DIM>* node, unsigned int version) {
+	// all reads of the node contents need to happen before the version is checked again
+	atomic_thread_fence(memory_order_acquire);
+	return node->updateCounter.load(memory_order_relaxed) == version
+			&& !__atomic_load_n(&node->removed, __ATOMIC_RELAXED);
+}
+
+template <unsigned int DIM, unsigned int WIDTH>
+bool SpatialSelectionOperationsUtil<DIM, WIDTH>::snapshotContents(const Node<DIM>* node,
+		NodeSnapshot& snapshot, NodeRawContents<DIM>& outContents) {
+	outContents = NodeRawContents<DIM>();
+	node->getRawContents(outContents);
+	// the sizes could be read while the node changes so they are checked before copying
+	if (outContents.nRows > (1uL << DIM) || outContents.prefixLength >= WIDTH) {
+		return false;
+	}
+
+	const size_t bitsPerBlock = sizeof (unsigned long) * 8;
+	const bool isAHC = !outContents.addresses;
+	const size_t nReferences = (isAHC)? (1uL << DIM) : outContents.nRows;
+	snapshot.references.assign(outContents.references, outContents.references + nReferences);
+	outContents.references = snapshot.references.data();
+
+	// LHC: bit-packed addresses, AHC: occupancy bitmap (always copies at least one block)
+	const size_t nRowBits = (isAHC)? (1uL << DIM) : outContents.nRows * DIM;
+	const size_t nRowBlocks = (nRowBits == 0)? 1 : 1 + (nRowBits - 1) / bitsPerBlock;
+	const unsigned long* rowBlocks = (isAHC)? outContents.occupied : outContents.addresses;
+	snapshot.rowBlocks.assign(rowBlocks, rowBlocks + nRowBlocks);
+	if (isAHC) {
+		outContents.occupied = snapshot.rowBlocks.data();
+	} else {
+		outContents.addresses = snapshot.rowBlocks.data();
+	}
+
+	if (outContents.prefixLength > 0) {
+		const size_t nPrefixBlocks = 1 + (outContents.prefixLength * DIM - 1) / bitsPerBlock;
+		snapshot.prefix.assign(outContents.prefix, outContents.prefix + nPrefixBlocks);
+		outContents.prefix = snapshot.prefix.data();
+	}
+
+	return true;
+}
+
 #endif /* SRC_UTIL_SPATIALSELECTIONOPERATIONSUTIL_H_ */
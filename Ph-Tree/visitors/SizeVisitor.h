@@ -92,6 +92,7 @@ void SizeVisitor<DIM>::visitSub(AHC<DIM, PREF_BLOCKS>* node, unsigned int depth)
 	totalAHCByteSize += this->template superSize<PREF_BLOCKS>(node);
 	totalAHCByteSize += sizeof(node->nContents);
 	totalAHCByteSize += sizeof(node->references_);
+	totalAHCByteSize += sizeof(node->occupied_);
 }
 
 template <unsigned int DIM>